@@ -22,6 +22,10 @@ enum XspressState {
 #define XSP_SOF_GET_PREV_TIME(x) (((x)>>24)&0xFFFFFFFF) // Get total integration time from previous time frame from first (header) word
 #define XSP_SOF_GET_CHAN(x)      (((x)>>60)&0xF)        // Get channel number from first (header) word
 
+#define XSP_SOF_SET_FRAME(x)     (((u_int64_t)(x)&0xFFFFFF)<<0)      // Set time frame in first (header) word
+#define XSP_SOF_SET_PREV_TIME(x) (((u_int64_t)(x)&0xFFFFFFFF)<<24)   // Set total integration time of previous time frame in first (header) word
+#define XSP_SOF_SET_CHAN(x)      (((u_int64_t)(x)&0xF)<<60)          // Set channel number in first (header) word
+
 
 #define XSP_MASK_END_OF_FRAME    ((u_int64_t)1<<59)     // Mask for End of Frame Marker.
 
@@ -34,6 +38,8 @@ enum XspressState {
 #define XSP_10GTX_TIMEOUT        30
 
 #define XSP_PACKETS_PER_FRAME    20
+// Frame channel of a list mode frame holding packets from any channel
+#define XSP_LIST_MIXED_CHANNELS  0xFFFFFFFF
 
 namespace Xspress
 {
@@ -50,6 +56,8 @@ namespace Xspress
   typedef struct
   {
     uint32_t packets_received;
+    /** Channel of every packet in the frame, XSP_LIST_MIXED_CHANNELS if the channels are mixed */
+    uint32_t channel;
     ListPacketHeader packet_headers[XSP_PACKETS_PER_FRAME];
   } ListFrameHeader;
 
@@ -25,8 +25,24 @@ typedef struct
   uint32_t num_channels;
   uint32_t num_scalars;
   uint32_t first_channel;
+  uint32_t num_frames;
   //double dead_time_energy;
   //double clock_period;
 } FrameHeader;
 
+/**
+ * Binary header at the start of each meta data block published by the MCA
+ * process plugin, followed by the values for each frame of the block.
+ */
+typedef struct
+{
+  uint32_t frame_id;
+  uint32_t num_frames;
+  uint32_t first_channel;
+  uint32_t num_channels;
+  // Values for each channel, the number of scalars, ROIs or energy bins
+  uint32_t num_values;
+  uint32_t reserved[3];
+} MetaHeader;
+
 #endif //_XSPRESS3DEFINITIONS_EPICS_H
@@ -145,6 +145,8 @@ public:
                      int invert_f0,
                      int invert_veto) = 0;
   virtual int get_num_frames_read(int32_t *frames) = 0;
+  virtual bool supports_frame_wait() = 0;
+  virtual int wait_for_frames(int32_t frames, uint32_t timeout_us) = 0;
   virtual int get_num_scalars(uint32_t *num_scalars) = 0;
   virtual int histogram_circ_ack(int channel,
                          uint32_t frame_number,
@@ -176,6 +178,15 @@ public:
                        uint32_t num_aux,
                        uint32_t start_chan,
                        uint32_t num_chan) = 0;
+  virtual bool supports_zero_copy() = 0;
+  virtual int histogram_frame_ptrs(std::vector<uint32_t *>& frame_ptrs,
+                           uint32_t tf,
+                           uint32_t num_tf,
+                           uint32_t total_tf,
+                           uint32_t num_eng,
+                           uint32_t num_aux,
+                           uint32_t start_chan,
+                           uint32_t num_chan) = 0;
   virtual int validate_histogram_dims(uint32_t num_eng,
                               uint32_t num_aux,
                               uint32_t start_chan,
@@ -18,6 +18,7 @@
 
 #include "logging.h"
 #include "ILibXspress.h"
+#include "XspressSimulatedData.h"
 
 using namespace log4cxx;
 using namespace log4cxx::helpers;
@@ -116,6 +117,8 @@ public:
                      int invert_f0,
                      int invert_veto);
   int get_num_frames_read(int32_t *frames);
+  bool supports_frame_wait();
+  int wait_for_frames(int32_t frames, uint32_t timeout_us);
   int get_num_scalars(uint32_t *num_scalars);
   int histogram_circ_ack(int channel,
                          uint32_t frame_number,
@@ -147,6 +150,15 @@ public:
                        uint32_t num_aux,
                        uint32_t start_chan,
                        uint32_t num_chan);
+  bool supports_zero_copy();
+  int histogram_frame_ptrs(std::vector<uint32_t *>& frame_ptrs,
+                           uint32_t tf,
+                           uint32_t num_tf,
+                           uint32_t total_tf,
+                           uint32_t num_eng,
+                           uint32_t num_aux,
+                           uint32_t start_chan,
+                           uint32_t num_chan);
   int validate_histogram_dims(uint32_t num_eng,
                               uint32_t num_aux,
                               uint32_t start_chan,
@@ -159,8 +171,20 @@ public:
   int enable_list_mode_resets();
   int set_channel_sources(int run_flags);
   int setup_marker_channels();
+  void set_count_rate(double count_rate);
+  double get_count_rate();
+  void set_ring_frames(uint32_t ring_frames);
+  uint32_t get_ring_frames();
+  void set_generator_threads(uint32_t num_threads);
+  uint32_t get_generator_threads();
+  uint32_t get_buffer_frames();
+  uint32_t get_buffer_high_water();
+  uint32_t get_dropped_frame_count();
+  int32_t get_first_dropped_frame();
 
 private:
+  void arrive_frames(int32_t frames);
+
   /** String representation of trigger modes */
   std::map<std::string, int>    trigger_modes_;
 
@@ -168,6 +192,9 @@ private:
   int                           num_cards_;
   int                           max_channels_;
   bool                          use_resgrades_;
+  int                           num_aux_data_;
+  /** SCA window limits for each channel */
+  std::vector<XspressSimulatedWindows> windows_;
   std::vector<uint32_t>         sca5_low_;
   std::vector<uint32_t>         sca5_high_;
   std::vector<uint32_t>         sca6_low_;
@@ -175,10 +202,26 @@ private:
   std::vector<uint32_t>         sca4_threshold_;
   int32_t                       num_frames_;
   int32_t                       max_frames_;
+  /** Number of frames held in the circular buffer (0 for unlimited) */
+  uint32_t                      buffer_frames_;
+  /** Number of frames that have arrived from the (simulated) detector */
+  int32_t                       frames_arrived_;
+  /** Number of frames acknowledged through histogram_circ_ack */
+  uint32_t                      frames_acked_;
+  /** Number of frames dropped because the circular buffer was full */
+  uint32_t                      dropped_frames_;
+  /** First frame dropped in the current acquisition (-1 if none) */
+  int32_t                       first_dropped_frame_;
+  /** Largest number of unacknowledged frames held in the circular buffer */
+  uint32_t                      buffer_high_water_;
   double                        exposure_time_;
   bool                          acquisition_state_;
   boost::posix_time::ptime      acq_start_time_;
-  uint32_t                      simulated_mca_[4096];
+  /** Mutex and condition used to wake callers waiting for frames */
+  boost::mutex                  frame_mutex_;
+  boost::condition_variable     frame_cond_;
+  /** Generator for the simulated MCA data and scalars */
+  XspressSimulatedData          data_;
 };
 
 } /* namespace Xspress */
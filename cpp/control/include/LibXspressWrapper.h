@@ -152,6 +152,8 @@ public:
                      int invert_f0,
                      int invert_veto);
   int get_num_frames_read(int32_t *frames);
+  bool supports_frame_wait();
+  int wait_for_frames(int32_t frames, uint32_t timeout_us);
   int get_num_scalars(uint32_t *num_scalars);
   int histogram_circ_ack(int channel,
                          uint32_t frame_number,
@@ -183,6 +185,15 @@ public:
                        uint32_t num_aux,
                        uint32_t start_chan,
                        uint32_t num_chan);
+  bool supports_zero_copy();
+  int histogram_frame_ptrs(std::vector<uint32_t *>& frame_ptrs,
+                           uint32_t tf,
+                           uint32_t num_tf,
+                           uint32_t total_tf,
+                           uint32_t num_eng,
+                           uint32_t num_aux,
+                           uint32_t start_chan,
+                           uint32_t num_chan);
   int validate_histogram_dims(uint32_t num_eng,
                               uint32_t num_aux,
                               uint32_t start_chan,
@@ -94,6 +94,9 @@ private:
   static const std::string CONFIG_XSP_EXPOSURE_TIME;
   static const std::string CONFIG_XSP_FRAMES;
   static const std::string CONFIG_XSP_MODE;
+  static const std::string CONFIG_XSP_SIM_COUNT_RATE;
+  static const std::string CONFIG_XSP_SIM_RING_FRAMES;
+  static const std::string CONFIG_XSP_SIM_THREADS;
   static const std::string CONFIG_XSP_SCA5_LOW;
   static const std::string CONFIG_XSP_SCA5_HIGH;
   static const std::string CONFIG_XSP_SCA6_LOW;
@@ -124,6 +127,18 @@ private:
   static const std::string CONFIG_DAQ;
   static const std::string CONFIG_DAQ_ENABLED;
   static const std::string CONFIG_DAQ_ZMQ_ENDPOINTS;
+  static const std::string CONFIG_DAQ_BATCH_SIZE;
+  static const std::string CONFIG_DAQ_FRAMES_PER_MESSAGE;
+  static const std::string CONFIG_DAQ_POOL_BUFFERS;
+  static const std::string CONFIG_DAQ_WAIT_POLICY;
+  static const std::string CONFIG_DAQ_WAIT_MAX_US;
+  static const std::string CONFIG_DAQ_LIVE_UPDATE_FRAMES;
+  static const std::string CONFIG_DAQ_LIVE_UPDATE_MS;
+  static const std::string CONFIG_DAQ_CONTROL_CPUS;
+  static const std::string CONFIG_DAQ_WORKER_CPUS;
+  static const std::string CONFIG_DAQ_IO_CPUS;
+  static const std::string CONFIG_DAQ_WORK_STEALING;
+  static const std::string CONFIG_DAQ_ZERO_COPY;
 
   /** Configuration constants for commands **/
   static const std::string CONFIG_CMD;
@@ -150,10 +165,19 @@ private:
   static const std::string STATUS_CARDS_CONNECTED;
   static const std::string STATUS_CHANNEL_FRAMES;
   static const std::string STATUS_FEM_DROPPED_FRAMES;
+  static const std::string STATUS_DAQ_POOL_BUFFERS;
+  static const std::string STATUS_DAQ_POOL_FREE;
+  static const std::string STATUS_DAQ_POOL_EXHAUSTED;
+  static const std::string STATUS_DAQ_POLL_CPU_TIME;
+  static const std::string STATUS_DAQ_POLL_CPU_LOAD;
 
   static const std::string STATUS_LIVE_SCALAR[NUMBER_OF_SCALARS];
   static const std::string STATUS_LIVE_DTC;
   static const std::string STATUS_LIVE_INP_EST;
+  static const std::string STATUS_LIVE_INP_EST_MIN;
+  static const std::string STATUS_LIVE_INP_EST_MAX;
+  static const std::string STATUS_LIVE_INP_EST_MEAN;
+  static const std::string STATUS_LIVE_WINDOW_FRAMES;
 
   static const std::string STATUS_TEMPERATURE[NUMBER_OF_TEMPERATURES];
 
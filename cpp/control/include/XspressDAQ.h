@@ -10,6 +10,11 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <deque>
+#include <map>
 
 #include <log4cxx/logger.h>
 #include <log4cxx/basicconfigurator.h>
@@ -21,6 +26,8 @@
 #include "WorkQueue.h"
 #include "logging.h"
 #include "LibXspressWrapper.h"
+#include "XspressDAQBufferPool.h"
+#include "XspressDAQLiveData.h"
 
 using namespace log4cxx;
 using namespace log4cxx::helpers;
@@ -31,6 +38,13 @@ using namespace FrameProcessor;
 #define DAQ_TASK_TYPE_READ     1
 #define DAQ_TASK_TYPE_COMPLETE 2
 #define DAQ_TASK_TYPE_SHUTDOWN 3
+#define DAQ_TASK_TYPE_CHUNKS   4
+
+// Define the policies used by the control thread while waiting for frames
+#define DAQ_WAIT_POLICY_SPIN    0
+#define DAQ_WAIT_POLICY_YIELD   1
+#define DAQ_WAIT_POLICY_BACKOFF 2
+#define DAQ_WAIT_POLICY_NOTIFY  3
 
 namespace Xspress
 {
@@ -43,6 +57,72 @@ public:
   uint32_t value2_;
 };
 
+/**
+ * A range of frames to be read for the channels of a single endpoint.
+ */
+class XspressDAQChunk
+{
+public:
+  uint32_t endpoint_;
+  uint32_t first_frame_;
+  uint32_t num_frames_;
+};
+
+/**
+ * Tracks which frames sent directly out of the histogram memory have been
+ * released by ZeroMQ on every endpoint, so that the circular buffer is only
+ * acknowledged once the memory is no longer referenced.
+ */
+class XspressDAQReleaseTracker
+{
+public:
+  XspressDAQReleaseTracker(uint32_t buffer_length, uint32_t num_endpoints);
+  void release(uint32_t first_frame, uint32_t num_frames);
+  uint32_t releasable(uint32_t first_frame, uint32_t max_frames);
+
+private:
+  /** Number of slots in the circular buffer */
+  uint32_t buffer_length_;
+  /** Number of endpoints that must release each frame */
+  uint32_t num_endpoints_;
+  /** Number of endpoints that have released the frame in each slot */
+  boost::scoped_array<boost::atomic<uint32_t> > slots_;
+};
+
+/**
+ * The parts of a single message that reference the histogram memory.
+ */
+class XspressDAQZeroCopyRef
+{
+public:
+  boost::shared_ptr<XspressDAQReleaseTracker> tracker_;
+  boost::atomic<uint32_t> parts_;
+  uint32_t first_frame_;
+  uint32_t num_frames_;
+};
+
+/**
+ * A message buffer that has been filled with frames and is ready to send.
+ * When sending without a copy the MCA data is referenced in the histogram
+ * memory through mca_ptrs_ rather than held in the buffer.
+ */
+class XspressDAQMessage
+{
+public:
+  uint32_t *frame_ptr_;
+  uint32_t size_;
+  XspressDAQBufferPool *pool_;
+  uint32_t first_frame_;
+  uint32_t num_frames_;
+  uint32_t num_scalars_;
+  uint32_t *s_ptr_;
+  double *dtc_ptr_;
+  double *inp_est_ptr_;
+  std::vector<uint32_t *> mca_ptrs_;
+  uint32_t mca_size_;
+  boost::shared_ptr<XspressDAQReleaseTracker> tracker_;
+};
+
 /**
  * The XspressDAQ class has responsibility for creating threads to process frames
  * as they become available from the libxspress library during an acquisition.  
@@ -58,12 +138,37 @@ public:
   XspressDAQ(boost::shared_ptr<ILibXspress> detector_ptr,
              uint32_t num_channels,
              uint32_t num_spectra,
-             std::vector<std::string> endpoints);
+             std::vector<std::string> endpoints,
+             const std::string& io_cpus);
   virtual ~XspressDAQ();
-  std::vector<uint32_t> read_live_scalar(uint32_t index);
-  std::vector<double> read_live_dtc();
-  std::vector<double> read_live_inp_est();
+  void read_live_data(std::vector<XspressLiveChannel>& live_data);
   void set_num_aux_data(uint32_t num_aux_data);
+  void set_batch_size(uint32_t batch_size);
+  uint32_t get_batch_size();
+  void set_pool_buffers(uint32_t pool_buffers);
+  uint32_t get_pool_allocated();
+  uint32_t get_pool_free_buffers();
+  uint64_t get_pool_exhausted();
+  void reset_statistics();
+  int set_wait_policy(const std::string& policy);
+  std::string get_wait_policy();
+  void set_wait_max_us(uint32_t wait_max_us);
+  uint32_t get_wait_max_us();
+  double get_poll_cpu_time();
+  double get_poll_cpu_load();
+  void set_live_update_frames(uint32_t frames);
+  uint32_t get_live_update_frames();
+  void set_live_update_ms(uint32_t update_ms);
+  uint32_t get_live_update_ms();
+  void set_work_stealing(bool work_stealing);
+  bool get_work_stealing();
+  void set_zero_copy(bool zero_copy);
+  bool get_zero_copy();
+  int set_control_cpus(const std::string& cpus);
+  std::string get_control_cpus();
+  int set_worker_cpus(const std::vector<std::string>& cpus);
+  std::vector<std::string> get_worker_cpus();
+  std::string get_io_cpus();
   boost::shared_ptr<XspressDAQTask> create_task(uint32_t type);
   boost::shared_ptr<XspressDAQTask> create_task(uint32_t type, uint32_t value1);
   boost::shared_ptr<XspressDAQTask> create_task(uint32_t type, uint32_t value1, uint32_t value2);
@@ -80,6 +185,22 @@ public:
                 const std::string& endpoint);
 
 private:
+  void setup_buffer_pool();
+  uint32_t get_frames_complete();
+  void wait_for_frames(int32_t frames, uint32_t& idle_count);
+  boost::shared_ptr<XspressDAQBufferPool> get_buffer_pool(int index);
+  int set_thread_cpus(boost::thread *thread, const std::string& cpus);
+  boost::shared_ptr<XspressDAQMessage> read_frames(int worker,
+                                                   int endpoint,
+                                                   uint32_t first_frame,
+                                                   uint32_t num_frames,
+                                                   boost::shared_ptr<XspressDAQBufferPool> pool);
+  void send_frames(int endpoint, boost::shared_ptr<XspressDAQMessage> message);
+  void send_ordered(int endpoint, boost::shared_ptr<XspressDAQMessage> message);
+  void queue_chunks(uint32_t first_frame, uint32_t num_frames);
+  bool take_chunk(int worker, XspressDAQChunk& chunk);
+  uint32_t get_batch_frames(uint32_t first_frame, uint32_t max_frames);
+
   /** libxspress wrapper object ptr */
   boost::shared_ptr<ILibXspress> detector_;
   /** Pointer to the logging facility */
@@ -92,6 +213,64 @@ private:
   int                           num_aux_data_;
   /** Number of spectra */
   int                           num_spectra_;
+  /** Maximum number of frames read and sent per ZMQ message */
+  uint32_t                      batch_size_;
+  /** Batch size latched for the current acquisition, the frame buffer pools are sized from it */
+  uint32_t                      acq_batch_size_;
+  /** Number of channels monitored by each worker thread */
+  std::vector<int>              thread_channels_;
+  /** First channel monitored by each worker thread */
+  std::vector<int>              thread_first_channel_;
+  /** Number of scalars per channel */
+  uint32_t                      num_scalars_;
+  /** Share frame reading between the worker threads */
+  bool                          work_stealing_;
+  /** Send MCA data directly out of the histogram memory when supported */
+  bool                          zero_copy_;
+  /** Is the current acquisition sending MCA data without a copy */
+  bool                          acq_zero_copy_;
+  /** Release tracker for the current zero copy acquisition */
+  boost::shared_ptr<XspressDAQReleaseTracker> release_tracker_;
+  /** ZMQ data socket for each endpoint */
+  std::vector<zmq::socket_t *>  data_sockets_;
+  /** Mutex held while sending on each endpoint when work stealing */
+  boost::scoped_array<boost::mutex> send_mutex_;
+  /** Read messages waiting for earlier frames to be sent on each endpoint */
+  std::vector<std::map<uint32_t, boost::shared_ptr<XspressDAQMessage> > > pending_;
+  /** Chunks of frames waiting to be read for each endpoint */
+  std::vector<std::deque<XspressDAQChunk> > chunks_;
+  /** Mutex protecting the chunk queue for each endpoint */
+  boost::scoped_array<boost::mutex> chunk_mutex_;
+  /** Time of the last live data publish for each endpoint (ns) */
+  boost::scoped_array<uint64_t> live_publish_ns_;
+  /** Number of buffers to allocate across the frame buffer pools */
+  uint32_t                      pool_buffers_;
+  /** Pool of frame buffers used for sending ZMQ messages, one for each worker thread */
+  std::vector<boost::shared_ptr<XspressDAQBufferPool> > pools_;
+  /** Previous pools that still have buffers owned by ZMQ */
+  std::vector<boost::shared_ptr<XspressDAQBufferPool> > retired_pools_;
+  /** Mutex protecting the frame buffer pool pointers */
+  boost::mutex                  pool_mutex_;
+  /** Policy used by the control thread while waiting for frames */
+  boost::atomic<int>            wait_policy_;
+  /** Maximum time in microseconds to wait between polls */
+  boost::atomic<uint32_t>       wait_max_us_;
+  /** Control thread CPU time spent polling for frames (ns) */
+  boost::atomic<uint64_t>       poll_cpu_ns_;
+  /** Control thread CPU time spent polling during the last acquisition (ns) */
+  boost::atomic<uint64_t>       acq_poll_cpu_ns_;
+  /** Duration of the last acquisition (ns) */
+  boost::atomic<uint64_t>       acq_wall_ns_;
+  /** Publish live data after this many frames (0 to disable) */
+  boost::atomic<uint32_t>       live_update_frames_;
+  /** Publish live data after this many milliseconds (0 to disable) */
+  boost::atomic<uint32_t>       live_update_ms_;
+  /** CPU list the control thread is pinned to */
+  std::string                   control_cpus_;
+  /** CPU lists the worker threads are pinned to */
+  std::vector<std::string>      worker_cpus_;
+  /** CPU list the ZeroMQ IO threads are pinned to */
+  std::string                   io_cpus_;
   /** Pointer to worker queue thread */
   boost::thread                 *thread_;
   /** Pointer to control thread */
@@ -102,8 +281,8 @@ private:
   boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > > ctrl_queue_;
   /** Vector of pointers to the worker thread queues */
   std::vector<boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > > > work_queues_;
-  /** Pointer to worker thread completion queue */
-  boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > > done_queue_;
+  /** Number of frames sent on each endpoint in the current acquisition */
+  boost::scoped_array<boost::atomic<uint32_t> > worker_frames_;
   /** ZeroMQ context */
   zmq::context_t                *context_;
 
@@ -118,23 +297,8 @@ private:
   /** Has an acquisition failed */
   bool acq_failed_;
 
-  /** Live scalar values */
-  std::vector<uint32_t>         live_scalar_0_;
-  std::vector<uint32_t>         live_scalar_1_;
-  std::vector<uint32_t>         live_scalar_2_;
-  std::vector<uint32_t>         live_scalar_3_;
-  std::vector<uint32_t>         live_scalar_4_;
-  std::vector<uint32_t>         live_scalar_5_;
-  std::vector<uint32_t>         live_scalar_6_;
-  std::vector<uint32_t>         live_scalar_7_;
-  std::vector<uint32_t>         live_scalar_8_;
-  /** Live DTC values */
-  std::vector<double>           live_dtc_;
-  std::vector<double>           live_inp_est_;
-
-
-  /** Data mutex for multi-threaded DAQ locking */
-  boost::mutex                  data_mutex_;
+  /** Live scalar, DTC and input estimate values from the latest frame */
+  boost::scoped_ptr<XspressDAQLiveData> live_data_;
 };
 
 } /* namespace Xspress */
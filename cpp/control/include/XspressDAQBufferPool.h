@@ -0,0 +1,66 @@
+/*
+ * XspressDAQBufferPool.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#ifndef XspressDAQBufferPool_H_
+#define XspressDAQBufferPool_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boost/atomic.hpp>
+#include <boost/lockfree/stack.hpp>
+
+namespace Xspress
+{
+
+/**
+ * The XspressDAQBufferPool class holds a fixed number of equally sized buffers
+ * used by the DAQ worker threads to build frame messages.
+ *
+ * All buffers are carved out of a single allocation when the pool is created.
+ * Buffers are handed out and returned through a lock-free stack so that the
+ * worker threads and the ZeroMQ IO threads (which release buffers once a
+ * message has been sent) never contend on a lock.  When the pool is empty the
+ * caller is expected to fall back to a heap allocation; each occurrence is
+ * counted so that back-pressure from the frame receivers can be monitored.
+ */
+class XspressDAQBufferPool
+{
+public:
+  XspressDAQBufferPool(size_t buffer_size, uint32_t num_buffers);
+  virtual ~XspressDAQBufferPool();
+  void *allocate();
+  void release(void *buffer);
+  bool owns(void *buffer);
+  void prefault();
+  size_t buffer_size();
+  uint32_t num_buffers();
+  uint32_t free_buffers();
+  uint32_t outstanding();
+  uint64_t exhausted();
+  void reset_statistics();
+
+private:
+  /** Size of each buffer in bytes */
+  size_t                                buffer_size_;
+  /** Number of buffers in the pool */
+  uint32_t                              num_buffers_;
+  /** Single memory block holding all of the buffers */
+  char                                  *block_;
+  /** Stack of buffers that are available for use */
+  boost::lockfree::stack<char *, boost::lockfree::fixed_sized<true> > free_stack_;
+  /** Number of buffers currently available */
+  boost::atomic<uint32_t>               free_count_;
+  /** Number of times a buffer was requested from an empty pool */
+  boost::atomic<uint64_t>               exhausted_;
+  /** Has the pool memory been touched by its owning thread */
+  boost::atomic<bool>                   prefaulted_;
+};
+
+} /* namespace Xspress */
+
+#endif /* XspressDAQBufferPool_H_ */
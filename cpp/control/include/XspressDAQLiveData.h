@@ -0,0 +1,98 @@
+/*
+ * XspressDAQLiveData.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#ifndef XspressDAQLiveData_H_
+#define XspressDAQLiveData_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+
+// Number of scalar values held for each channel
+#define LIVE_DATA_SCALARS 9
+
+namespace Xspress
+{
+
+/**
+ * Live values for a single channel.  The scalars, DTC factor and input
+ * estimate are taken from the most recent frame; the input estimate
+ * aggregates cover every frame read since the previous update.
+ */
+typedef struct
+{
+  uint32_t scalars[LIVE_DATA_SCALARS];
+  double   dtc;
+  double   inp_est;
+  double   inp_est_min;
+  double   inp_est_max;
+  double   inp_est_mean;
+  uint32_t window_frames;
+} XspressLiveChannel;
+
+/**
+ * The XspressDAQLiveData class holds the live scalar, dead time correction
+ * and input estimate values for every channel in a single contiguous array.
+ *
+ * Each DAQ worker thread owns a contiguous section of the channels.  Frames
+ * are accumulated privately by the owning worker and published to readers
+ * through a sequence lock, so the worker decides how often the (comparatively
+ * expensive) publish happens.  Writers never block and never wait on readers;
+ * readers take a consistent copy of each section, retrying if a writer
+ * updated it during the copy.  This means that all of the values for a
+ * channel in a snapshot always come from the same update.
+ */
+class XspressDAQLiveData
+{
+public:
+  XspressDAQLiveData(const std::vector<int>& channels);
+  virtual ~XspressDAQLiveData();
+  void accumulate(int section,
+                  const uint32_t *scalars,
+                  uint32_t num_scalars,
+                  const double *dtc,
+                  const double *inp_est,
+                  uint32_t num_frames);
+  uint32_t pending(int section);
+  void publish(int section);
+  void snapshot(std::vector<XspressLiveChannel>& channels);
+  uint32_t num_channels();
+
+private:
+  /**
+   * A contiguous set of channels written by a single worker thread, padded
+   * so that the sequence counters of different workers never share a cache
+   * line.
+   */
+  typedef struct
+  {
+    boost::atomic<uint32_t> sequence;
+    uint32_t                first_channel;
+    uint32_t                num_channels;
+    uint32_t                pending_frames;
+    char                    padding[64 - (4 * sizeof(uint32_t))];
+  } Section;
+
+  /** Number of channels */
+  uint32_t                          num_channels_;
+  /** Number of writer sections */
+  uint32_t                          num_sections_;
+  /** Writer sections */
+  boost::scoped_array<Section>      sections_;
+  /** Published live values for each channel */
+  boost::scoped_array<XspressLiveChannel> data_;
+  /** Values accumulated by the writers since their last publish */
+  boost::scoped_array<XspressLiveChannel> staged_;
+  /** Sum of the input estimates since the last publish */
+  boost::scoped_array<double>       inp_est_sum_;
+};
+
+} /* namespace Xspress */
+
+#endif /* XspressDAQLiveData_H_ */
@@ -119,6 +119,42 @@ public:
   std::string getXspMode();
   void setXspDAQEndpoints(std::vector<std::string> endpoints);
   std::vector<std::string> getXspDAQEndpoints();
+  int setXspDAQBatchSize(uint32_t batch_size);
+  int setXspDAQBatchSize(uint32_t batch_size, uint32_t frames_per_message);
+  uint32_t getXspDAQBatchSize();
+  uint32_t getXspDAQFramesPerMessage();
+  void setXspDAQPoolBuffers(uint32_t pool_buffers);
+  uint32_t getXspDAQPoolBuffers();
+  uint32_t getXspDAQPoolAllocated();
+  uint32_t getXspDAQPoolFree();
+  uint64_t getXspDAQPoolExhausted();
+  void resetDAQStatistics();
+  int setXspDAQWaitPolicy(const std::string& policy);
+  std::string getXspDAQWaitPolicy();
+  void setXspDAQWaitMaxUs(uint32_t wait_max_us);
+  uint32_t getXspDAQWaitMaxUs();
+  void setXspDAQLiveUpdateFrames(uint32_t frames);
+  uint32_t getXspDAQLiveUpdateFrames();
+  void setXspDAQLiveUpdateMs(uint32_t update_ms);
+  uint32_t getXspDAQLiveUpdateMs();
+  int setXspDAQControlCpus(const std::string& cpus);
+  std::string getXspDAQControlCpus();
+  int setXspDAQWorkerCpus(const std::vector<std::string>& cpus);
+  std::vector<std::string> getXspDAQWorkerCpus();
+  void setXspDAQIoCpus(const std::string& cpus);
+  std::string getXspDAQIoCpus();
+  void setXspDAQWorkStealing(bool work_stealing);
+  bool getXspDAQWorkStealing();
+  void setXspDAQZeroCopy(bool zero_copy);
+  bool getXspDAQZeroCopy();
+  double getXspDAQPollCpuTime();
+  double getXspDAQPollCpuLoad();
+  void setXspSimCountRate(double count_rate);
+  double getXspSimCountRate();
+  void setXspSimRingFrames(uint32_t ring_frames);
+  uint32_t getXspSimRingFrames();
+  void setXspSimThreads(uint32_t num_threads);
+  uint32_t getXspSimThreads();
   int setSca5LowLimits(std::vector<uint32_t> sca5_low_limit);
   std::vector<uint32_t> getSca5LowLimits();
   int setSca5HighLimits(std::vector<uint32_t> sca5_high_limit);
@@ -138,9 +174,7 @@ public:
   std::vector<double> getDtcInWindowGrad();
   std::vector<double> getDtcInWindowRateOff();
   std::vector<double> getDtcInWindowRateGrad();
-  std::vector<uint32_t> getLiveScalars(uint32_t index);
-  std::vector<double> getLiveDtcFactors();
-  std::vector<double> getLiveInpEst();
+  void getLiveData(std::vector<XspressLiveChannel>& live_data);
   bool getXspAcquiring();
   bool getXspAcqFailed();
   void resetXspAcqFailed();
@@ -159,6 +193,8 @@ public:
 private:
   /** libxspress wrapper object */
   boost::shared_ptr<ILibXspress>  detector_;
+  /** Simulated detector object, set when running in simulation */
+  boost::shared_ptr<LibXspressSimulator> simulator_;
   /** Pointer to DAQ object */
   boost::shared_ptr<XspressDAQ>   daq_;
   /** Simulation flag for this wrapper */
@@ -221,6 +257,36 @@ private:
   std::string                   xsp_mode_;
   /** DAQ endpoints */
   std::vector<std::string>      xsp_daq_endpoints_;
+  /** Number of frames sent per DAQ message */
+  uint32_t                      xsp_daq_batch_size_;
+  /** Number of frames each frame receiver buffer can hold (decoder frames_per_message) */
+  uint32_t                      xsp_daq_frames_per_message_;
+  /** Number of frame buffers in the DAQ buffer pool */
+  uint32_t                      xsp_daq_pool_buffers_;
+  /** Policy used by the DAQ while waiting for frames */
+  std::string                   xsp_daq_wait_policy_;
+  /** Maximum time in microseconds the DAQ waits between polls */
+  uint32_t                      xsp_daq_wait_max_us_;
+  /** Number of frames between DAQ live data updates (0 to disable) */
+  uint32_t                      xsp_daq_live_update_frames_;
+  /** Time in milliseconds between DAQ live data updates (0 to disable) */
+  uint32_t                      xsp_daq_live_update_ms_;
+  /** CPU list for the DAQ control thread */
+  std::string                   xsp_daq_control_cpus_;
+  /** CPU lists for the DAQ worker threads */
+  std::vector<std::string>      xsp_daq_worker_cpus_;
+  /** CPU list for the DAQ ZeroMQ IO threads */
+  std::string                   xsp_daq_io_cpus_;
+  /** Share DAQ frame reading between the worker threads */
+  bool                          xsp_daq_work_stealing_;
+  /** Send DAQ MCA data directly from the histogram memory */
+  bool                          xsp_daq_zero_copy_;
+  /** Simulated count rate on each channel (counts/s) */
+  double                        xsp_sim_count_rate_;
+  /** Number of frames generated before the simulated data repeats */
+  uint32_t                      xsp_sim_ring_frames_;
+  /** Number of threads generating the simulated data */
+  uint32_t                      xsp_sim_threads_;
   
   /** Number of frames read out by each channel */
   std::vector<int32_t>          xsp_status_frames_;
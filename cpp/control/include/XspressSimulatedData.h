@@ -0,0 +1,131 @@
+/*
+ * XspressSimulatedData.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#ifndef XspressSimulatedData_H_
+#define XspressSimulatedData_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include <log4cxx/logger.h>
+
+// Scalar layout for each channel and frame, matching the hardware
+#define SIM_SCALAR_TIME        0
+#define SIM_SCALAR_RESET_TICKS 1
+#define SIM_SCALAR_RESET_COUNT 2
+#define SIM_SCALAR_ALL_EVENT   3
+#define SIM_SCALAR_ALL_GOOD    4
+#define SIM_SCALAR_IN_WINDOW0  5
+#define SIM_SCALAR_IN_WINDOW1  6
+#define SIM_SCALAR_PILEUP      7
+#define SIM_SCALAR_TOTAL_TICKS 8
+#define SIM_NUM_SCALARS        9
+
+// Simulated clock period (80 MHz)
+#define SIM_CLOCK_PERIOD 12.5e-9
+
+namespace Xspress
+{
+
+/**
+ * SCA window limits for a single channel.
+ */
+typedef struct
+{
+  uint32_t window0_low;
+  uint32_t window0_high;
+  uint32_t window1_low;
+  uint32_t window1_high;
+} XspressSimulatedWindows;
+
+/**
+ * The XspressSimulatedData class generates realistic MCA data for the
+ * simulator.
+ *
+ * A ring of frames is generated for every channel, each holding a spectrum
+ * built from a set of emission lines on a scattering background with Poisson
+ * counting noise, spread over the resgrade aux planes, along with scalars that
+ * are consistent with the spectrum and the configured count rate.  The ring is
+ * filled by background threads as soon as the acquisition parameters are
+ * known, and frames are then served from the ring (wrapping around) so that
+ * reading a frame is never more expensive than a copy.
+ */
+class XspressSimulatedData
+{
+public:
+  XspressSimulatedData();
+  virtual ~XspressSimulatedData();
+  void set_count_rate(double count_rate);
+  double get_count_rate();
+  void set_ring_frames(uint32_t ring_frames);
+  uint32_t get_ring_frames();
+  void set_num_threads(uint32_t num_threads);
+  uint32_t get_num_threads();
+  void invalidate();
+  void generate(uint32_t num_channels,
+                uint32_t num_eng,
+                uint32_t num_aux,
+                double exposure_time,
+                const std::vector<XspressSimulatedWindows>& windows);
+  uint32_t get_num_eng();
+  uint32_t get_num_aux();
+  uint32_t get_num_channels();
+  uint32_t *spectrum(uint32_t frame, uint32_t channel);
+  const uint32_t *scalars(uint32_t frame, uint32_t channel);
+
+private:
+  void stop();
+  void wait_for_slot(uint32_t slot);
+  void generate_task(uint32_t thread_index);
+  void generate_slot(uint32_t slot, boost::random::mt19937& rng);
+  void build_shape(uint32_t channel, std::vector<double>& cdf);
+
+  /** Pointer to the logging facility */
+  log4cxx::LoggerPtr            logger_;
+  /** Count rate incident on each channel (counts/s) */
+  double                        count_rate_;
+  /** Requested number of frames held in the ring */
+  uint32_t                      ring_frames_;
+  /** Number of generator threads */
+  uint32_t                      num_threads_;
+  /** Parameters of the currently generated ring */
+  uint32_t                      num_channels_;
+  uint32_t                      num_eng_;
+  uint32_t                      num_aux_;
+  double                        exposure_time_;
+  std::vector<XspressSimulatedWindows> windows_;
+  /** Number of frames actually held in the ring */
+  uint32_t                      slots_;
+  /** Is the ring valid for the current parameters */
+  bool                          valid_;
+  /** Cumulative energy distribution for each channel */
+  std::vector<std::vector<double> > shape_cdf_;
+  /** Cumulative distribution of counts across the aux planes */
+  std::vector<double>           aux_cdf_;
+  /** Spectra for every slot and channel [slot][channel][aux][eng] */
+  boost::scoped_array<uint32_t> spectra_;
+  /** Scalars for every slot and channel [slot][channel][scalar] */
+  boost::scoped_array<uint32_t> scalars_;
+  /** Has each slot been generated */
+  boost::scoped_array<boost::atomic<bool> > ready_;
+  /** Mutex and condition used to wait for a slot to be generated */
+  boost::mutex                  ready_mutex_;
+  boost::condition_variable     ready_cond_;
+  /** Set to stop the generator threads */
+  boost::atomic<bool>           abort_;
+  /** Generator threads */
+  std::vector<boost::thread *>  threads_;
+};
+
+} /* namespace Xspress */
+
+#endif /* XspressSimulatedData_H_ */
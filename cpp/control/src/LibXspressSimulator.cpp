@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "dirent.h"
 
 #include "LibXspressSimulator.h"
@@ -15,17 +16,8 @@
 namespace Xspress
 {
 const int N_RESGRADES = 16;
-
-double rand_gen() {
-   // return a uniformly distributed random value
-   return ( (double)(rand()) + 1. )/( (double)(RAND_MAX) + 1. );
-}
-double normalRandom() {
-   // return a normally distributed random value
-   double v1=rand_gen();
-   double v2=rand_gen();
-   return cos(2*3.14*v2)*sqrt(-2.*log(v1));
-}
+// Number of energy bins generated for each spectrum
+const uint32_t N_ENERGY_BINS = 4096;
 
 /** Construct a new LibXspressSimulator class.
  *
@@ -33,8 +25,18 @@ double normalRandom() {
  * variables.
  */
 LibXspressSimulator::LibXspressSimulator() :
+  num_cards_(0),
+  max_channels_(0),
+  use_resgrades_(false),
+  num_aux_data_(1),
   num_frames_(0),
   max_frames_(1),
+  buffer_frames_(0),
+  frames_arrived_(0),
+  frames_acked_(0),
+  dropped_frames_(0),
+  first_dropped_frame_(-1),
+  buffer_high_water_(0),
   exposure_time_(1.0),
   acquisition_state_(false)
 {
@@ -52,13 +54,6 @@ LibXspressSimulator::LibXspressSimulator() :
   trigger_modes_[TM_TTL_BOTH_STR] = TM_TTL_BOTH;
   trigger_modes_[TM_LVDS_VETO_ONLY_STR] = TM_LVDS_VETO_ONLY;
   trigger_modes_[TM_LVDS_BOTH_STR] = TM_LVDS_BOTH;
-
-  // Create simulated MCA
-  memset(simulated_mca_, 0, 4096*sizeof(int32_t));
-  for (int i=0; i<20000; ++i) {
-    double number = normalRandom()*50.0 + 2000.0;
-    if ((number>=0.0)&&(number<4096.0)) ++simulated_mca_[int(number)];
-  }
 }
 
 /** Destructor for XspressDetector class.
@@ -103,6 +98,10 @@ int LibXspressSimulator::configure_mca(int num_cards,                 // Number
   LOG4CXX_DEBUG_LEVEL(1, logger_, "[SIM] Xspress wrapper calling xsp3_config");
   num_cards_ = num_cards;
   max_channels_ = max_channels;
+  // MCA data is always held in a circular buffer of num_frames timeframes
+  buffer_frames_ = num_frames > 0 ? num_frames : 0;
+  XspressSimulatedWindows no_windows = {0, 0, 0, 0};
+  windows_.resize(max_channels_, no_windows);
   return XSP_STATUS_OK;
 }
 
@@ -149,6 +148,8 @@ int LibXspressSimulator::setup_format_run_mode(bool list_mode, bool use_resgrade
   } else {
     num_aux_data = 1;
   }
+  use_resgrades_ = use_resgrades;
+  num_aux_data_ = num_aux_data;
   return status;
 }
 
@@ -183,7 +184,7 @@ int LibXspressSimulator::get_clock_period(double& clock_period)
   int status = XSP_STATUS_OK;
   LOG4CXX_DEBUG_LEVEL(1, logger_, "[SIM] Xspress wrapper calling xsp3_get_clock_period");
   // Read the clock period
-  clock_period = 0.0;
+  clock_period = SIM_CLOCK_PERIOD;
   return status;
 }
 
@@ -326,8 +327,10 @@ int LibXspressSimulator::read_dropped_frames(std::vector<int32_t>& dropped_frame
   }
 
   if (status == XSP_STATUS_OK){
+    boost::lock_guard<boost::mutex> lock(frame_mutex_);
+    // Every card drops the same frames when the shared buffer overruns
     for (int card = 0; card < num_cards_; card++) {
-      dropped_frames[card] = 0;
+      dropped_frames[card] = dropped_frames_;
     }
   }
   return status;
@@ -589,21 +592,88 @@ int LibXspressSimulator::setTriggerMode(int frames,
 int LibXspressSimulator::get_num_frames_read(int32_t *frames)
 {
   int status = XSP_STATUS_OK;
+  boost::lock_guard<boost::mutex> lock(frame_mutex_);
   // Calculate the current acquisition duration and from that the
   // number of frames that have acquired
   if (acquisition_state_){
     boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
     int32_t elapsed_time = (now - acq_start_time_).total_milliseconds();
-    num_frames_ = (int32_t)floor((double)elapsed_time / 1000.0 / exposure_time_);
-    if (num_frames_ >= max_frames_){
-      num_frames_ = max_frames_;
+    int32_t frames_acquired = (int32_t)floor((double)elapsed_time / 1000.0 / exposure_time_);
+    if (frames_acquired >= max_frames_){
+      frames_acquired = max_frames_;
       acquisition_state_ = false;
     }
+    arrive_frames(frames_acquired - frames_arrived_);
   }
   *frames = num_frames_;
+  // An overrun is reported through the progress error flags, as by the hardware
+  if (dropped_frames_ > 0){
+    std::stringstream ss;
+    ss << "[SIM] xsp3_scaler_check_progress_details reported error flags [circular buffer overrun, "
+       << dropped_frames_ << " frames dropped from frame " << first_dropped_frame_ << "]";
+    setErrorString(ss.str());
+    status = XSP_STATUS_ERROR;
+  }
   return status;
 }
 
+/** Store newly acquired frames in the circular buffer.
+ *
+ * Frames arriving while the buffer holds buffer_frames_ unacknowledged frames
+ * are dropped.  Must be called with frame_mutex_ held.
+ *
+ * \param[in] frames - number of frames that have arrived.
+ */
+void LibXspressSimulator::arrive_frames(int32_t frames)
+{
+  for (int32_t frame = 0; frame < frames; frame++){
+    if (buffer_frames_ > 0 && (uint32_t)num_frames_ - frames_acked_ >= buffer_frames_){
+      if (first_dropped_frame_ < 0){
+        first_dropped_frame_ = frames_arrived_;
+        LOG4CXX_WARN(logger_, "[SIM] Circular buffer overrun at frame " << first_dropped_frame_
+                              << " with " << frames_acked_ << " frames acknowledged");
+      }
+      dropped_frames_++;
+    } else {
+      num_frames_++;
+    }
+    frames_arrived_++;
+  }
+  if (buffer_frames_ > 0){
+    buffer_high_water_ = std::max(buffer_high_water_, (uint32_t)num_frames_ - frames_acked_);
+  }
+}
+
+bool LibXspressSimulator::supports_frame_wait()
+{
+  return true;
+}
+
+/** Wait for the next simulated frame.
+ *
+ * Blocks until the simulated frame following the given frame number is due,
+ * the acquisition is started or stopped, or the timeout expires.
+ *
+ * \param[in] frames - number of frames already seen by the caller.
+ * \param[in] timeout_us - maximum time to wait in microseconds.
+ * \return status of the call.
+ */
+int LibXspressSimulator::wait_for_frames(int32_t frames, uint32_t timeout_us)
+{
+  boost::unique_lock<boost::mutex> lock(frame_mutex_);
+  boost::posix_time::ptime wake_time = boost::posix_time::microsec_clock::local_time() +
+                                       boost::posix_time::microseconds(timeout_us);
+  if (acquisition_state_){
+    boost::posix_time::ptime next_frame = acq_start_time_ +
+      boost::posix_time::microseconds((int64_t)((frames + 1) * exposure_time_ * 1000000.0));
+    if (next_frame < wake_time){
+      wake_time = next_frame;
+    }
+  }
+  frame_cond_.timed_wait(lock, wake_time);
+  return XSP_STATUS_OK;
+}
+
 int LibXspressSimulator::get_num_scalars(uint32_t *num_scalars)
 {
   *num_scalars = XSP3_SW_NUM_SCALERS;
@@ -616,21 +686,37 @@ int LibXspressSimulator::histogram_circ_ack(int channel,
                                           uint32_t max_channels)
 {
   int status = XSP_STATUS_OK;
+  boost::lock_guard<boost::mutex> lock(frame_mutex_);
+  if (frame_number + number_of_frames > (uint32_t)num_frames_){
+    checkErrorCode("[SIM] histogram_circ_ack acknowledged frames that have not been acquired", XSP3_RANGE_CHECK);
+    status = XSP_STATUS_ERROR;
+  } else if (frame_number + number_of_frames > frames_acked_){
+    frames_acked_ = frame_number + number_of_frames;
+  }
   return status;
 }
 
 int LibXspressSimulator::histogram_start(int card)
 {
   int status = XSP_STATUS_OK;
-  num_frames_=0;
   // Hook into the final start (card = 0)
   if (card == 0){
-    // Set the number of frames to 0
+    boost::lock_guard<boost::mutex> lock(frame_mutex_);
+    // Set the number of frames to 0 and empty the circular buffer
     num_frames_ = 0;
+    frames_arrived_ = 0;
+    frames_acked_ = 0;
+    dropped_frames_ = 0;
+    first_dropped_frame_ = -1;
+    buffer_high_water_ = 0;
     // Set the acquisition state to true
     acquisition_state_ = true;
+    // Start generating the simulated data (a no op if the parameters have not changed)
+    data_.generate(max_channels_, N_ENERGY_BINS, num_aux_data_, exposure_time_, windows_);
     // Record the start time so we know how many frames have acquired
     acq_start_time_ = boost::posix_time::microsec_clock::local_time();
+    // Wake anything waiting for frames
+    frame_cond_.notify_all();
   }
 
   /*
@@ -659,7 +745,11 @@ int LibXspressSimulator::histogram_arm(int card)
 int LibXspressSimulator::histogram_continue(int card)
 {
   int status = XSP_STATUS_OK;
-  num_frames_++;
+  {
+    // A software trigger acquires a single frame
+    boost::lock_guard<boost::mutex> lock(frame_mutex_);
+    arrive_frames(1);
+  }
   /*
   int xsp_status = xsp3_histogram_continue(xsp_handle_, card);
   if (xsp_status < XSP3_OK) {
@@ -686,6 +776,8 @@ int LibXspressSimulator::histogram_pause(int card)
 int LibXspressSimulator::histogram_stop(int card)
 {
   int status = XSP_STATUS_OK;
+  // Wake anything waiting for frames
+  frame_cond_.notify_all();
   /*
   int xsp_status = xsp3_histogram_stop(xsp_handle_, card);
   if (xsp_status < XSP3_OK){
@@ -720,10 +812,17 @@ int LibXspressSimulator::scaler_read(uint32_t *buffer,
                                    uint32_t start_chan,
                                    uint32_t num_chan)
 {
-  for (int index = 0; index < num_tf * num_chan; index++){
-    buffer[index] = 0;
-  }
   int status = XSP_STATUS_OK;
+  if (start_chan + num_chan > data_.get_num_channels()){
+    checkErrorCode("[SIM] scaler_read requested channels have not been generated", XSP3_RANGE_CHECK);
+    return XSP_STATUS_ERROR;
+  }
+  for (uint32_t t = tf; t < tf + num_tf; t++){
+    for (uint32_t chan = start_chan; chan < start_chan + num_chan; chan++){
+      memcpy(buffer, data_.scalars(t, chan), XSP3_SW_NUM_SCALERS * sizeof(uint32_t));
+      buffer += XSP3_SW_NUM_SCALERS;
+    }
+  }
   /*
   int xsp_status = xsp3_scaler_read(xsp_handle_, buffer, 0, start_chan, tf, XSP3_SW_NUM_SCALERS, num_chan, num_tf);
   if (xsp_status < XSP3_OK){
@@ -741,9 +840,18 @@ int LibXspressSimulator::calculate_dtc_factors(uint32_t *scalers,
                                              uint32_t start_chan,
                                              uint32_t num_chan)
 {
-  for (int index = 0; index < num_chan; index++){
-    dtc_factors[index] = index + 1.0;
-    inp_est[index] = index - 1.0;
+  // Recover the incident counts from the events lost to resets and pileup
+  for (uint32_t index = 0; index < frames * num_chan; index++){
+    uint32_t *scalar = &scalers[index * XSP3_SW_NUM_SCALERS];
+    double live = 1.0;
+    if (scalar[SIM_SCALAR_TIME] > 0){
+      live = (double)(scalar[SIM_SCALAR_TIME] - scalar[SIM_SCALAR_RESET_TICKS]) / (double)scalar[SIM_SCALAR_TIME];
+    }
+    inp_est[index] = (double)scalar[SIM_SCALAR_ALL_EVENT] / live;
+    dtc_factors[index] = 1.0;
+    if (scalar[SIM_SCALAR_ALL_GOOD] > 0){
+      dtc_factors[index] = inp_est[index] / (double)scalar[SIM_SCALAR_ALL_GOOD];
+    }
   }
   int status = XSP_STATUS_OK;
   /*
@@ -779,19 +887,27 @@ int LibXspressSimulator::histogram_memcpy(uint32_t *buffer,
   int thisPath, chanIdx;
   bool circ_buffer;
 
-  uint32_t *local_buffer;
-  // uint32_t local_buffer[4096];
-  for(int chan=start_chan; chan < start_chan + num_chan; chan++)
+  if (num_eng > data_.get_num_eng() || num_aux != data_.get_num_aux() || start_chan + num_chan > data_.get_num_channels()){
+    checkErrorCode("[SIM] histogram_memcpy: Requested region mismatch", XSP3_RANGE_CHECK);
+    return XSP_STATUS_ERROR;
+  }
+  for (uint32_t t = tf; t < tf + num_tf; t++)
   {
-    // for (int i = 0; i < 4096; i++){
-    //   local_buffer[i] = (uint32_t)((double)simulated_mca_[i] * (9.0 + rand_gen()));    
-    // }
-    local_buffer = (uint32_t *)(simulated_mca_);    
-    memcpy(buffer, local_buffer, 4096*sizeof(int32_t));
-    buffer+=num_eng*num_aux;
+    for (uint32_t chan = start_chan; chan < start_chan + num_chan; chan++)
+    {
+      frame_ptr = data_.spectrum(t, chan);
+      if (num_eng == data_.get_num_eng()){
+        memcpy(buffer, frame_ptr, num_eng * num_aux * sizeof(uint32_t));
+      } else {
+        // Copy the requested energy bins out of each aux plane
+        for (uint32_t aux = 0; aux < num_aux; aux++){
+          memcpy(buffer + (aux * num_eng), frame_ptr + (aux * data_.get_num_eng()), num_eng * sizeof(uint32_t));
+        }
+      }
+      buffer += num_eng * num_aux;
+    }
   }
 
-
   /*
   if (xsp_handle_ < 0 || xsp_handle_ >= XSP3_MAX_PATH || !Xsp3Sys[xsp_handle_].valid){
     checkErrorCode("histogram_memcpy", XSP3_INVALID_PATH);
@@ -835,6 +951,36 @@ int LibXspressSimulator::histogram_memcpy(uint32_t *buffer,
   return status;
 }
 
+bool LibXspressSimulator::supports_zero_copy()
+{
+  return true;
+}
+
+int LibXspressSimulator::histogram_frame_ptrs(std::vector<uint32_t *>& frame_ptrs,
+                                              uint32_t tf,
+                                              uint32_t num_tf,
+                                              uint32_t total_tf,
+                                              uint32_t num_eng,
+                                              uint32_t num_aux,
+                                              uint32_t start_chan,
+                                              uint32_t num_chan)
+{
+  int status = XSP_STATUS_OK;
+  frame_ptrs.clear();
+  if (num_eng != data_.get_num_eng() || num_aux != data_.get_num_aux() || start_chan + num_chan > data_.get_num_channels()){
+    checkErrorCode("[SIM] histogram_frame_ptrs: Requested region mismatch", XSP3_RANGE_CHECK);
+    status = XSP_STATUS_ERROR;
+  } else {
+    // Frames are served out of the simulated data ring
+    for (uint32_t t = tf; t < tf + num_tf; t++){
+      for (uint32_t chan = start_chan; chan < start_chan + num_chan; chan++){
+        frame_ptrs.push_back(data_.spectrum(t, chan));
+      }
+    }
+  }
+  return status;
+}
+
 int LibXspressSimulator::validate_histogram_dims(uint32_t num_eng,
                                                uint32_t num_aux,
                                                uint32_t start_chan,
@@ -907,6 +1053,7 @@ int LibXspressSimulator::validate_histogram_dims(uint32_t num_eng,
     *buffer_length = (uint32_t) (total_tf);
   }
   */
+  *buffer_length = buffer_frames_;
   return status;
 }
 
@@ -922,6 +1069,16 @@ int LibXspressSimulator::set_window(int chan, int sca, int llm, int hlm)
     checkErrorCode("[SIM] set_window SCA low limit is higher than high limit", XSP3_RANGE_CHECK);
     status = XSP_STATUS_ERROR;
   } else {
+    // Record the window so that the simulated in window scalars match
+    if (chan >= 0 && chan < (int)windows_.size()){
+      if (sca == 0){
+        windows_[chan].window0_low = llm;
+        windows_[chan].window0_high = hlm;
+      } else {
+        windows_[chan].window1_low = llm;
+        windows_[chan].window1_high = hlm;
+      }
+    }
     /*
     xsp_status = xsp3_set_window(xsp_handle_, chan, sca, llm, hlm);
     if (xsp_status != XSP3_OK) {
@@ -981,4 +1138,87 @@ int LibXspressSimulator::setup_marker_channels()
   return XSP_STATUS_OK;
 }
 
+/** Set the count rate incident on each simulated channel.
+ *
+ * \param[in] count_rate - counts per second.
+ */
+void LibXspressSimulator::set_count_rate(double count_rate)
+{
+  data_.set_count_rate(count_rate);
+}
+
+double LibXspressSimulator::get_count_rate()
+{
+  return data_.get_count_rate();
+}
+
+/** Set the number of frames generated before the simulated data repeats.
+ *
+ * \param[in] ring_frames - number of frames (limited by available memory).
+ */
+void LibXspressSimulator::set_ring_frames(uint32_t ring_frames)
+{
+  data_.set_ring_frames(ring_frames);
+}
+
+uint32_t LibXspressSimulator::get_ring_frames()
+{
+  return data_.get_ring_frames();
+}
+
+/** Set the number of background threads used to generate the simulated data.
+ *
+ * \param[in] num_threads - number of threads.
+ */
+void LibXspressSimulator::set_generator_threads(uint32_t num_threads)
+{
+  data_.set_num_threads(num_threads);
+}
+
+uint32_t LibXspressSimulator::get_generator_threads()
+{
+  return data_.get_num_threads();
+}
+
+/** Return the number of frames held in the simulated circular buffer.
+ *
+ * \return number of frames, 0 if the buffer is unlimited.
+ */
+uint32_t LibXspressSimulator::get_buffer_frames()
+{
+  return buffer_frames_;
+}
+
+/** Return the largest number of unacknowledged frames held in the circular
+ * buffer during the current or last acquisition.
+ *
+ * \return number of frames.
+ */
+uint32_t LibXspressSimulator::get_buffer_high_water()
+{
+  boost::lock_guard<boost::mutex> lock(frame_mutex_);
+  return buffer_high_water_;
+}
+
+/** Return the number of frames dropped because the circular buffer was full
+ * during the current or last acquisition.
+ *
+ * \return number of frames.
+ */
+uint32_t LibXspressSimulator::get_dropped_frame_count()
+{
+  boost::lock_guard<boost::mutex> lock(frame_mutex_);
+  return dropped_frames_;
+}
+
+/** Return the first frame dropped during the current or last acquisition.
+ *
+ * \return frame number, -1 if no frames have been dropped.
+ */
+int32_t LibXspressSimulator::get_first_dropped_frame()
+{
+  boost::lock_guard<boost::mutex> lock(frame_mutex_);
+  return first_dropped_frame_;
+}
+
 } /* namespace Xspress */
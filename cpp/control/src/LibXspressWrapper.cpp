@@ -876,6 +876,18 @@ int LibXspressWrapper::get_num_frames_read(int32_t *frames)
   return status;
 }
 
+bool LibXspressWrapper::supports_frame_wait()
+{
+  // libxspress provides no notification of new frames so progress must be polled
+  return false;
+}
+
+int LibXspressWrapper::wait_for_frames(int32_t frames, uint32_t timeout_us)
+{
+  setErrorString("wait_for_frames is not supported by libxspress");
+  return XSP_STATUS_ERROR;
+}
+
 int LibXspressWrapper::get_num_scalars(uint32_t *num_scalars)
 {
   *num_scalars = XSP3_SW_NUM_SCALERS;
@@ -1075,6 +1087,75 @@ int LibXspressWrapper::histogram_memcpy(uint32_t *buffer,
   return status;
 }
 
+bool LibXspressWrapper::supports_zero_copy()
+{
+  // The Xspress 3 Mini histogram memory can only be read through the library
+  bool supported = false;
+  if (xsp_handle_ >= 0 && xsp_handle_ < XSP3_MAX_PATH && Xsp3Sys[xsp_handle_].valid){
+    supported = (Xsp3Sys[xsp_handle_].features.generation != XspressGen3Mini);
+  }
+  return supported;
+}
+
+/** Return pointers to frames held in the histogram memory.
+ *
+ * One pointer is returned for each channel of each frame, ordered by frame
+ * and then by channel, pointing at num_eng * num_aux values.  The memory
+ * remains valid until the frames are acknowledged with histogram_circ_ack.
+ */
+int LibXspressWrapper::histogram_frame_ptrs(std::vector<uint32_t *>& frame_ptrs,
+                                            uint32_t tf,
+                                            uint32_t num_tf,
+                                            uint32_t total_tf,
+                                            uint32_t num_eng,
+                                            uint32_t num_aux,
+                                            uint32_t start_chan,
+                                            uint32_t num_chan)
+{
+  int status = XSP_STATUS_OK;
+  int xsp_status;
+
+  frame_ptrs.clear();
+  if (xsp_handle_ < 0 || xsp_handle_ >= XSP3_MAX_PATH || !Xsp3Sys[xsp_handle_].valid) {
+    checkErrorCode("histogram_frame_ptrs", XSP3_INVALID_PATH);
+    status = XSP_STATUS_ERROR;
+  }
+  else if (Xsp3Sys[xsp_handle_].features.generation == XspressGen3Mini) {
+    setErrorString("histogram_frame_ptrs is not supported by Xspress 3 Mini");
+    status = XSP_STATUS_ERROR;
+  }
+  else {
+    uint32_t twrap;
+    uint32_t *frame_ptr;
+    int thisPath, chanIdx;
+
+    bool circ_buffer = (bool)(Xsp3Sys[xsp_handle_].run_flags & XSP3_RUN_FLAGS_CIRCULAR_BUFFER);
+    if (tf > total_tf && !circ_buffer) {
+      LOG4CXX_ERROR(logger_, "Requested timeframe " << tf << " lies beyond end of buffer (length " << total_tf <<")");
+      checkErrorCode("histogram_frame_ptrs", XSP3_RANGE_CHECK);
+      status = XSP_STATUS_ERROR;
+    }
+    for (uint32_t t = tf; t < tf + num_tf && status == XSP_STATUS_OK; t++) {
+      if (circ_buffer){
+        twrap = t % total_tf;
+      } else {
+        twrap = t;
+      }
+      for (uint32_t c = start_chan; c < start_chan + num_chan; c++) {
+        if ((xsp_status = xsp3_resolve_path(xsp_handle_, c, &thisPath, &chanIdx)) < 0){
+          checkErrorCode("xsp3_resolve_path", xsp_status);
+          status = XSP_STATUS_ERROR;
+        } else {
+          frame_ptr = Xsp3Sys[thisPath].histogram[chanIdx].buffer;
+          frame_ptr += num_eng * num_aux * twrap;
+          frame_ptrs.push_back(frame_ptr);
+        }
+      }
+    }
+  }
+  return status;
+}
+
 int LibXspressWrapper::validate_histogram_dims(uint32_t num_eng,
                                                uint32_t num_aux,
                                                uint32_t start_chan,
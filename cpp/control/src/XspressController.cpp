@@ -47,6 +47,9 @@ const std::string XspressController::CONFIG_XSP_DEBOUNCE              = "debounc
 const std::string XspressController::CONFIG_XSP_EXPOSURE_TIME         = "exposure_time";
 const std::string XspressController::CONFIG_XSP_FRAMES                = "num_images";
 const std::string XspressController::CONFIG_XSP_MODE                  = "mode";
+const std::string XspressController::CONFIG_XSP_SIM_COUNT_RATE        = "sim_count_rate";
+const std::string XspressController::CONFIG_XSP_SIM_RING_FRAMES       = "sim_ring_frames";
+const std::string XspressController::CONFIG_XSP_SIM_THREADS           = "sim_threads";
 const std::string XspressController::CONFIG_XSP_SCA5_LOW              = "sca5_low_lim";
 const std::string XspressController::CONFIG_XSP_SCA5_HIGH             = "sca5_high_lim";
 const std::string XspressController::CONFIG_XSP_SCA6_LOW              = "sca6_low_lim";
@@ -66,6 +69,18 @@ const std::string XspressController::CONFIG_XSP_DTC_IN_WIN_RATE_GRAD  = "dtc_in_
 const std::string XspressController::CONFIG_DAQ                       = "daq";
 const std::string XspressController::CONFIG_DAQ_ENABLED               = "enabled";
 const std::string XspressController::CONFIG_DAQ_ZMQ_ENDPOINTS         = "endpoints";
+const std::string XspressController::CONFIG_DAQ_BATCH_SIZE            = "batch_size";
+const std::string XspressController::CONFIG_DAQ_FRAMES_PER_MESSAGE    = "frames_per_message";
+const std::string XspressController::CONFIG_DAQ_POOL_BUFFERS          = "pool_buffers";
+const std::string XspressController::CONFIG_DAQ_WAIT_POLICY           = "wait_policy";
+const std::string XspressController::CONFIG_DAQ_WAIT_MAX_US           = "wait_max_us";
+const std::string XspressController::CONFIG_DAQ_LIVE_UPDATE_FRAMES     = "live_update_frames";
+const std::string XspressController::CONFIG_DAQ_LIVE_UPDATE_MS         = "live_update_ms";
+const std::string XspressController::CONFIG_DAQ_CONTROL_CPUS           = "control_cpus";
+const std::string XspressController::CONFIG_DAQ_WORKER_CPUS            = "worker_cpus";
+const std::string XspressController::CONFIG_DAQ_IO_CPUS                = "io_cpus";
+const std::string XspressController::CONFIG_DAQ_WORK_STEALING          = "work_stealing";
+const std::string XspressController::CONFIG_DAQ_ZERO_COPY              = "zero_copy";
 
 const std::string XspressController::CONFIG_CMD                       = "command";
 const std::string XspressController::CONFIG_CMD_CONNECT               = "connect";
@@ -91,6 +106,11 @@ const std::string XspressController::STATUS_CHANNELS_CONNECTED        = "num_ch_
 const std::string XspressController::STATUS_CARDS_CONNECTED           = "cards_connected";
 const std::string XspressController::STATUS_CHANNEL_FRAMES            = "ch_frames_acquired";
 const std::string XspressController::STATUS_FEM_DROPPED_FRAMES        = "fem_dropped_frames";
+const std::string XspressController::STATUS_DAQ_POOL_BUFFERS          = "daq_pool_buffers";
+const std::string XspressController::STATUS_DAQ_POOL_FREE             = "daq_pool_free";
+const std::string XspressController::STATUS_DAQ_POOL_EXHAUSTED        = "daq_pool_exhausted";
+const std::string XspressController::STATUS_DAQ_POLL_CPU_TIME         = "daq_poll_cpu_time";
+const std::string XspressController::STATUS_DAQ_POLL_CPU_LOAD         = "daq_poll_cpu_load";
 const std::string XspressController::STATUS_LIVE_SCALAR[]             = {"scalar_0",
                                                                          "scalar_1",
                                                                          "scalar_2",
@@ -102,6 +122,10 @@ const std::string XspressController::STATUS_LIVE_SCALAR[]             = {"scalar
                                                                          "scalar_8"};
 const std::string XspressController::STATUS_LIVE_DTC                  = "dtc";
 const std::string XspressController::STATUS_LIVE_INP_EST              = "inp_est";
+const std::string XspressController::STATUS_LIVE_INP_EST_MIN          = "inp_est_min";
+const std::string XspressController::STATUS_LIVE_INP_EST_MAX          = "inp_est_max";
+const std::string XspressController::STATUS_LIVE_INP_EST_MEAN         = "inp_est_mean";
+const std::string XspressController::STATUS_LIVE_WINDOW_FRAMES        = "live_window_frames";
 
 const std::string XspressController::STATUS_TEMPERATURE[]             = {"temp_0",
                                                                          "temp_1",
@@ -306,26 +330,49 @@ void XspressController::provideStatus(OdinData::IpcMessage& reply)
     reply.set_param(XspressController::STATUS + "/" +
                     XspressController::STATUS_FEM_DROPPED_FRAMES + "[]", dropped_frames[index]);
   }
+  // DAQ frame buffer pool usage
+  reply.set_param(XspressController::STATUS + "/" +
+    XspressController::STATUS_DAQ_POOL_BUFFERS, xsp_->getXspDAQPoolAllocated());
+  reply.set_param(XspressController::STATUS + "/" +
+    XspressController::STATUS_DAQ_POOL_FREE, xsp_->getXspDAQPoolFree());
+  reply.set_param(XspressController::STATUS + "/" +
+    XspressController::STATUS_DAQ_POOL_EXHAUSTED, xsp_->getXspDAQPoolExhausted());
+  // DAQ control thread CPU usage while polling for frames
+  reply.set_param(XspressController::STATUS + "/" +
+    XspressController::STATUS_DAQ_POLL_CPU_TIME, xsp_->getXspDAQPollCpuTime());
+  reply.set_param(XspressController::STATUS + "/" +
+    XspressController::STATUS_DAQ_POLL_CPU_LOAD, xsp_->getXspDAQPollCpuLoad());
 
+  // Take a single consistent snapshot of the live values from latest MCA
+  std::vector<XspressLiveChannel> live_data;
+  xsp_->getLiveData(live_data);
   // Live scalar values from latest MCA
   for (int sc_index = 0; sc_index < NUMBER_OF_SCALARS; sc_index++){
-    std::vector<uint32_t> live_scalars = xsp_->getLiveScalars(sc_index);
-    for (int index = 0; index < live_scalars.size(); index++){
+    for (size_t index = 0; index < live_data.size(); index++){
       reply.set_param(XspressController::STATUS + "/" +
-                      XspressController::STATUS_LIVE_SCALAR[sc_index] + "[]", live_scalars[index]);
+                      XspressController::STATUS_LIVE_SCALAR[sc_index] + "[]", live_data[index].scalars[sc_index]);
     }
   }
   // Live DTC factors from latest MCA
-  std::vector<double> live_dtc = xsp_->getLiveDtcFactors();
-  for (int index = 0; index < live_dtc.size(); index++){
+  for (size_t index = 0; index < live_data.size(); index++){
     reply.set_param(XspressController::STATUS + "/" +
-                    XspressController::STATUS_LIVE_DTC + "[]", live_dtc[index]);
+                    XspressController::STATUS_LIVE_DTC + "[]", live_data[index].dtc);
   }
   // Live input estimates from latest MCA
-  std::vector<double> live_inp_est = xsp_->getLiveInpEst();
-  for (int index = 0; index < live_inp_est.size(); index++){
+  for (size_t index = 0; index < live_data.size(); index++){
     reply.set_param(XspressController::STATUS + "/" +
-                    XspressController::STATUS_LIVE_INP_EST + "[]", live_inp_est[index]);
+                    XspressController::STATUS_LIVE_INP_EST + "[]", live_data[index].inp_est);
+  }
+  // Input estimate aggregates over the last live update window
+  for (size_t index = 0; index < live_data.size(); index++){
+    reply.set_param(XspressController::STATUS + "/" +
+                    XspressController::STATUS_LIVE_INP_EST_MIN + "[]", live_data[index].inp_est_min);
+    reply.set_param(XspressController::STATUS + "/" +
+                    XspressController::STATUS_LIVE_INP_EST_MAX + "[]", live_data[index].inp_est_max);
+    reply.set_param(XspressController::STATUS + "/" +
+                    XspressController::STATUS_LIVE_INP_EST_MEAN + "[]", live_data[index].inp_est_mean);
+    reply.set_param(XspressController::STATUS + "/" +
+                    XspressController::STATUS_LIVE_WINDOW_FRAMES + "[]", live_data[index].window_frames);
   }
 
   // Temperatures
@@ -610,6 +657,27 @@ void XspressController::configureXsp(OdinData::IpcMessage& config, OdinData::Ipc
     }
   }
 
+  // Check for the simulated count rate
+  if (config.has_param(XspressController::CONFIG_XSP_SIM_COUNT_RATE)) {
+    double count_rate = config.get_param<double>(XspressController::CONFIG_XSP_SIM_COUNT_RATE);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "sim_count_rate set to  " << count_rate);
+    xsp_->setXspSimCountRate(count_rate);
+  }
+
+  // Check for the number of simulated frames generated before the data repeats
+  if (config.has_param(XspressController::CONFIG_XSP_SIM_RING_FRAMES)) {
+    uint32_t ring_frames = config.get_param<uint32_t>(XspressController::CONFIG_XSP_SIM_RING_FRAMES);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "sim_ring_frames set to  " << ring_frames);
+    xsp_->setXspSimRingFrames(ring_frames);
+  }
+
+  // Check for the number of simulated data generator threads
+  if (config.has_param(XspressController::CONFIG_XSP_SIM_THREADS)) {
+    uint32_t num_threads = config.get_param<uint32_t>(XspressController::CONFIG_XSP_SIM_THREADS);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "sim_threads set to  " << num_threads);
+    xsp_->setXspSimThreads(num_threads);
+  }
+
   // Check for sc5 low limit array parameter
   if (config.has_param(XspressController::CONFIG_XSP_SCA5_LOW)){
     const rapidjson::Value& val = config.get_param<const rapidjson::Value&>(XspressController::CONFIG_XSP_SCA5_LOW);
@@ -729,6 +797,120 @@ void XspressController::configureDAQ(OdinData::IpcMessage& config, OdinData::Ipc
     xsp_->setXspDAQEndpoints(eps);
   }
 
+  // Check if the number of frames to send per DAQ message or the number of frames each frame
+  // receiver buffer can hold has been specified.  The latter must match the frames_per_message
+  // decoder setting, which the control server sends to the frame receivers from the same
+  // batch size, and both are applied together
+  if (config.has_param(XspressController::CONFIG_DAQ_BATCH_SIZE) ||
+      config.has_param(XspressController::CONFIG_DAQ_FRAMES_PER_MESSAGE)){
+    uint32_t batch_size = xsp_->getXspDAQBatchSize();
+    uint32_t frames_per_message = xsp_->getXspDAQFramesPerMessage();
+    if (config.has_param(XspressController::CONFIG_DAQ_BATCH_SIZE)){
+      batch_size = config.get_param<uint32_t>(XspressController::CONFIG_DAQ_BATCH_SIZE);
+    }
+    if (config.has_param(XspressController::CONFIG_DAQ_FRAMES_PER_MESSAGE)){
+      frames_per_message = config.get_param<uint32_t>(XspressController::CONFIG_DAQ_FRAMES_PER_MESSAGE);
+    }
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ batch size set to  " << batch_size
+                                    << " with frames per message " << frames_per_message);
+    int status = xsp_->setXspDAQBatchSize(batch_size, frames_per_message);
+    if (status != XSP_STATUS_OK){
+      // Command failed, return error with any error string
+      reply.set_nack(xsp_->getErrorString());
+      setError(xsp_->getErrorString());
+    }
+  }
+
+  // Check if the number of pooled frame buffers has been specified
+  if (config.has_param(XspressController::CONFIG_DAQ_POOL_BUFFERS)){
+    uint32_t pool_buffers = config.get_param<uint32_t>(XspressController::CONFIG_DAQ_POOL_BUFFERS);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ pool buffers set to  " << pool_buffers);
+    xsp_->setXspDAQPoolBuffers(pool_buffers);
+  }
+
+  // Check if the policy used while waiting for frames has been specified
+  if (config.has_param(XspressController::CONFIG_DAQ_WAIT_POLICY)){
+    std::string wait_policy = config.get_param<std::string>(XspressController::CONFIG_DAQ_WAIT_POLICY);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ wait policy set to  " << wait_policy);
+    int status = xsp_->setXspDAQWaitPolicy(wait_policy);
+    if (status != XSP_STATUS_OK){
+      // Command failed, return error with any error string
+      reply.set_nack(xsp_->getErrorString());
+      setError(xsp_->getErrorString());
+    }
+  }
+
+  // Check if the maximum time to wait between polls has been specified
+  if (config.has_param(XspressController::CONFIG_DAQ_WAIT_MAX_US)){
+    uint32_t wait_max_us = config.get_param<uint32_t>(XspressController::CONFIG_DAQ_WAIT_MAX_US);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ maximum wait set to  " << wait_max_us);
+    xsp_->setXspDAQWaitMaxUs(wait_max_us);
+  }
+
+  // Check if the number of frames between live data updates has been specified
+  if (config.has_param(XspressController::CONFIG_DAQ_LIVE_UPDATE_FRAMES)){
+    uint32_t update_frames = config.get_param<uint32_t>(XspressController::CONFIG_DAQ_LIVE_UPDATE_FRAMES);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ live update frames set to  " << update_frames);
+    xsp_->setXspDAQLiveUpdateFrames(update_frames);
+  }
+
+  // Check if the time between live data updates has been specified
+  if (config.has_param(XspressController::CONFIG_DAQ_LIVE_UPDATE_MS)){
+    uint32_t update_ms = config.get_param<uint32_t>(XspressController::CONFIG_DAQ_LIVE_UPDATE_MS);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ live update time set to  " << update_ms);
+    xsp_->setXspDAQLiveUpdateMs(update_ms);
+  }
+
+  // Check if frame reading should be shared between the worker threads
+  if (config.has_param(XspressController::CONFIG_DAQ_WORK_STEALING)){
+    bool work_stealing = config.get_param<bool>(XspressController::CONFIG_DAQ_WORK_STEALING);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ work stealing set to  " << work_stealing);
+    xsp_->setXspDAQWorkStealing(work_stealing);
+  }
+
+  // Check if MCA data should be sent directly from the histogram memory
+  if (config.has_param(XspressController::CONFIG_DAQ_ZERO_COPY)){
+    bool zero_copy = config.get_param<bool>(XspressController::CONFIG_DAQ_ZERO_COPY);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ zero copy set to  " << zero_copy);
+    xsp_->setXspDAQZeroCopy(zero_copy);
+  }
+
+  // Check if the ZMQ IO thread CPUs have been specified, this must be set before the DAQ is enabled
+  if (config.has_param(XspressController::CONFIG_DAQ_IO_CPUS)){
+    std::string io_cpus = config.get_param<std::string>(XspressController::CONFIG_DAQ_IO_CPUS);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ IO thread CPUs set to  " << io_cpus);
+    xsp_->setXspDAQIoCpus(io_cpus);
+  }
+
+  // Check if the control thread CPUs have been specified
+  if (config.has_param(XspressController::CONFIG_DAQ_CONTROL_CPUS)){
+    std::string control_cpus = config.get_param<std::string>(XspressController::CONFIG_DAQ_CONTROL_CPUS);
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "DAQ control thread CPUs set to  " << control_cpus);
+    int status = xsp_->setXspDAQControlCpus(control_cpus);
+    if (status != XSP_STATUS_OK){
+      // Command failed, return error with any error string
+      reply.set_nack(xsp_->getErrorString());
+      setError(xsp_->getErrorString());
+    }
+  }
+
+  // Check if the worker thread CPUs have been specified, one CPU list for each worker
+  if (config.has_param(XspressController::CONFIG_DAQ_WORKER_CPUS)){
+    const rapidjson::Value& val = config.get_param<const rapidjson::Value&>(XspressController::CONFIG_DAQ_WORKER_CPUS);
+    std::vector<std::string> worker_cpus;
+    for (rapidjson::SizeType i = 0; i < val.Size(); i++) {
+      std::string cpus = val[i].GetString();
+      LOG4CXX_DEBUG_LEVEL(1, logger_, "Adding DAQ worker CPUs [" << cpus << "]");
+      worker_cpus.push_back(cpus);
+    }
+    int status = xsp_->setXspDAQWorkerCpus(worker_cpus);
+    if (status != XSP_STATUS_OK){
+      // Command failed, return error with any error string
+      reply.set_nack(xsp_->getErrorString());
+      setError(xsp_->getErrorString());
+    }
+  }
+
   // Check if DAQ is to be enabled
   if (config.has_param(XspressController::CONFIG_DAQ_ENABLED)){
     bool enable_daq = config.get_param<bool>(XspressController::CONFIG_DAQ_ENABLED);
@@ -898,6 +1080,12 @@ void XspressController::requestConfiguration(OdinData::IpcMessage& reply)
                   XspressController::CONFIG_XSP_FRAMES, xsp_->getXspFrames());
   reply.set_param(XspressController::CONFIG_XSP + "/" +
                   XspressController::CONFIG_XSP_MODE, xsp_->getXspMode());
+  reply.set_param(XspressController::CONFIG_XSP + "/" +
+                  XspressController::CONFIG_XSP_SIM_COUNT_RATE, xsp_->getXspSimCountRate());
+  reply.set_param(XspressController::CONFIG_XSP + "/" +
+                  XspressController::CONFIG_XSP_SIM_RING_FRAMES, xsp_->getXspSimRingFrames());
+  reply.set_param(XspressController::CONFIG_XSP + "/" +
+                  XspressController::CONFIG_XSP_SIM_THREADS, xsp_->getXspSimThreads());
 
   std::vector<uint32_t> sca5ll = xsp_->getSca5LowLimits();
   for (int index = 0; index < sca5ll.size(); index++){
@@ -983,6 +1171,33 @@ void XspressController::requestConfiguration(OdinData::IpcMessage& reply)
     reply.set_param(XspressController::CONFIG_DAQ + "/" +
                     XspressController::CONFIG_DAQ_ZMQ_ENDPOINTS + "[]", eps[index]);
   }
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_BATCH_SIZE, xsp_->getXspDAQBatchSize());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_FRAMES_PER_MESSAGE, xsp_->getXspDAQFramesPerMessage());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_POOL_BUFFERS, xsp_->getXspDAQPoolBuffers());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_WAIT_POLICY, xsp_->getXspDAQWaitPolicy());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_WAIT_MAX_US, xsp_->getXspDAQWaitMaxUs());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_LIVE_UPDATE_FRAMES, xsp_->getXspDAQLiveUpdateFrames());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_LIVE_UPDATE_MS, xsp_->getXspDAQLiveUpdateMs());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_CONTROL_CPUS, xsp_->getXspDAQControlCpus());
+  std::vector<std::string> worker_cpus = xsp_->getXspDAQWorkerCpus();
+  for (size_t index = 0; index < worker_cpus.size(); index++){
+    reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                    XspressController::CONFIG_DAQ_WORKER_CPUS + "[]", worker_cpus[index]);
+  }
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_IO_CPUS, xsp_->getXspDAQIoCpus());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_WORK_STEALING, xsp_->getXspDAQWorkStealing());
+  reply.set_param(XspressController::CONFIG_DAQ + "/" +
+                  XspressController::CONFIG_DAQ_ZERO_COPY, xsp_->getXspDAQZeroCopy());
   provideStatus(reply);
   provideVersion(reply);
   provideAPIVersion(reply);
@@ -999,6 +1214,7 @@ void XspressController::resetStatistics(OdinData::IpcMessage& reply)
 {
   LOG4CXX_DEBUG_LEVEL(1, logger_, "Reset statistics requested");
   bool reset_ok = true;
+  xsp_->resetDAQStatistics();
 }
 
 void XspressController::run() {
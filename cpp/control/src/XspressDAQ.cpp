@@ -6,19 +6,137 @@
  */
 
 #include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
 
 #include "XspressDAQ.h"
 #include "DebugLevelLogger.h"
 
-#define HEADER_ITEMS 6
+#define HEADER_ITEMS 7
+#define DEFAULT_POOL_BUFFERS 256
+#define DEFAULT_WAIT_MAX_US 1000
+#define DEFAULT_LIVE_UPDATE_MS 100
+// Number of idle polls before a waiting control thread starts to yield or sleep
+#define WAIT_SPIN_COUNT 100
+
+static uint64_t timespec_ns(const struct timespec& ts)
+{
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/** Parse a CPU list of the form "0-3,8,10-11" into a vector of CPU numbers.
+ *
+ * \param[in] cpus - CPU list string.
+ * \param[out] cpu_list - vector of CPU numbers.
+ * \return true if the string was parsed successfully.
+ */
+static bool parse_cpu_list(const std::string& cpus, std::vector<int>& cpu_list)
+{
+  cpu_list.clear();
+  std::stringstream ss(cpus);
+  std::string item;
+  while (std::getline(ss, item, ',')){
+    if (item.empty()){
+      continue;
+    }
+    int first = 0;
+    int last = 0;
+    char dash = 0;
+    std::stringstream range(item);
+    range >> first;
+    if (range.fail() || first < 0){
+      return false;
+    }
+    last = first;
+    if (range >> dash){
+      if (dash != '-' || !(range >> last) || last < first){
+        return false;
+      }
+    }
+    for (int cpu = first; cpu <= last; cpu++){
+      if (cpu >= CPU_SETSIZE){
+        return false;
+      }
+      cpu_list.push_back(cpu);
+    }
+  }
+  return true;
+}
 
 void free_frame(void *data, void *hint)
 {
-  free(data);
+  // Buffers taken from the pool are passed with the pool as the hint
+  if (hint){
+    static_cast<Xspress::XspressDAQBufferPool *>(hint)->release(data);
+  } else {
+    free(data);
+  }
+}
+
+void release_zero_copy(void *data, void *hint)
+{
+  // The histogram memory is only released once every part of the message has been sent
+  Xspress::XspressDAQZeroCopyRef *ref = static_cast<Xspress::XspressDAQZeroCopyRef *>(hint);
+  if (ref->parts_.fetch_sub(1) == 1){
+    ref->tracker_->release(ref->first_frame_, ref->num_frames_);
+    delete ref;
+  }
 }
 
 namespace Xspress
 {
+/** Construct a new XspressDAQReleaseTracker class.
+ *
+ * \param[in] buffer_length - number of frames held in the circular buffer.
+ * \param[in] num_endpoints - number of endpoints that send each frame.
+ */
+XspressDAQReleaseTracker::XspressDAQReleaseTracker(uint32_t buffer_length, uint32_t num_endpoints) :
+    buffer_length_(buffer_length),
+    num_endpoints_(num_endpoints)
+{
+  slots_.reset(new boost::atomic<uint32_t>[buffer_length_]);
+  for (uint32_t index = 0; index < buffer_length_; index++){
+    slots_[index] = 0;
+  }
+}
+
+/** Record that one endpoint has released a range of frames.
+ *
+ * Called from the ZeroMQ IO threads.
+ *
+ * \param[in] first_frame - the first frame released.
+ * \param[in] num_frames - the number of frames released.
+ */
+void XspressDAQReleaseTracker::release(uint32_t first_frame, uint32_t num_frames)
+{
+  for (uint32_t frame = first_frame; frame < first_frame + num_frames; frame++){
+    slots_[frame % buffer_length_]++;
+  }
+}
+
+/** Count the frames that have been released by every endpoint.
+ *
+ * Counting stops at the first frame that is still referenced.  The counted
+ * slots are cleared ready for reuse, so the caller must acknowledge the
+ * frames.  Only the DAQ control thread may call this method.
+ *
+ * \param[in] first_frame - the first frame not yet acknowledged.
+ * \param[in] max_frames - the number of frames that have been dispatched.
+ * \return number of frames that can be acknowledged.
+ */
+uint32_t XspressDAQReleaseTracker::releasable(uint32_t first_frame, uint32_t max_frames)
+{
+  uint32_t frames = 0;
+  while (frames < max_frames && slots_[(first_frame + frames) % buffer_length_] == num_endpoints_){
+    slots_[(first_frame + frames) % buffer_length_] = 0;
+    frames++;
+  }
+  return frames;
+}
+
 /** Construct a new XspressDAQ class.
  *
  * The constructor sets up logging used within the class, and initialises
@@ -27,7 +145,24 @@ namespace Xspress
 XspressDAQ::XspressDAQ(boost::shared_ptr<ILibXspress> detector_ptr,
                        uint32_t num_channels,
                        uint32_t num_spectra,
-                       std::vector<std::string> endpoints):
+                       std::vector<std::string> endpoints,
+                       const std::string& io_cpus):
+    batch_size_(1),
+    acq_batch_size_(1),
+    num_scalars_(0),
+    work_stealing_(false),
+    zero_copy_(false),
+    acq_zero_copy_(false),
+    pool_buffers_(DEFAULT_POOL_BUFFERS),
+    wait_policy_(DAQ_WAIT_POLICY_BACKOFF),
+    wait_max_us_(DEFAULT_WAIT_MAX_US),
+    poll_cpu_ns_(0),
+    acq_poll_cpu_ns_(0),
+    acq_wall_ns_(0),
+    live_update_frames_(0),
+    live_update_ms_(DEFAULT_LIVE_UPDATE_MS),
+    io_cpus_(io_cpus),
+    buffer_length_(0),
     waiting_for_acq_(true),
     acq_running_(false),
     no_of_frames_(0),
@@ -40,31 +175,49 @@ XspressDAQ::XspressDAQ(boost::shared_ptr<ILibXspress> detector_ptr,
   num_channels_ = num_channels;
   num_threads_ = endpoints.size();
   num_spectra_ = num_spectra;
+  detector_->get_num_scalars(&num_scalars_);
 
-  // Init the live scalar vectors
-  live_scalar_0_.resize(num_channels);
-  live_scalar_1_.resize(num_channels);
-  live_scalar_2_.resize(num_channels);
-  live_scalar_3_.resize(num_channels);
-  live_scalar_4_.resize(num_channels);
-  live_scalar_5_.resize(num_channels);
-  live_scalar_6_.resize(num_channels);
-  live_scalar_7_.resize(num_channels);
-  live_scalar_8_.resize(num_channels);
-
-  // Init the live scalar vectors
-  live_dtc_.resize(num_channels);
-  live_inp_est_.resize(num_channels);
+  // Create the worker progress counters
+  worker_frames_.reset(new boost::atomic<uint32_t>[num_threads_]);
+  for (uint32_t index = 0; index < num_threads_; index++){
+    worker_frames_[index] = 0;
+  }
+
+  // Create the per endpoint sending and work stealing state
+  data_sockets_.resize(num_threads_);
+  send_mutex_.reset(new boost::mutex[num_threads_]);
+  pending_.resize(num_threads_);
+  chunks_.resize(num_threads_);
+  chunk_mutex_.reset(new boost::mutex[num_threads_]);
+  live_publish_ns_.reset(new uint64_t[num_threads_]);
+  for (uint32_t index = 0; index < num_threads_; index++){
+    data_sockets_[index] = 0;
+    live_publish_ns_[index] = 0;
+  }
 
   // Create the control thread queue
   ctrl_queue_ = boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > >(new WorkQueue<boost::shared_ptr<XspressDAQTask> >());
   // Create the control thread
   ctrl_thread_ = new boost::thread(&XspressDAQ::controlTask, this);
-  // Create the worker done queue
-  done_queue_ = boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > >(new WorkQueue<boost::shared_ptr<XspressDAQTask> >());
 
   // Create the ZMQ context
   context_ = new zmq::context_t(num_threads_);
+  // The IO thread affinity must be set before the first socket is created
+  if (!io_cpus_.empty()){
+    std::vector<int> cpu_list;
+    if (parse_cpu_list(io_cpus_, cpu_list)){
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+      LOG4CXX_INFO(logger_, "Pinning ZMQ IO threads to CPUs [" << io_cpus_ << "]");
+      for (size_t index = 0; index < cpu_list.size(); index++){
+        zmq_ctx_set(static_cast<void *>(*context_), ZMQ_THREAD_AFFINITY_CPU_ADD, cpu_list[index]);
+      }
+#else
+      LOG4CXX_WARN(logger_, "ZMQ IO thread affinity is not supported by this version of ZeroMQ");
+#endif
+    } else {
+      LOG4CXX_ERROR(logger_, "Invalid CPU list for ZMQ IO threads: " << io_cpus_);
+    }
+  }
 
   // Work out how many channels in each thread
   int ch = 0;
@@ -79,8 +232,19 @@ XspressDAQ::XspressDAQ(boost::shared_ptr<ILibXspress> detector_ptr,
     }
     ch++;
   }
+  thread_channels_ = channels;
+  thread_first_channel_.resize(num_threads_);
+  for (uint32_t index = 0, first = 0; index < num_threads_; index++){
+    thread_first_channel_[index] = first;
+    first += channels[index];
+  }
+  pools_.resize(num_threads_);
+
+  // Init the live data, with one section for each worker thread
+  live_data_.reset(new XspressDAQLiveData(channels));
+
   int cur_chan = 0;
-  for (int index = 0; index < num_threads_; ++index){
+  for (uint32_t index = 0; index < num_threads_; ++index){
     LOG4CXX_INFO(logger_, "Creating thread " << index << " for channels " << cur_chan << "-" << cur_chan + channels[index]-1);
 
     // Create the worker queue for the worker thread
@@ -110,62 +274,392 @@ XspressDAQ::~XspressDAQ()
   // Destroy the ZMQ context
   context_->close();
   delete(context_);
+  // All messages have now been released so the buffer pools can be freed
+  retired_pools_.clear();
+  pools_.clear();
 }
 
-std::vector<uint32_t> XspressDAQ::read_live_scalar(uint32_t index)
+void XspressDAQ::read_live_data(std::vector<XspressLiveChannel>& live_data)
 {
-  std::vector<uint32_t> reply;
-  // Lock the scalar data
-  boost::lock_guard<boost::mutex> lock(data_mutex_);
-  switch (index){
-    case 0:
-      reply = live_scalar_0_;
-      break;
-    case 1:
-      reply = live_scalar_1_;
-      break;
-    case 2:
-      reply = live_scalar_2_;
-      break;
-    case 3:
-      reply = live_scalar_3_;
-      break;
-    case 4:
-      reply = live_scalar_4_;
-      break;
-    case 5:
-      reply = live_scalar_5_;
-      break;
-    case 6:
-      reply = live_scalar_6_;
+  live_data_->snapshot(live_data);
+}
+
+void XspressDAQ::set_num_aux_data(uint32_t num_aux_data)
+{
+    num_aux_data_ = num_aux_data;
+}
+
+void XspressDAQ::set_batch_size(uint32_t batch_size)
+{
+  // A batch size of 0 makes no sense, treat it as a single frame per message
+  if (batch_size == 0){
+    batch_size = 1;
+  }
+  LOG4CXX_INFO(logger_, "Setting DAQ batch size to [" << batch_size << "] frames per message");
+  batch_size_ = batch_size;
+}
+
+uint32_t XspressDAQ::get_batch_size()
+{
+  return batch_size_;
+}
+
+void XspressDAQ::set_pool_buffers(uint32_t pool_buffers)
+{
+  LOG4CXX_INFO(logger_, "Setting DAQ frame buffer pool size to [" << pool_buffers << "] buffers");
+  pool_buffers_ = pool_buffers;
+}
+
+uint32_t XspressDAQ::get_pool_allocated()
+{
+  uint32_t buffers = 0;
+  for (uint32_t index = 0; index < num_threads_; index++){
+    boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
+    if (pool){
+      buffers += pool->num_buffers();
+    }
+  }
+  return buffers;
+}
+
+uint32_t XspressDAQ::get_pool_free_buffers()
+{
+  uint32_t buffers = 0;
+  for (uint32_t index = 0; index < num_threads_; index++){
+    boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
+    if (pool){
+      buffers += pool->free_buffers();
+    }
+  }
+  return buffers;
+}
+
+uint64_t XspressDAQ::get_pool_exhausted()
+{
+  uint64_t exhausted = 0;
+  for (uint32_t index = 0; index < num_threads_; index++){
+    boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
+    if (pool){
+      exhausted += pool->exhausted();
+    }
+  }
+  return exhausted;
+}
+
+void XspressDAQ::reset_statistics()
+{
+  for (uint32_t index = 0; index < num_threads_; index++){
+    boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
+    if (pool){
+      pool->reset_statistics();
+    }
+  }
+  poll_cpu_ns_ = 0;
+}
+
+int XspressDAQ::set_wait_policy(const std::string& policy)
+{
+  int status = XSP_STATUS_OK;
+  if (policy == "spin"){
+    wait_policy_ = DAQ_WAIT_POLICY_SPIN;
+  } else if (policy == "yield"){
+    wait_policy_ = DAQ_WAIT_POLICY_YIELD;
+  } else if (policy == "backoff"){
+    wait_policy_ = DAQ_WAIT_POLICY_BACKOFF;
+  } else if (policy == "notify"){
+    wait_policy_ = DAQ_WAIT_POLICY_NOTIFY;
+  } else {
+    LOG4CXX_ERROR(logger_, "Invalid DAQ wait policy requested: " << policy);
+    status = XSP_STATUS_ERROR;
+  }
+  if (status == XSP_STATUS_OK){
+    LOG4CXX_INFO(logger_, "Setting DAQ wait policy to [" << policy << "]");
+  }
+  return status;
+}
+
+std::string XspressDAQ::get_wait_policy()
+{
+  std::string policy = "backoff";
+  switch (wait_policy_.load()){
+    case DAQ_WAIT_POLICY_SPIN:
+      policy = "spin";
       break;
-    case 7:
-      reply = live_scalar_7_;
+    case DAQ_WAIT_POLICY_YIELD:
+      policy = "yield";
       break;
-    case 8:
-      reply = live_scalar_8_;
+    case DAQ_WAIT_POLICY_NOTIFY:
+      policy = "notify";
       break;
   }
-  return reply;
+  return policy;
 }
 
-std::vector<double> XspressDAQ::read_live_dtc()
+void XspressDAQ::set_wait_max_us(uint32_t wait_max_us)
 {
-  // Lock the dtc data
-  boost::lock_guard<boost::mutex> lock(data_mutex_);
-  return live_dtc_;
+  wait_max_us_ = wait_max_us;
 }
 
-std::vector<double> XspressDAQ::read_live_inp_est()
+uint32_t XspressDAQ::get_wait_max_us()
 {
-  // Lock the inp est data
-  boost::lock_guard<boost::mutex> lock(data_mutex_);
-  return live_inp_est_;
+  return wait_max_us_;
 }
 
-void XspressDAQ::set_num_aux_data(uint32_t num_aux_data)
+void XspressDAQ::set_live_update_frames(uint32_t frames)
 {
-    num_aux_data_ = num_aux_data;
+  LOG4CXX_INFO(logger_, "Setting DAQ live update to every [" << frames << "] frames");
+  live_update_frames_ = frames;
+}
+
+uint32_t XspressDAQ::get_live_update_frames()
+{
+  return live_update_frames_;
+}
+
+void XspressDAQ::set_live_update_ms(uint32_t update_ms)
+{
+  LOG4CXX_INFO(logger_, "Setting DAQ live update to every [" << update_ms << "] ms");
+  live_update_ms_ = update_ms;
+}
+
+uint32_t XspressDAQ::get_live_update_ms()
+{
+  return live_update_ms_;
+}
+
+void XspressDAQ::set_work_stealing(bool work_stealing)
+{
+  LOG4CXX_INFO(logger_, "Setting DAQ work stealing to [" << work_stealing << "]");
+  work_stealing_ = work_stealing;
+}
+
+bool XspressDAQ::get_work_stealing()
+{
+  return work_stealing_;
+}
+
+void XspressDAQ::set_zero_copy(bool zero_copy)
+{
+  LOG4CXX_INFO(logger_, "Setting DAQ zero copy to [" << zero_copy << "]");
+  zero_copy_ = zero_copy;
+}
+
+bool XspressDAQ::get_zero_copy()
+{
+  return zero_copy_;
+}
+
+int XspressDAQ::set_control_cpus(const std::string& cpus)
+{
+  int status = set_thread_cpus(ctrl_thread_, cpus);
+  if (status == XSP_STATUS_OK){
+    LOG4CXX_INFO(logger_, "Pinned DAQ control thread to CPUs [" << cpus << "]");
+    control_cpus_ = cpus;
+  }
+  return status;
+}
+
+std::string XspressDAQ::get_control_cpus()
+{
+  return control_cpus_;
+}
+
+/** Pin the worker threads to CPU lists.
+ *
+ * If fewer lists than worker threads are supplied the lists are reused in
+ * turn.  The frame buffer pools are reallocated at the start of the next
+ * acquisition so that they are placed on the NUMA node local to each worker.
+ *
+ * \param[in] cpus - vector of CPU list strings, one for each worker thread.
+ * \return status of the operation.
+ */
+int XspressDAQ::set_worker_cpus(const std::vector<std::string>& cpus)
+{
+  int status = XSP_STATUS_OK;
+  if (!cpus.empty()){
+    for (size_t index = 0; index < work_threads_.size() && status == XSP_STATUS_OK; index++){
+      const std::string& thread_cpus = cpus[index % cpus.size()];
+      status = set_thread_cpus(work_threads_[index], thread_cpus);
+      if (status == XSP_STATUS_OK){
+        LOG4CXX_INFO(logger_, "Pinned DAQ worker thread " << index << " to CPUs [" << thread_cpus << "]");
+      }
+    }
+  }
+  if (status == XSP_STATUS_OK){
+    worker_cpus_ = cpus;
+    // Retire the current pools so that new pools are touched by the pinned workers
+    boost::lock_guard<boost::mutex> lock(pool_mutex_);
+    for (size_t index = 0; index < pools_.size(); index++){
+      if (pools_[index]){
+        retired_pools_.push_back(pools_[index]);
+        pools_[index].reset();
+      }
+    }
+  }
+  return status;
+}
+
+std::vector<std::string> XspressDAQ::get_worker_cpus()
+{
+  return worker_cpus_;
+}
+
+std::string XspressDAQ::get_io_cpus()
+{
+  return io_cpus_;
+}
+
+/** Pin a thread to a CPU list.
+ *
+ * \param[in] thread - the thread to pin.
+ * \param[in] cpus - CPU list string, an empty string leaves the thread unchanged.
+ * \return status of the operation.
+ */
+int XspressDAQ::set_thread_cpus(boost::thread *thread, const std::string& cpus)
+{
+  int status = XSP_STATUS_OK;
+  std::vector<int> cpu_list;
+  if (!parse_cpu_list(cpus, cpu_list)){
+    LOG4CXX_ERROR(logger_, "Invalid CPU list: " << cpus);
+    status = XSP_STATUS_ERROR;
+  } else if (!cpu_list.empty()){
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t index = 0; index < cpu_list.size(); index++){
+      CPU_SET(cpu_list[index], &cpu_set);
+    }
+    int rc = pthread_setaffinity_np(thread->native_handle(), sizeof(cpu_set_t), &cpu_set);
+    if (rc != 0){
+      LOG4CXX_ERROR(logger_, "Failed to set thread affinity to CPUs [" << cpus << "]: " << strerror(rc));
+      status = XSP_STATUS_ERROR;
+    }
+  }
+  return status;
+}
+
+/** Return the total control thread CPU time spent polling for frames.
+ *
+ * \return CPU time in seconds.
+ */
+double XspressDAQ::get_poll_cpu_time()
+{
+  return (double)poll_cpu_ns_ / 1000000000.0;
+}
+
+/** Return the control thread polling CPU load for the current or last acquisition.
+ *
+ * \return percentage of a single core used while polling for frames.
+ */
+double XspressDAQ::get_poll_cpu_load()
+{
+  double load = 0.0;
+  uint64_t wall_ns = acq_wall_ns_;
+  if (wall_ns > 0){
+    load = 100.0 * (double)acq_poll_cpu_ns_ / (double)wall_ns;
+  }
+  return load;
+}
+
+/** Wait for new frames according to the configured wait policy.
+ *
+ * The idle count is the number of consecutive polls that found no work, and
+ * should be reset by the caller whenever work is found.  All policies other
+ * than spin poll without pausing for the first WAIT_SPIN_COUNT calls so that
+ * short gaps between frames do not incur any wake up latency.
+ *
+ * \param[in] frames - number of frames seen so far.
+ * \param[in,out] idle_count - number of consecutive idle polls.
+ */
+void XspressDAQ::wait_for_frames(int32_t frames, uint32_t& idle_count)
+{
+  int policy = wait_policy_.load();
+  uint32_t wait_max_us = wait_max_us_.load();
+  idle_count++;
+  if (policy == DAQ_WAIT_POLICY_SPIN || idle_count <= WAIT_SPIN_COUNT){
+    return;
+  }
+  if (policy == DAQ_WAIT_POLICY_NOTIFY){
+    if (detector_->supports_frame_wait()){
+      detector_->wait_for_frames(frames, wait_max_us);
+      return;
+    }
+    // The library cannot notify us so fall back to backing off
+    policy = DAQ_WAIT_POLICY_BACKOFF;
+  }
+  if (policy == DAQ_WAIT_POLICY_YIELD){
+    boost::this_thread::yield();
+  } else {
+    // Double the sleep time for each idle poll up to the maximum
+    uint32_t shift = std::min(idle_count - WAIT_SPIN_COUNT - 1, (uint32_t)20);
+    uint64_t wait_ns = std::min((uint64_t)1000 << shift, (uint64_t)wait_max_us * 1000);
+    struct timespec ts;
+    ts.tv_sec = wait_ns / 1000000000;
+    ts.tv_nsec = wait_ns % 1000000000;
+    nanosleep(&ts, NULL);
+  }
+}
+
+/** Allocate the frame buffer pools for the coming acquisition.
+ *
+ * Each worker thread has its own pool, with the buffers sized to hold a full
+ * batch of frames for the channels monitored by that worker and the
+ * configured number of buffers shared evenly between the workers.  If an
+ * existing pool is already suitable it is kept.  A replaced pool is retained
+ * until ZMQ has released all of its buffers.
+ */
+void XspressDAQ::setup_buffer_pool()
+{
+  uint32_t num_scalars = 0;
+  detector_->get_num_scalars(&num_scalars);
+
+  uint32_t worker_buffers = 0;
+  if (pool_buffers_ > 0){
+    worker_buffers = std::max((uint32_t)1, (pool_buffers_ + num_threads_ - 1) / num_threads_);
+  }
+
+  boost::lock_guard<boost::mutex> lock(pool_mutex_);
+  // Free any retired pools that have had all of their buffers returned
+  std::vector<boost::shared_ptr<XspressDAQBufferPool> >::iterator iter = retired_pools_.begin();
+  while (iter != retired_pools_.end()){
+    if ((*iter)->outstanding() == 0){
+      iter = retired_pools_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  // When work stealing a worker may read frames for any endpoint
+  int max_channels = 0;
+  for (size_t index = 0; index < thread_channels_.size(); index++){
+    max_channels = std::max(max_channels, thread_channels_[index]);
+  }
+
+  for (uint32_t index = 0; index < num_threads_; index++){
+    int pool_channels = work_stealing_ ? max_channels : thread_channels_[index];
+    size_t frame_size = pool_channels * ((num_spectra_ * num_aux_data_ * sizeof(uint32_t)) +
+                                          (num_scalars * sizeof(uint32_t)) +
+                                          (2 * sizeof(double)));
+    size_t buffer_size = (HEADER_ITEMS * sizeof(uint32_t)) + (frame_size * acq_batch_size_);
+    boost::shared_ptr<XspressDAQBufferPool> pool = pools_[index];
+    if (!pool || pool->buffer_size() < buffer_size || pool->num_buffers() != worker_buffers){
+      if (pool){
+        retired_pools_.push_back(pool);
+      }
+      LOG4CXX_INFO(logger_, "Allocating DAQ frame buffer pool for worker " << index << " of ["
+                            << worker_buffers << "] buffers of [" << buffer_size << "] bytes");
+      pool = boost::shared_ptr<XspressDAQBufferPool>(new XspressDAQBufferPool(buffer_size, worker_buffers));
+      if (pool->num_buffers() != worker_buffers){
+        LOG4CXX_ERROR(logger_, "Failed to allocate DAQ frame buffer pool, frames will be allocated individually");
+      }
+      pools_[index] = pool;
+    }
+  }
+}
+
+boost::shared_ptr<XspressDAQBufferPool> XspressDAQ::get_buffer_pool(int index)
+{
+  boost::lock_guard<boost::mutex> lock(pool_mutex_);
+  return pools_[index];
 }
 
 boost::shared_ptr<XspressDAQTask> XspressDAQ::create_task(uint32_t type)
@@ -193,6 +687,11 @@ void XspressDAQ::startAcquisition(uint32_t frames)
   acq_running_ = true;
   // Set the number of frames read out to 0
   no_of_frames_ = 0;
+  // The batch size is fixed for the duration of the acquisition, it is passed
+  // on to the worker threads through the control and work queues
+  acq_batch_size_ = batch_size_;
+  // Make sure the frame buffer pool is large enough for this acquisition
+  setup_buffer_pool();
   // Load the start task into the ctrl queue
   ctrl_queue_->add(create_task(DAQ_TASK_TYPE_START, frames), true);
 }
@@ -204,7 +703,7 @@ void XspressDAQ::stopAcquisition()
   // Wait for the acquisition to fall into the ready state
   while (!waiting_for_acq_){
     // We need to wait for the acquisition loop to abort
-    sleep(0.001);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
   }
 }
 
@@ -223,6 +722,22 @@ uint32_t XspressDAQ::getFramesRead()
   return no_of_frames_;
 }
 
+/** Return the number of frames that have been sent by every worker thread.
+ *
+ * \return lowest frame count across all of the worker threads.
+ */
+uint32_t XspressDAQ::get_frames_complete()
+{
+  uint32_t frames = 0;
+  for (uint32_t index = 0; index < num_threads_; index++){
+    uint32_t worker_frames = worker_frames_[index];
+    if (index == 0 || worker_frames < frames){
+      frames = worker_frames;
+    }
+  }
+  return frames;
+}
+
 void XspressDAQ::controlTask()
 {
   LOG4CXX_INFO(logger_, "Starting control task with ID [" << boost::this_thread::get_id() << "]");
@@ -247,34 +762,98 @@ void XspressDAQ::controlTask()
       LOG4CXX_INFO(logger_, "Buffer length calculated: [" << buffer_length_ << "]");
 
 
+      // Reset the progress of each worker thread
+      for (uint32_t index = 0; index < num_threads_; index++){
+        worker_frames_[index] = 0;
+      }
+      // The work stealing mode is fixed for the duration of the acquisition
+      bool work_stealing = work_stealing_;
+
+      // When sending without a copy the circular buffer can only be acknowledged
+      // once ZMQ has released the frames on every endpoint
+      bool zero_copy = zero_copy_;
+      uint32_t release_slots = buffer_length_ > 0 ? buffer_length_ : total_frames;
+      if (zero_copy && !detector_->supports_zero_copy()){
+        LOG4CXX_WARN(logger_, "Zero copy is not supported by the detector, MCA data will be copied");
+        zero_copy = false;
+      } else if (zero_copy && release_slots == 0){
+        LOG4CXX_WARN(logger_, "Zero copy requires a known buffer length, MCA data will be copied");
+        zero_copy = false;
+      }
+      release_tracker_.reset();
+      if (zero_copy){
+        release_tracker_ = boost::shared_ptr<XspressDAQReleaseTracker>(new XspressDAQReleaseTracker(release_slots, num_threads_));
+      }
+      acq_zero_copy_ = zero_copy;
+      // Notify the worker threads that an acquisition is starting
+      std::vector<boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > > >::iterator wq_iter;
+      for (wq_iter = work_queues_.begin(); wq_iter != work_queues_.end(); ++wq_iter){
+        (*wq_iter)->add(create_task(DAQ_TASK_TYPE_START));
+      }
+
+      // Frames are dispatched to the worker threads as soon as they become available,
+      // without waiting for the previous frames to be sent.  Each worker records its own
+      // progress and the circular buffer is acknowledged up to the lowest frame that has
+      // been sent by every worker.
       int32_t num_frames = 0;
-      int32_t frames_read = 0;
-      while ((num_frames < total_frames) && acq_running_){
+      uint32_t frames_dispatched = 0;
+      uint32_t frames_acked = 0;
+      uint32_t idle_count = 0;
+      struct timespec acq_start, poll_start, poll_end;
+      clock_gettime(CLOCK_MONOTONIC, &acq_start);
+      acq_poll_cpu_ns_ = 0;
+      acq_wall_ns_ = 0;
+      while ((frames_acked < (uint32_t)total_frames) && acq_running_){
+        bool idle = true;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &poll_start);
         int status = detector_->get_num_frames_read(&num_frames);
         if (status == XSP_STATUS_OK){
-          uint32_t frames_to_read = num_frames - frames_read;
-          if (frames_to_read > 0){
-            LOG4CXX_DEBUG_LEVEL(3, logger_, "Current frames to read: " << frames_read << " - " << num_frames-1);
+          if (num_frames > (int32_t)frames_dispatched){
+            uint32_t frames_to_read = num_frames - frames_dispatched;
+            LOG4CXX_DEBUG_LEVEL(3, logger_, "Current frames to read: " << frames_dispatched << " - " << num_frames-1);
+            if (work_stealing){
+              // Queue the frames as chunks that any worker thread can read
+              queue_chunks(frames_dispatched, frames_to_read);
+            }
             // Notify the worker threads to process the frames
             std::vector<boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > > >::iterator iter;
             for (iter = work_queues_.begin(); iter != work_queues_.end(); ++iter){
-              (*iter)->add(create_task(DAQ_TASK_TYPE_READ, frames_read, frames_to_read));
-            }
-            // Now wait for the worker threads to complete their processing
-            LOG4CXX_DEBUG_LEVEL(4, logger_, "Waiting for " << num_threads_ << " worker threads to complete");
-            for (int index = 0; index < num_threads_; index++){
-              done_queue_->remove();
+              if (work_stealing){
+                (*iter)->add(create_task(DAQ_TASK_TYPE_CHUNKS));
+              } else {
+                (*iter)->add(create_task(DAQ_TASK_TYPE_READ, frames_dispatched, frames_to_read));
+              }
             }
-            // Once all worker threads have completed notify the circular buffer
-            status = detector_->histogram_circ_ack(0, frames_read, frames_to_read, num_channels_);
-            LOG4CXX_DEBUG_LEVEL(3, logger_, "Ack circular buffer [status=" << status << "] frames_read[" << frames_read << "] frames_to_read[" << frames_to_read << "]");
-            LOG4CXX_DEBUG_LEVEL(4, logger_, "Worker threads completed and circular buffer acknowledgement sent");
-            // Set frames read to correct value
-            frames_read = num_frames;
-            no_of_frames_ = num_frames;
+            frames_dispatched = num_frames;
+            idle = false;
+          }
+          // Acknowledge any frames that have been sent by all of the worker threads,
+          // or released by ZMQ on every endpoint when sending without a copy
+          uint32_t frames_complete = 0;
+          if (zero_copy){
+            frames_complete = frames_acked + release_tracker_->releasable(frames_acked, frames_dispatched - frames_acked);
           } else {
-              // We need to wait for some frames
-              sleep(0.001);
+            frames_complete = get_frames_complete();
+          }
+          if (frames_complete > frames_acked){
+            status = detector_->histogram_circ_ack(0, frames_acked, frames_complete - frames_acked, num_channels_);
+            LOG4CXX_DEBUG_LEVEL(3, logger_, "Ack circular buffer [status=" << status << "] frames_acked[" << frames_acked << "] frames_to_ack[" << frames_complete - frames_acked << "]");
+            frames_acked = frames_complete;
+            no_of_frames_ = frames_complete;
+            idle = false;
+          }
+          if (idle){
+            // We need to wait for some frames
+            wait_for_frames(num_frames, idle_count);
+            // Record the CPU time used by this idle poll
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &poll_end);
+            uint64_t poll_ns = timespec_ns(poll_end) - timespec_ns(poll_start);
+            poll_cpu_ns_ += poll_ns;
+            acq_poll_cpu_ns_ += poll_ns;
+            clock_gettime(CLOCK_MONOTONIC, &poll_end);
+            acq_wall_ns_ = timespec_ns(poll_end) - timespec_ns(acq_start);
+          } else {
+            idle_count = 0;
           }
         } else {
           LOG4CXX_ERROR(logger_, "Error: " << detector_->getErrorString() << " - Aborting acquisition");
@@ -284,7 +863,19 @@ void XspressDAQ::controlTask()
           detector_->histogram_stop(0);
         }
       }
-      LOG4CXX_INFO(logger_, "DAQ thread completed, read " << frames_read << " frames");
+      // If the acquisition was stopped early wait for the worker threads to finish
+      // sending any frames that have already been dispatched
+      LOG4CXX_DEBUG_LEVEL(4, logger_, "Waiting for " << num_threads_ << " worker threads to complete");
+      idle_count = 0;
+      while (get_frames_complete() < frames_dispatched){
+        wait_for_frames(num_frames, idle_count);
+      }
+      // Notify the worker threads that the acquisition is complete
+      std::vector<boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressDAQTask> > > >::iterator iter;
+      for (iter = work_queues_.begin(); iter != work_queues_.end(); ++iter){
+        (*iter)->add(create_task(DAQ_TASK_TYPE_COMPLETE));
+      }
+      LOG4CXX_INFO(logger_, "DAQ thread completed, read " << frames_dispatched << " frames");
       // Reset the acquisition running flag to false
       acq_running_ = false;
     }
@@ -307,17 +898,17 @@ void XspressDAQ::workTask(boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressD
                           int num_channels,
                           const std::string& endpoint)
 {
-  int status = XSP_STATUS_OK;
-  uint32_t num_scalars = 0;
-
   LOG4CXX_INFO(logger_, "Starting work task with ID [" << boost::this_thread::get_id() << "]");
 
-  detector_->get_num_scalars(&num_scalars);
-
   // Create the ZMQ endpoint for this worker
   LOG4CXX_INFO(logger_, "workTask[" << index << "] => Creating zmq socket and binding to [" << endpoint << "]");
   zmq::socket_t *data_socket = new zmq::socket_t(*context_, ZMQ_PUSH);
   data_socket->bind(endpoint.c_str());
+  {
+    // Other workers may send on this socket when work stealing
+    boost::lock_guard<boost::mutex> lock(send_mutex_[index]);
+    data_sockets_[index] = data_socket;
+  }
 
   bool executing = true;
   while (executing){
@@ -328,123 +919,63 @@ void XspressDAQ::workTask(boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressD
       int32_t frames_to_read = task->value2_;
       if (frames_to_read > 0){
         LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => reading frames [" << frames_to_read << "]");
-
-        uint32_t header_size = HEADER_ITEMS * sizeof(uint32_t);
-        uint32_t data_size = num_spectra_ * num_channels * num_aux_data_ * sizeof(uint32_t);
-        uint32_t scalar_size = num_channels * num_scalars * sizeof(uint32_t);
-        uint32_t dtc_size = num_channels * sizeof(double);
-        uint32_t inp_est_size = num_channels * sizeof(double);
-        uint32_t frame_size = header_size + data_size + scalar_size + dtc_size + inp_est_size;
-
-        LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => Num scalars: [" << num_scalars << "] scalar_size: [" << scalar_size << "]");
-        LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => Calculated frame size: [" << frame_size << "]");
-
-        //LOG4CXX_INFO(logger_, "Calling memcpy at channel: " << channel_index << " for " << num_channels << " channels");
+        boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
 
         // We need to avoid memcpy as much as possible, and we also need to allow ZMQ to free the memory
-        // when it is read to do so.  Therefore we will perform a single frame allocation and 1 memcpy,
-        // and then we can safely let ZMQ free that memory block at any time.
-
-        for (int current_frame = 0; current_frame < frames_to_read; current_frame++){
-          // Allocation of memory:
-          // 1 x uint32 => Frame number
-          // 1 x uint32 => Num spectra
-          // 1 x uint32 => Num aux data
-          // 1 x uint32 => Num channels
-          // 1 x uint32 => Num scalars
-          // 1 x uint32 => First channel index
-          // Frame data [num_spectra x num_channels x num_aux_data x uint32]
-          unsigned char *base_ptr;
-          uint32_t *frame_ptr = (uint32_t *)malloc(frame_size);
-          uint32_t *h_ptr = frame_ptr;
-          base_ptr = (unsigned char *)frame_ptr;
-          base_ptr += header_size;
-          uint32_t *s_ptr = (uint32_t *)base_ptr;
-          base_ptr = (unsigned char *)frame_ptr;
-          base_ptr += (header_size + scalar_size);
-          double *dtc_ptr = (double *)base_ptr;
-          base_ptr = (unsigned char *)frame_ptr;
-          base_ptr += (header_size + scalar_size + dtc_size);
-          double *inp_est_ptr = (double *)base_ptr;
-          base_ptr = (unsigned char *)frame_ptr;
-          base_ptr += (header_size + scalar_size + dtc_size + inp_est_size);
-          uint32_t *d_ptr = (uint32_t *)base_ptr;
-
-          // Fill in the header data items
-          h_ptr[0] = frames_read + current_frame;
-          h_ptr[1] = num_spectra_;
-          h_ptr[2] = num_aux_data_;
-          h_ptr[3] = num_channels;
-          h_ptr[4] = num_scalars;
-          h_ptr[5] = channel_index;
-
-          // Perform the single frame memcpy
-          status = detector_->histogram_memcpy(d_ptr,
-                                               frames_read + current_frame,
-                                               1, // Read a single frame
-                                               buffer_length_,
-                                               num_spectra_,
-                                               num_aux_data_,
-                                               channel_index,
-                                               num_channels);
-
-          // Perform the scalar memcpy
-          status = detector_->scaler_read(s_ptr,
-                                          frames_read + current_frame,
-                                          1, // Read a single frame
-                                          channel_index,
-                                          num_channels);
-
-
-          // Calculate the Dead Time Correction factors
-          status = detector_->calculate_dtc_factors(s_ptr,
-                                                    dtc_ptr,
-                                                    inp_est_ptr,
-                                                    1,
-                                                    channel_index,
-                                                    num_channels);
-
-          // Lock the live data
-          {
-            boost::lock_guard<boost::mutex> lock(data_mutex_);
-
-            for (int c_index = 0; c_index < num_channels; c_index++){
-              live_scalar_0_[c_index + channel_index] = s_ptr[(c_index*9)+0];
-              live_scalar_1_[c_index + channel_index] = s_ptr[(c_index*9)+1];
-              live_scalar_2_[c_index + channel_index] = s_ptr[(c_index*9)+2];
-              live_scalar_3_[c_index + channel_index] = s_ptr[(c_index*9)+3];
-              live_scalar_4_[c_index + channel_index] = s_ptr[(c_index*9)+4];
-              live_scalar_5_[c_index + channel_index] = s_ptr[(c_index*9)+5];
-              live_scalar_6_[c_index + channel_index] = s_ptr[(c_index*9)+6];
-              live_scalar_7_[c_index + channel_index] = s_ptr[(c_index*9)+7];
-              live_scalar_8_[c_index + channel_index] = s_ptr[(c_index*9)+8];
-
-              if (std::isinf(dtc_ptr[c_index]) || std::isnan(dtc_ptr[c_index])){
-                LOG4CXX_DEBUG_LEVEL(2, logger_, "workTask[" << index << "] DTC infinity/NaN detected, defaulting to 1.0");
-                live_dtc_[c_index + channel_index] = 1.0;
-              } else {
-                live_dtc_[c_index + channel_index] = dtc_ptr[c_index];
-              }
-              live_inp_est_[c_index + channel_index] = inp_est_ptr[c_index];
-            }
-          }
+        // when it is read to do so.  Therefore we read up to acq_batch_size_ frames with a single call to
+        // each of the library functions into one block taken from the buffer pool, and ZMQ returns
+        // that block to the pool once the message has been sent.  If the pool is exhausted the block
+        // is allocated from the heap instead and freed by ZMQ.
 
-          LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => sending ZMQ message");
-          // Construct the ZMQ message wrapper and send the frame
-          zmq::message_t frame_data(frame_ptr, frame_size, free_frame);
-          data_socket->send(frame_data, 0);
-          LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => message sent");
+        int32_t current_frame = 0;
+        while (current_frame < frames_to_read){
+          uint32_t first_frame = frames_read + current_frame;
+          uint32_t batch_frames = get_batch_frames(first_frame, frames_to_read - current_frame);
+          boost::shared_ptr<XspressDAQMessage> message = read_frames(index, index, first_frame, batch_frames, pool);
+          send_frames(index, message);
+          current_frame += batch_frames;
         }
       }
-      // Notify we have completed the task
-      done_queue_->add(create_task(DAQ_TASK_TYPE_COMPLETE), true);
-      LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => done_queue notification complete");
+      LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => read task complete");
+    }
+    if (task->type_ == DAQ_TASK_TYPE_CHUNKS){
+      // Read chunks for our own endpoint first and then steal chunks from the other
+      // endpoints until there is no work left.  Messages are sent in frame order for
+      // each endpoint by whichever worker completes the next chunk.
+      boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
+      XspressDAQChunk chunk;
+      while (take_chunk(index, chunk)){
+        LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << index << "] => reading chunk for endpoint [" << chunk.endpoint_
+                                        << "] frames [" << chunk.first_frame_ << "-" << chunk.first_frame_ + chunk.num_frames_ - 1 << "]");
+        boost::shared_ptr<XspressDAQMessage> message = read_frames(index, chunk.endpoint_, chunk.first_frame_, chunk.num_frames_, pool);
+        send_ordered(chunk.endpoint_, message);
+      }
+    }
+    if (task->type_ == DAQ_TASK_TYPE_START){
+      // Touch the frame buffer pool from this thread so that it is placed on our local NUMA node
+      boost::shared_ptr<XspressDAQBufferPool> pool = get_buffer_pool(index);
+      if (pool){
+        pool->prefault();
+      }
+    }
+    if (task->type_ == DAQ_TASK_TYPE_COMPLETE){
+      // Publish any live data remaining from the end of the acquisition
+      boost::lock_guard<boost::mutex> lock(send_mutex_[index]);
+      live_data_->publish(index);
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      live_publish_ns_[index] = timespec_ns(now);
     }
     if (task->type_ == DAQ_TASK_TYPE_SHUTDOWN){
       // Set the execute flag to false
       executing = false;
     }
   }
+  {
+    boost::lock_guard<boost::mutex> lock(send_mutex_[index]);
+    data_sockets_[index] = 0;
+    pending_[index].clear();
+  }
   // unbind the data socket
   data_socket->unbind(endpoint.c_str());
   // destroy the socket
@@ -453,6 +984,280 @@ void XspressDAQ::workTask(boost::shared_ptr<WorkQueue<boost::shared_ptr<XspressD
   LOG4CXX_INFO(logger_, "Stopping worker task with ID [" << boost::this_thread::get_id() << "]");
 }
 
+/** Calculate the number of frames to read in a single message.
+ *
+ * \param[in] first_frame - the first frame to read.
+ * \param[in] max_frames - the number of frames available.
+ * \return number of frames to read.
+ */
+uint32_t XspressDAQ::get_batch_frames(uint32_t first_frame, uint32_t max_frames)
+{
+  uint32_t batch_frames = std::min(max_frames, acq_batch_size_);
+  // A single library read cannot wrap around the end of the circular buffer
+  if (buffer_length_ > 0){
+    batch_frames = std::min(batch_frames, buffer_length_ - (first_frame % buffer_length_));
+  }
+  return batch_frames;
+}
+
+/** Read a range of frames for the channels of an endpoint into a message buffer.
+ *
+ * \param[in] worker - index of the worker thread performing the read.
+ * \param[in] endpoint - index of the endpoint the frames are for.
+ * \param[in] first_frame - the first frame to read.
+ * \param[in] num_frames - the number of frames to read.
+ * \param[in] pool - the worker's frame buffer pool.
+ * \return the filled message.
+ */
+boost::shared_ptr<XspressDAQMessage> XspressDAQ::read_frames(int worker,
+                                                             int endpoint,
+                                                             uint32_t first_frame,
+                                                             uint32_t num_frames,
+                                                             boost::shared_ptr<XspressDAQBufferPool> pool)
+{
+  int status = XSP_STATUS_OK;
+  uint32_t num_channels = thread_channels_[endpoint];
+  uint32_t channel_index = thread_first_channel_[endpoint];
+  uint32_t num_scalars = num_scalars_;
+
+  uint32_t header_size = HEADER_ITEMS * sizeof(uint32_t);
+  uint32_t data_size = num_spectra_ * num_channels * num_aux_data_ * sizeof(uint32_t);
+  uint32_t scalar_size = num_channels * num_scalars * sizeof(uint32_t);
+  uint32_t dtc_size = num_channels * sizeof(double);
+  uint32_t inp_est_size = num_channels * sizeof(double);
+  uint32_t frame_size = data_size + scalar_size + dtc_size + inp_est_size;
+
+  boost::shared_ptr<XspressDAQMessage> message(new XspressDAQMessage());
+  if (acq_zero_copy_){
+    // Reference the MCA data in the histogram memory instead of copying it
+    status = detector_->histogram_frame_ptrs(message->mca_ptrs_,
+                                             first_frame,
+                                             num_frames,
+                                             buffer_length_,
+                                             num_spectra_,
+                                             num_aux_data_,
+                                             channel_index,
+                                             num_channels);
+    if (status == XSP_STATUS_OK){
+      frame_size -= data_size;
+      message->mca_size_ = num_spectra_ * num_aux_data_ * sizeof(uint32_t);
+      message->tracker_ = release_tracker_;
+    } else {
+      LOG4CXX_ERROR(logger_, "workTask[" << worker << "] => " << detector_->getErrorString() << " - copying frames");
+      message->mca_ptrs_.clear();
+    }
+  }
+  uint32_t message_size = header_size + (frame_size * num_frames);
+
+  LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << worker << "] => Num scalars: [" << num_scalars << "] scalar_size: [" << scalar_size << "]");
+  LOG4CXX_DEBUG_LEVEL(4, logger_, "workTask[" << worker << "] => Calculated frame size: [" << frame_size << "]");
+
+  // Allocation of memory:
+  // 1 x uint32 => First frame number
+  // 1 x uint32 => Num spectra
+  // 1 x uint32 => Num aux data
+  // 1 x uint32 => Num channels
+  // 1 x uint32 => Num scalars
+  // 1 x uint32 => First channel index
+  // 1 x uint32 => Num frames in message
+  // Scalar data [num_frames x num_channels x num_scalars x uint32]
+  // DTC data [num_frames x num_channels x double]
+  // Input estimate data [num_frames x num_channels x double]
+  // Frame data [num_frames x num_channels x num_spectra x num_aux_data x uint32]
+  // When sending without a copy the frame data follows as one message part per
+  // channel of each frame, so the receiver sees the same layout.
+  unsigned char *base_ptr;
+  uint32_t *frame_ptr = 0;
+  XspressDAQBufferPool *frame_pool = 0;
+  if (pool && message_size <= pool->buffer_size()){
+    frame_ptr = (uint32_t *)pool->allocate();
+  }
+  if (frame_ptr){
+    frame_pool = pool.get();
+  } else {
+    LOG4CXX_DEBUG_LEVEL(2, logger_, "workTask[" << worker << "] => no pool buffer available, allocating frame");
+    frame_ptr = (uint32_t *)malloc(message_size);
+  }
+  uint32_t *h_ptr = frame_ptr;
+  base_ptr = (unsigned char *)frame_ptr;
+  base_ptr += header_size;
+  uint32_t *s_ptr = (uint32_t *)base_ptr;
+  base_ptr += (scalar_size * num_frames);
+  double *dtc_ptr = (double *)base_ptr;
+  base_ptr += (dtc_size * num_frames);
+  double *inp_est_ptr = (double *)base_ptr;
+  base_ptr += (inp_est_size * num_frames);
+  uint32_t *d_ptr = (uint32_t *)base_ptr;
+
+  // Fill in the header data items
+  h_ptr[0] = first_frame;
+  h_ptr[1] = num_spectra_;
+  h_ptr[2] = num_aux_data_;
+  h_ptr[3] = num_channels;
+  h_ptr[4] = num_scalars;
+  h_ptr[5] = channel_index;
+  h_ptr[6] = num_frames;
+
+  // Perform the multi frame memcpy
+  if (message->mca_ptrs_.empty()){
+    status = detector_->histogram_memcpy(d_ptr,
+                                         first_frame,
+                                         num_frames,
+                                         buffer_length_,
+                                         num_spectra_,
+                                         num_aux_data_,
+                                         channel_index,
+                                         num_channels);
+  }
+
+  // Perform the scalar memcpy
+  status = detector_->scaler_read(s_ptr,
+                                  first_frame,
+                                  num_frames,
+                                  channel_index,
+                                  num_channels);
+
+
+  // Calculate the Dead Time Correction factors
+  status = detector_->calculate_dtc_factors(s_ptr,
+                                            dtc_ptr,
+                                            inp_est_ptr,
+                                            num_frames,
+                                            channel_index,
+                                            num_channels);
+
+  message->frame_ptr_ = frame_ptr;
+  message->size_ = message_size;
+  message->pool_ = frame_pool;
+  message->first_frame_ = first_frame;
+  message->num_frames_ = num_frames;
+  message->num_scalars_ = num_scalars;
+  message->s_ptr_ = s_ptr;
+  message->dtc_ptr_ = dtc_ptr;
+  message->inp_est_ptr_ = inp_est_ptr;
+  return message;
+}
+
+/** Send a message on an endpoint.
+ *
+ * The live data for the endpoint is updated from the message before it is
+ * sent.  Only one thread may send on an endpoint at a time.
+ *
+ * \param[in] endpoint - index of the endpoint.
+ * \param[in] message - the message to send.
+ */
+void XspressDAQ::send_frames(int endpoint, boost::shared_ptr<XspressDAQMessage> message)
+{
+  // Accumulate the live data, it is only published to status readers once the
+  // configured number of frames or time has passed, this never blocks
+  live_data_->accumulate(endpoint,
+                         message->s_ptr_,
+                         message->num_scalars_,
+                         message->dtc_ptr_,
+                         message->inp_est_ptr_,
+                         message->num_frames_);
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t now_ns = timespec_ns(now);
+  uint32_t update_frames = live_update_frames_.load();
+  uint32_t update_ms = live_update_ms_.load();
+  if ((update_frames == 0 && update_ms == 0) ||
+      (update_frames > 0 && live_data_->pending(endpoint) >= update_frames) ||
+      (update_ms > 0 && (now_ns - live_publish_ns_[endpoint]) >= ((uint64_t)update_ms * 1000000))){
+    live_data_->publish(endpoint);
+    live_publish_ns_[endpoint] = now_ns;
+  }
+
+  LOG4CXX_DEBUG_LEVEL(4, logger_, "endpoint[" << endpoint << "] => sending ZMQ message with [" << message->num_frames_ << "] frames");
+  // Construct the ZMQ message wrapper and send the frames
+  zmq::message_t frame_data(message->frame_ptr_, message->size_, free_frame, message->pool_);
+  if (message->mca_ptrs_.empty()){
+    data_sockets_[endpoint]->send(frame_data, 0);
+  } else {
+    // Send the MCA data straight out of the histogram memory, the frames are
+    // released for acknowledgement once ZMQ has finished with every part
+    data_sockets_[endpoint]->send(frame_data, ZMQ_SNDMORE);
+    XspressDAQZeroCopyRef *ref = new XspressDAQZeroCopyRef();
+    ref->tracker_ = message->tracker_;
+    ref->parts_ = message->mca_ptrs_.size();
+    ref->first_frame_ = message->first_frame_;
+    ref->num_frames_ = message->num_frames_;
+    for (size_t index = 0; index < message->mca_ptrs_.size(); index++){
+      zmq::message_t mca_data(message->mca_ptrs_[index], message->mca_size_, release_zero_copy, ref);
+      data_sockets_[endpoint]->send(mca_data, (index + 1 < message->mca_ptrs_.size()) ? ZMQ_SNDMORE : 0);
+    }
+  }
+  LOG4CXX_DEBUG_LEVEL(4, logger_, "endpoint[" << endpoint << "] => message sent");
+  // Record our progress for the control thread
+  worker_frames_[endpoint] = message->first_frame_ + message->num_frames_;
+}
+
+/** Send a message on an endpoint once all earlier frames have been sent.
+ *
+ * The message is held until the message containing the preceding frames has
+ * been sent, so that the frames for each endpoint are always sent in order
+ * regardless of which worker read them.  Any held messages that become due
+ * are sent by the calling thread.
+ *
+ * \param[in] endpoint - index of the endpoint.
+ * \param[in] message - the message to send.
+ */
+void XspressDAQ::send_ordered(int endpoint, boost::shared_ptr<XspressDAQMessage> message)
+{
+  boost::lock_guard<boost::mutex> lock(send_mutex_[endpoint]);
+  std::map<uint32_t, boost::shared_ptr<XspressDAQMessage> >& pending = pending_[endpoint];
+  pending[message->first_frame_] = message;
+  while (!pending.empty() && pending.begin()->first == worker_frames_[endpoint]){
+    send_frames(endpoint, pending.begin()->second);
+    pending.erase(pending.begin());
+  }
+}
+
+/** Queue chunks of frames to be read for every endpoint.
+ *
+ * \param[in] first_frame - the first frame to queue.
+ * \param[in] num_frames - the number of frames to queue.
+ */
+void XspressDAQ::queue_chunks(uint32_t first_frame, uint32_t num_frames)
+{
+  for (uint32_t endpoint = 0; endpoint < num_threads_; endpoint++){
+    boost::lock_guard<boost::mutex> lock(chunk_mutex_[endpoint]);
+    uint32_t current_frame = 0;
+    while (current_frame < num_frames){
+      XspressDAQChunk chunk;
+      chunk.endpoint_ = endpoint;
+      chunk.first_frame_ = first_frame + current_frame;
+      chunk.num_frames_ = get_batch_frames(chunk.first_frame_, num_frames - current_frame);
+      chunks_[endpoint].push_back(chunk);
+      current_frame += chunk.num_frames_;
+    }
+  }
+}
+
+/** Take the next chunk of frames to read.
+ *
+ * Chunks for the worker's own endpoint are taken first.  If there are none
+ * the oldest chunk from the other endpoints is stolen, starting with the
+ * next endpoint along so that idle workers spread out across busy ones.
+ *
+ * \param[in] worker - index of the worker thread.
+ * \param[out] chunk - the chunk to read.
+ * \return true if a chunk was taken, false if there is no work left.
+ */
+bool XspressDAQ::take_chunk(int worker, XspressDAQChunk& chunk)
+{
+  for (uint32_t offset = 0; offset < num_threads_; offset++){
+    int endpoint = (worker + offset) % num_threads_;
+    boost::lock_guard<boost::mutex> lock(chunk_mutex_[endpoint]);
+    if (!chunks_[endpoint].empty()){
+      chunk = chunks_[endpoint].front();
+      chunks_[endpoint].pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
 //                TODO: this metadata stuff is probably quite fragile...make it better
 //                (sensitive to sizes of data types...should always be 64 bits for each of the types but maybe not?)
 //
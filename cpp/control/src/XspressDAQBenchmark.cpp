@@ -0,0 +1,492 @@
+/**
+ * XspressDAQBenchmark.cpp
+ *
+ * Measures the throughput of the MCA readout pipeline by running XspressDAQ
+ * against LibXspressSimulator and pulling the frames from each endpoint with
+ * a local sink.
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#include <time.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+using namespace std;
+
+#include <log4cxx/logger.h>
+#include <log4cxx/basicconfigurator.h>
+#include <log4cxx/propertyconfigurator.h>
+#include <log4cxx/helpers/exception.h>
+#include <log4cxx/xml/domconfigurator.h>
+using namespace log4cxx;
+using namespace log4cxx::helpers;
+
+#include <boost/program_options.hpp>
+#include <boost/atomic.hpp>
+namespace po = boost::program_options;
+
+#include "zmq/zmq.hpp"
+
+#include "logging.h"
+#include "XspressDAQ.h"
+#include "LibXspressSimulator.h"
+#include "DebugLevelLogger.h"
+#include "version.h"
+
+#define HEADER_ITEMS 7
+// Time a sink waits for a message before checking whether it should stop
+#define SINK_RECV_TIMEOUT_MS 100
+
+using namespace Xspress;
+
+/**
+ * Results recorded by a single PULL sink.
+ */
+class XspressBenchmarkSink
+{
+public:
+  XspressBenchmarkSink() :
+    messages_(0),
+    frames_(0),
+    bytes_(0),
+    next_frame_(0),
+    out_of_order_(0),
+    last_recv_ns_(0)
+  {
+  }
+
+  /** Number of messages received */
+  uint64_t messages_;
+  /** Number of frames received */
+  boost::atomic<uint64_t> frames_;
+  /** Number of bytes received across all message parts */
+  uint64_t bytes_;
+  /** Frame number expected at the start of the next message */
+  uint32_t next_frame_;
+  /** Number of messages that did not follow on from the previous message */
+  uint64_t out_of_order_;
+  /** Time the last message was received (ns) */
+  boost::atomic<uint64_t> last_recv_ns_;
+  /** Latency of every received frame from when it was acquired (us) */
+  std::vector<double> latency_us_;
+};
+
+static bool has_suffix(const std::string &str, const std::string &suffix)
+{
+  return str.size() >= suffix.size() &&
+      str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static double rusage_cpu_s(const struct rusage& usage)
+{
+  return (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1000000.0 +
+         (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1000000.0;
+}
+
+static double percentile(const std::vector<double>& sorted, double pct)
+{
+  if (sorted.empty()){
+    return 0.0;
+  }
+  size_t index = (size_t)((pct / 100.0) * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/** Receive frames from a single DAQ endpoint.
+ *
+ * Each message is received in full, including every part of a zero copy
+ * message, and the latency of each frame is measured from the time the
+ * simulator made it available.  The sink keeps draining the endpoint until
+ * told to stop so that the DAQ never blocks on a full socket.
+ *
+ * \param[in] context - ZeroMQ context used to create the PULL socket.
+ * \param[in] endpoint - endpoint to connect to.
+ * \param[in] frames - number of frames expected on the endpoint.
+ * \param[in] exposure_ns - simulated frame time (ns).
+ * \param[in] start_ns - pointer to the acquisition start time (ns).
+ * \param[out] sink - results for the endpoint.
+ * \param[in] running - cleared when the sink should stop.
+ */
+static void sink_task(zmq::context_t *context,
+                      const std::string endpoint,
+                      uint32_t frames,
+                      double exposure_ns,
+                      boost::atomic<uint64_t> *start_ns,
+                      XspressBenchmarkSink *sink,
+                      boost::atomic<bool> *running)
+{
+  zmq::socket_t socket(*context, ZMQ_PULL);
+  int timeout = SINK_RECV_TIMEOUT_MS;
+  socket.setsockopt(ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+  int linger = 0;
+  socket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+  socket.connect(endpoint.c_str());
+  sink->latency_us_.reserve(frames);
+
+  while (*running){
+    zmq::message_t header_part;
+    if (!socket.recv(&header_part)){
+      continue;
+    }
+    uint64_t recv_ns = monotonic_ns();
+    uint64_t bytes = header_part.size();
+    // Drain any further parts of a zero copy message
+    int more = 0;
+    size_t more_size = sizeof(more);
+    socket.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+    while (more){
+      zmq::message_t part;
+      socket.recv(&part);
+      bytes += part.size();
+      socket.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+    }
+    if (header_part.size() < HEADER_ITEMS * sizeof(uint32_t)){
+      continue;
+    }
+    uint32_t *header = static_cast<uint32_t *>(header_part.data());
+    uint32_t first_frame = header[0];
+    uint32_t num_frames = header[6];
+    if (first_frame != sink->next_frame_){
+      sink->out_of_order_++;
+    }
+    sink->next_frame_ = first_frame + num_frames;
+    for (uint32_t frame = first_frame; frame < first_frame + num_frames; frame++){
+      // A simulated frame is available once its exposure has completed
+      double ready_ns = (double)*start_ns + (frame + 1) * exposure_ns;
+      sink->latency_us_.push_back(std::max(0.0, ((double)recv_ns - ready_ns) / 1000.0));
+    }
+    sink->messages_++;
+    sink->frames_ += num_frames;
+    sink->bytes_ += bytes;
+    sink->last_recv_ns_ = recv_ns;
+  }
+  socket.close();
+}
+
+void parse_arguments(int argc, char** argv, po::variables_map& vm, LoggerPtr& logger)
+{
+  try
+  {
+    po::options_description generic("Generic options");
+    generic.add_options()
+        ("help,h",
+         "Print this help message")
+        ("version,v",
+         "Print program version string")
+        ;
+    po::options_description config("Benchmark options");
+    config.add_options()
+        ("debug-level,d",      po::value<unsigned int>()->default_value(debug_level),
+           "Set the debug level")
+        ("logconfig,l",        po::value<string>(),
+           "Set the log4cxx logging configuration file")
+        ("channels,c",         po::value<uint32_t>()->default_value(8),
+           "Number of simulated channels")
+        ("spectra",            po::value<uint32_t>()->default_value(4096),
+           "Number of energy bins in each spectrum")
+        ("resgrades",          po::value<bool>()->default_value(false),
+           "Read out the resgrade aux planes with each spectrum")
+        ("frames,f",           po::value<uint32_t>()->default_value(10000),
+           "Number of frames to acquire")
+        ("exposure,e",         po::value<double>()->default_value(0.000001),
+           "Simulated frame time in seconds")
+        ("buffer-frames",      po::value<uint32_t>()->default_value(0),
+           "Number of frames in the simulated circular buffer (0 for unlimited)")
+        ("count-rate",         po::value<double>()->default_value(100000.0),
+           "Simulated count rate on each channel (counts/s)")
+        ("ring-frames",        po::value<uint32_t>()->default_value(64),
+           "Number of frames generated before the simulated data repeats")
+        ("generator-threads",  po::value<uint32_t>()->default_value(2),
+           "Number of threads generating the simulated data")
+        ("endpoints,n",        po::value<uint32_t>()->default_value(2),
+           "Number of DAQ endpoints (and worker threads)")
+        ("address",            po::value<string>()->default_value("127.0.0.1"),
+           "Address the DAQ endpoints are bound to")
+        ("port,p",             po::value<uint32_t>()->default_value(15150),
+           "Port of the first DAQ endpoint")
+        ("batch-size",         po::value<uint32_t>()->default_value(1),
+           "Maximum number of frames sent in each message")
+        ("pool-buffers",       po::value<uint32_t>()->default_value(256),
+           "Number of buffers allocated across the frame buffer pools")
+        ("wait-policy",        po::value<string>()->default_value("backoff"),
+           "Control thread wait policy (spin, yield, backoff or notify)")
+        ("wait-max-us",        po::value<uint32_t>()->default_value(1000),
+           "Maximum time in microseconds to wait between polls")
+        ("work-stealing",      po::value<bool>()->default_value(false),
+           "Share frame reading between the worker threads")
+        ("zero-copy",          po::value<bool>()->default_value(false),
+           "Send MCA data directly out of the histogram memory")
+        ("control-cpus",       po::value<string>()->default_value(""),
+           "CPU list for the DAQ control thread")
+        ("worker-cpus",        po::value<std::vector<string> >()->multitoken(),
+           "CPU list for each DAQ worker thread")
+        ("io-cpus",            po::value<string>()->default_value(""),
+           "CPU list for the ZeroMQ IO threads")
+        ("timeout,t",          po::value<double>()->default_value(60.0),
+           "Time in seconds to wait for the acquisition to complete")
+        ;
+
+    po::options_description cmdline_options;
+    cmdline_options.add(generic).add(config);
+
+    po::store(po::parse_command_line(argc, argv, cmdline_options), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+      std::cout << "usage: xspressDAQBenchmark [options]" << std::endl << std::endl;
+      std::cout << cmdline_options << std::endl;
+      exit(1);
+    }
+
+    if (vm.count("version")) {
+      std::cout << "xspressDAQBenchmark version " << XSPRESS_DETECTOR_VERSION_STR << std::endl;
+      exit(1);
+    }
+
+    if (vm.count("logconfig"))
+    {
+      std::string logconf_fname = vm["logconfig"].as<string>();
+      if (has_suffix(logconf_fname, ".xml")) {
+        log4cxx::xml::DOMConfigurator::configure(logconf_fname);
+      } else {
+        PropertyConfigurator::configure(logconf_fname);
+      }
+    } else {
+      // Keep the DAQ quiet so that it does not skew the measurement
+      BasicConfigurator::configure();
+      Logger::getRootLogger()->setLevel(Level::getWarn());
+    }
+
+    if (vm.count("debug-level"))
+    {
+      set_debug_level(vm["debug-level"].as<unsigned int>());
+    }
+  }
+  catch (Exception &e)
+  {
+    LOG4CXX_FATAL(logger, "Got Log4CXX exception: " << e.what());
+    throw;
+  }
+  catch (exception &e)
+  {
+    LOG4CXX_ERROR(logger, "Got exception:" << e.what());
+    throw;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  OdinData::app_path = argv[0];
+  LoggerPtr logger(Logger::getLogger("Xspress.Benchmark"));
+
+  po::variables_map vm;
+  try {
+    parse_arguments(argc, argv, vm, logger);
+  }
+  catch (exception &e)
+  {
+    std::cerr << "Invalid arguments: " << e.what() << std::endl;
+    return 1;
+  }
+
+  uint32_t num_channels = vm["channels"].as<uint32_t>();
+  uint32_t num_spectra = vm["spectra"].as<uint32_t>();
+  uint32_t num_frames = vm["frames"].as<uint32_t>();
+  double exposure = vm["exposure"].as<double>();
+  uint32_t num_endpoints = vm["endpoints"].as<uint32_t>();
+
+  if (num_channels == 0 || num_endpoints == 0 || num_endpoints > num_channels || num_frames == 0){
+    std::cerr << "The number of frames and channels must be non-zero, with at least one channel per endpoint" << std::endl;
+    return 1;
+  }
+  if (exposure <= 0.0){
+    std::cerr << "The exposure time must be positive" << std::endl;
+    return 1;
+  }
+  if (num_spectra == 0 || num_spectra > 4096){
+    std::cerr << "The number of spectra must be between 1 and 4096" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> endpoints;
+  for (uint32_t index = 0; index < num_endpoints; index++){
+    std::stringstream endpoint;
+    endpoint << "tcp://" << vm["address"].as<string>() << ":" << vm["port"].as<uint32_t>() + index;
+    endpoints.push_back(endpoint.str());
+  }
+
+  // Set up the simulated detector for a software triggered acquisition
+  boost::shared_ptr<LibXspressSimulator> detector(new LibXspressSimulator());
+  int num_aux = 1;
+  detector->configure_mca(1, vm["buffer-frames"].as<uint32_t>(), "", -1, num_channels, 0, 0);
+  detector->setup_format_run_mode(false, vm["resgrades"].as<bool>(), num_channels, num_aux);
+  detector->setTriggerMode(num_frames, exposure, SIM_CLOCK_PERIOD, TM_SOFTWARE, 0, 0, 0);
+  detector->set_count_rate(vm["count-rate"].as<double>());
+  detector->set_ring_frames(vm["ring-frames"].as<uint32_t>());
+  detector->set_generator_threads(vm["generator-threads"].as<uint32_t>());
+
+  XspressDAQ *daq = new XspressDAQ(detector, num_channels, num_spectra, endpoints, vm["io-cpus"].as<string>());
+  daq->set_num_aux_data(num_aux);
+  daq->set_batch_size(vm["batch-size"].as<uint32_t>());
+  daq->set_pool_buffers(vm["pool-buffers"].as<uint32_t>());
+  daq->set_wait_max_us(vm["wait-max-us"].as<uint32_t>());
+  daq->set_work_stealing(vm["work-stealing"].as<bool>());
+  daq->set_zero_copy(vm["zero-copy"].as<bool>());
+  if (daq->set_wait_policy(vm["wait-policy"].as<string>()) != XSP_STATUS_OK){
+    std::cerr << "Invalid wait policy: " << vm["wait-policy"].as<string>() << std::endl;
+    delete daq;
+    return 1;
+  }
+  if (daq->set_control_cpus(vm["control-cpus"].as<string>()) != XSP_STATUS_OK){
+    std::cerr << "Invalid control thread CPU list" << std::endl;
+    delete daq;
+    return 1;
+  }
+  if (vm.count("worker-cpus")){
+    if (daq->set_worker_cpus(vm["worker-cpus"].as<std::vector<string> >()) != XSP_STATUS_OK){
+      std::cerr << "Invalid worker thread CPU lists" << std::endl;
+      delete daq;
+      return 1;
+    }
+  }
+
+  // Start a PULL sink for each endpoint
+  zmq::context_t sink_context(1);
+  boost::atomic<bool> sinks_running(true);
+  boost::atomic<uint64_t> start_ns(0);
+  std::vector<XspressBenchmarkSink> sinks(num_endpoints);
+  std::vector<boost::thread *> sink_threads;
+  for (uint32_t index = 0; index < num_endpoints; index++){
+    sink_threads.push_back(new boost::thread(&sink_task,
+                                             &sink_context,
+                                             endpoints[index],
+                                             num_frames,
+                                             exposure * 1000000000.0,
+                                             &start_ns,
+                                             &sinks[index],
+                                             &sinks_running));
+  }
+  // Give the sockets time to connect before any frames are sent
+  boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+
+  // Run the acquisition
+  struct rusage usage_start, usage_end;
+  getrusage(RUSAGE_SELF, &usage_start);
+  double poll_cpu_start = daq->get_poll_cpu_time();
+  daq->startAcquisition(num_frames);
+  start_ns = monotonic_ns();
+  detector->histogram_start(0);
+
+  // Wait for every sink to receive all of the frames
+  bool complete = false;
+  bool failed = false;
+  uint64_t timeout_ns = (uint64_t)(vm["timeout"].as<double>() * 1000000000.0);
+  while (!complete && !failed && monotonic_ns() - start_ns < timeout_ns){
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    // An overrun aborts the acquisition once the dispatched frames are sent
+    failed = daq->getAcqFailed() && !daq->getAcqRunning();
+    complete = true;
+    for (uint32_t index = 0; index < num_endpoints; index++){
+      if (sinks[index].frames_ < num_frames){
+        complete = false;
+      }
+    }
+  }
+  getrusage(RUSAGE_SELF, &usage_end);
+  if (failed){
+    // Allow the sinks to receive the frames that were sent before the abort
+    boost::this_thread::sleep(boost::posix_time::milliseconds(SINK_RECV_TIMEOUT_MS));
+    std::cerr << "Acquisition failed: " << detector->getErrorString() << std::endl;
+  } else if (!complete){
+    std::cerr << "Timed out waiting for frames, results are for a partial acquisition" << std::endl;
+    daq->stopAcquisition();
+  }
+  // Wait for the control thread to finish so the DAQ statistics are final
+  while (daq->getAcqRunning()){
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  }
+
+  // Collect the results from every sink
+  uint64_t messages = 0;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  uint64_t out_of_order = 0;
+  uint64_t end_ns = start_ns;
+  std::vector<double> latency_us;
+  for (uint32_t index = 0; index < num_endpoints; index++){
+    messages += sinks[index].messages_;
+    frames += sinks[index].frames_;
+    bytes += sinks[index].bytes_;
+    out_of_order += sinks[index].out_of_order_;
+    end_ns = std::max(end_ns, (uint64_t)sinks[index].last_recv_ns_);
+    latency_us.insert(latency_us.end(), sinks[index].latency_us_.begin(), sinks[index].latency_us_.end());
+  }
+  std::sort(latency_us.begin(), latency_us.end());
+  double elapsed_s = (double)(end_ns - start_ns) / 1000000000.0;
+  double cpu_s = rusage_cpu_s(usage_end) - rusage_cpu_s(usage_start);
+  double poll_cpu_s = daq->get_poll_cpu_time() - poll_cpu_start;
+  // Every endpoint receives every frame for its own channels
+  double frame_rate = elapsed_s > 0.0 ? (double)(frames / num_endpoints) / elapsed_s : 0.0;
+  double data_rate = elapsed_s > 0.0 ? (double)bytes / elapsed_s / 1000000.0 : 0.0;
+  double acq_s = num_frames * exposure;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Configuration" << std::endl;
+  std::cout << "  channels:          " << num_channels << std::endl;
+  std::cout << "  spectra x aux:     " << num_spectra << " x " << num_aux << std::endl;
+  std::cout << "  frames:            " << num_frames << " (exposure " << exposure << " s)" << std::endl;
+  std::cout << "  count rate:        " << detector->get_count_rate() << " counts/s" << std::endl;
+  std::cout << "  endpoints:         " << num_endpoints << std::endl;
+  std::cout << "  batch size:        " << daq->get_batch_size() << std::endl;
+  std::cout << "  wait policy:       " << daq->get_wait_policy() << std::endl;
+  std::cout << "  work stealing:     " << (daq->get_work_stealing() ? "true" : "false") << std::endl;
+  std::cout << "  zero copy:         " << (daq->get_zero_copy() ? "true" : "false") << std::endl;
+  std::cout << "Results" << std::endl;
+  std::cout << "  complete:          " << (complete ? "true" : "false") << std::endl;
+  std::cout << "  elapsed:           " << elapsed_s << " s (simulated " << acq_s << " s)" << std::endl;
+  std::cout << "  messages:          " << messages << " (" << out_of_order << " out of order)" << std::endl;
+  std::cout << "  frames/s:          " << frame_rate << std::endl;
+  std::cout << "  MB/s:              " << data_rate << std::endl;
+  std::cout << "  latency p50:       " << percentile(latency_us, 50.0) << " us" << std::endl;
+  std::cout << "  latency p90:       " << percentile(latency_us, 90.0) << " us" << std::endl;
+  std::cout << "  latency p99:       " << percentile(latency_us, 99.0) << " us" << std::endl;
+  std::cout << "  latency max:       " << (latency_us.empty() ? 0.0 : latency_us.back()) << " us" << std::endl;
+  std::cout << "  process CPU:       " << cpu_s << " s (" << (elapsed_s > 0.0 ? 100.0 * cpu_s / elapsed_s : 0.0) << "% of one core, including sinks)" << std::endl;
+  std::cout << "  control poll CPU:  " << poll_cpu_s << " s (" << daq->get_poll_cpu_load() << "% of one core)" << std::endl;
+  std::cout << "  pool exhausted:    " << daq->get_pool_exhausted() << std::endl;
+  std::cout << "  acquisition:       " << (daq->getAcqFailed() ? "failed" : "ok") << std::endl;
+  if (detector->get_buffer_frames() > 0){
+    std::cout << "  buffer high water: " << detector->get_buffer_high_water() << " of "
+              << detector->get_buffer_frames() << " frames" << std::endl;
+    std::cout << "  dropped frames:    " << detector->get_dropped_frame_count();
+    if (detector->get_first_dropped_frame() >= 0){
+      std::cout << " (first " << detector->get_first_dropped_frame() << ")";
+    }
+    std::cout << std::endl;
+  }
+
+  // Shut down the DAQ while the sinks are still draining the endpoints
+  delete daq;
+  sinks_running = false;
+  for (uint32_t index = 0; index < num_endpoints; index++){
+    sink_threads[index]->join();
+    delete sink_threads[index];
+  }
+  sink_context.close();
+
+  return complete ? 0 : 2;
+}
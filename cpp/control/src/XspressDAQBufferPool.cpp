@@ -0,0 +1,150 @@
+/*
+ * XspressDAQBufferPool.cpp
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "XspressDAQBufferPool.h"
+
+namespace Xspress
+{
+/** Construct a new XspressDAQBufferPool class.
+ *
+ * A single block of memory large enough to hold all of the buffers is
+ * mapped and each buffer within it is placed onto the free stack.  The
+ * block is not written to here, so its pages are placed on the NUMA node of
+ * the first thread to touch them (see prefault).
+ *
+ * \param[in] buffer_size - size of each buffer in bytes.
+ * \param[in] num_buffers - number of buffers to hold in the pool.
+ */
+XspressDAQBufferPool::XspressDAQBufferPool(size_t buffer_size, uint32_t num_buffers) :
+    buffer_size_(buffer_size),
+    num_buffers_(num_buffers),
+    block_(0),
+    free_stack_(num_buffers),
+    free_count_(0),
+    exhausted_(0),
+    prefaulted_(false)
+{
+  // Keep each buffer 64 byte aligned so that buffers never share a cache line
+  buffer_size_ = (buffer_size_ + 63) & ~((size_t)63);
+  if (num_buffers_ > 0){
+    void *block = mmap(0, buffer_size_ * num_buffers_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED){
+      block_ = 0;
+      num_buffers_ = 0;
+    } else {
+      block_ = (char *)block;
+    }
+  }
+  for (uint32_t index = 0; index < num_buffers_; index++){
+    free_stack_.bounded_push(block_ + (index * buffer_size_));
+  }
+  free_count_ = num_buffers_;
+}
+
+/** Destructor for XspressDAQBufferPool class.
+ *
+ * The owner must ensure that no buffers are outstanding before the pool is
+ * destroyed.
+ */
+XspressDAQBufferPool::~XspressDAQBufferPool()
+{
+  if (block_){
+    munmap(block_, buffer_size_ * num_buffers_);
+  }
+}
+
+/** Touch every page of the pool from the calling thread.
+ *
+ * Under the default first-touch policy this places the pool memory on the
+ * NUMA node local to the calling thread, so it should be called by the
+ * thread that will fill the buffers after it has been pinned to its CPUs.
+ * Only the first call has any effect.
+ */
+void XspressDAQBufferPool::prefault()
+{
+  if (block_ && !prefaulted_.exchange(true)){
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t block_size = buffer_size_ * num_buffers_;
+    for (size_t offset = 0; offset < block_size; offset += page_size){
+      block_[offset] = 0;
+    }
+  }
+}
+
+/** Take a buffer from the pool.
+ *
+ * \return pointer to the buffer, or NULL if the pool is empty.
+ */
+void *XspressDAQBufferPool::allocate()
+{
+  char *buffer = 0;
+  if (free_stack_.pop(buffer)){
+    free_count_--;
+  } else {
+    exhausted_++;
+  }
+  return buffer;
+}
+
+/** Return a buffer to the pool.
+ *
+ * \param[in] buffer - pointer to a buffer previously returned by allocate.
+ */
+void XspressDAQBufferPool::release(void *buffer)
+{
+  if (owns(buffer)){
+    free_stack_.bounded_push((char *)buffer);
+    free_count_++;
+  }
+}
+
+/** Check if a buffer belongs to this pool.
+ *
+ * \param[in] buffer - pointer to the buffer to check.
+ * \return true if the buffer was allocated from this pool.
+ */
+bool XspressDAQBufferPool::owns(void *buffer)
+{
+  char *ptr = (char *)buffer;
+  return (block_ && ptr >= block_ && ptr < (block_ + (buffer_size_ * num_buffers_)));
+}
+
+size_t XspressDAQBufferPool::buffer_size()
+{
+  return buffer_size_;
+}
+
+uint32_t XspressDAQBufferPool::num_buffers()
+{
+  return num_buffers_;
+}
+
+uint32_t XspressDAQBufferPool::free_buffers()
+{
+  return free_count_;
+}
+
+uint32_t XspressDAQBufferPool::outstanding()
+{
+  return num_buffers_ - free_count_;
+}
+
+uint64_t XspressDAQBufferPool::exhausted()
+{
+  return exhausted_;
+}
+
+void XspressDAQBufferPool::reset_statistics()
+{
+  exhausted_ = 0;
+}
+
+} /* namespace Xspress */
@@ -0,0 +1,189 @@
+/*
+ * XspressDAQLiveData.cpp
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#include <string.h>
+#include <cmath>
+
+#include "XspressDAQLiveData.h"
+
+namespace Xspress
+{
+/** Construct a new XspressDAQLiveData class.
+ *
+ * \param[in] channels - number of channels owned by each writer, in channel order.
+ */
+XspressDAQLiveData::XspressDAQLiveData(const std::vector<int>& channels) :
+    num_channels_(0),
+    num_sections_(channels.size())
+{
+  sections_.reset(new Section[num_sections_]);
+  for (uint32_t index = 0; index < num_sections_; index++){
+    sections_[index].sequence = 0;
+    sections_[index].first_channel = num_channels_;
+    sections_[index].num_channels = channels[index];
+    sections_[index].pending_frames = 0;
+    num_channels_ += channels[index];
+  }
+  data_.reset(new XspressLiveChannel[num_channels_]);
+  staged_.reset(new XspressLiveChannel[num_channels_]);
+  inp_est_sum_.reset(new double[num_channels_]);
+  memset(data_.get(), 0, num_channels_ * sizeof(XspressLiveChannel));
+  memset(staged_.get(), 0, num_channels_ * sizeof(XspressLiveChannel));
+  for (uint32_t index = 0; index < num_channels_; index++){
+    data_[index].dtc = 1.0;
+    staged_[index].dtc = 1.0;
+    inp_est_sum_[index] = 0.0;
+  }
+}
+
+XspressDAQLiveData::~XspressDAQLiveData()
+{
+}
+
+/** Accumulate the values from a set of frames for one section.
+ *
+ * Only the worker that owns the section may call this method.  Nothing is
+ * visible to readers until publish is called.
+ *
+ * \param[in] section - index of the writer section.
+ * \param[in] scalars - scalar values laid out [frame][channel][num_scalars].
+ * \param[in] num_scalars - number of scalars per channel.
+ * \param[in] dtc - dead time correction factors laid out [frame][channel].
+ * \param[in] inp_est - input estimates laid out [frame][channel].
+ * \param[in] num_frames - number of frames.
+ */
+void XspressDAQLiveData::accumulate(int section,
+                                    const uint32_t *scalars,
+                                    uint32_t num_scalars,
+                                    const double *dtc,
+                                    const double *inp_est,
+                                    uint32_t num_frames)
+{
+  if (section < 0 || (uint32_t)section >= num_sections_ || num_frames == 0){
+    return;
+  }
+  Section& sect = sections_[section];
+  uint32_t copy_scalars = num_scalars < LIVE_DATA_SCALARS ? num_scalars : LIVE_DATA_SCALARS;
+  for (uint32_t frame = 0; frame < num_frames; frame++){
+    const double *frame_inp_est = inp_est + (frame * sect.num_channels);
+    for (uint32_t c_index = 0; c_index < sect.num_channels; c_index++){
+      XspressLiveChannel& live = staged_[sect.first_channel + c_index];
+      double value = frame_inp_est[c_index];
+      if (sect.pending_frames == 0 && frame == 0){
+        live.inp_est_min = value;
+        live.inp_est_max = value;
+        inp_est_sum_[sect.first_channel + c_index] = 0.0;
+      }
+      if (value < live.inp_est_min){
+        live.inp_est_min = value;
+      }
+      if (value > live.inp_est_max){
+        live.inp_est_max = value;
+      }
+      inp_est_sum_[sect.first_channel + c_index] += value;
+    }
+  }
+  sect.pending_frames += num_frames;
+
+  // The instantaneous values come from the last frame
+  const uint32_t *last_scalars = scalars + ((num_frames-1) * sect.num_channels * num_scalars);
+  const double *last_dtc = dtc + ((num_frames-1) * sect.num_channels);
+  const double *last_inp_est = inp_est + ((num_frames-1) * sect.num_channels);
+  for (uint32_t c_index = 0; c_index < sect.num_channels; c_index++){
+    XspressLiveChannel& live = staged_[sect.first_channel + c_index];
+    memcpy(live.scalars, last_scalars + (c_index * num_scalars), copy_scalars * sizeof(uint32_t));
+    if (std::isinf(last_dtc[c_index]) || std::isnan(last_dtc[c_index])){
+      live.dtc = 1.0;
+    } else {
+      live.dtc = last_dtc[c_index];
+    }
+    live.inp_est = last_inp_est[c_index];
+  }
+}
+
+/** Number of frames accumulated for a section since it was last published.
+ *
+ * \param[in] section - index of the writer section.
+ * \return number of frames.
+ */
+uint32_t XspressDAQLiveData::pending(int section)
+{
+  uint32_t frames = 0;
+  if (section >= 0 && (uint32_t)section < num_sections_){
+    frames = sections_[section].pending_frames;
+  }
+  return frames;
+}
+
+/** Publish the accumulated values for one section to readers.
+ *
+ * Only the worker that owns the section may call this method.  The sequence
+ * counter is odd for the duration of the update so that readers can detect
+ * and retry a torn copy.  The accumulated aggregates are reset ready for the
+ * next window.
+ *
+ * \param[in] section - index of the writer section.
+ */
+void XspressDAQLiveData::publish(int section)
+{
+  if (section < 0 || (uint32_t)section >= num_sections_){
+    return;
+  }
+  Section& sect = sections_[section];
+  if (sect.pending_frames == 0){
+    return;
+  }
+  for (uint32_t c_index = 0; c_index < sect.num_channels; c_index++){
+    XspressLiveChannel& live = staged_[sect.first_channel + c_index];
+    live.inp_est_mean = inp_est_sum_[sect.first_channel + c_index] / sect.pending_frames;
+    live.window_frames = sect.pending_frames;
+  }
+  uint32_t seq = sect.sequence.load(boost::memory_order_relaxed);
+  sect.sequence.store(seq + 1, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  memcpy(&data_[sect.first_channel],
+         &staged_[sect.first_channel],
+         sect.num_channels * sizeof(XspressLiveChannel));
+  sect.sequence.store(seq + 2, boost::memory_order_release);
+  sect.pending_frames = 0;
+}
+
+/** Take a consistent copy of the live values for all channels.
+ *
+ * \param[out] channels - vector to receive the live values, resized to the number of channels.
+ */
+void XspressDAQLiveData::snapshot(std::vector<XspressLiveChannel>& channels)
+{
+  channels.resize(num_channels_);
+  for (uint32_t index = 0; index < num_sections_; index++){
+    Section& sect = sections_[index];
+    if (sect.num_channels == 0){
+      continue;
+    }
+    uint32_t seq_start = 0;
+    uint32_t seq_end = 0;
+    do {
+      seq_start = sect.sequence.load(boost::memory_order_acquire);
+      if (seq_start & 1){
+        // A writer is part way through an update
+        continue;
+      }
+      memcpy(&channels[sect.first_channel],
+             &data_[sect.first_channel],
+             sect.num_channels * sizeof(XspressLiveChannel));
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      seq_end = sect.sequence.load(boost::memory_order_relaxed);
+    } while ((seq_start & 1) || seq_start != seq_end);
+  }
+}
+
+uint32_t XspressDAQLiveData::num_channels()
+{
+  return num_channels_;
+}
+
+} /* namespace Xspress */
@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "dirent.h"
 
 #include "XspressDetector.h"
@@ -48,7 +49,21 @@ XspressDetector::XspressDetector(bool simulation) :
     xsp_debounce_(0),
     xsp_exposure_time_(1.0),
     xsp_frames_(1),
-    xsp_mode_(XSP_MODE_MCA)
+    xsp_mode_(XSP_MODE_MCA),
+    xsp_daq_batch_size_(1),
+    xsp_daq_frames_per_message_(1),
+    xsp_daq_pool_buffers_(256),
+    xsp_daq_wait_policy_("backoff"),
+    xsp_daq_wait_max_us_(1000),
+    xsp_daq_live_update_frames_(0),
+    xsp_daq_live_update_ms_(100),
+    xsp_daq_control_cpus_(""),
+    xsp_daq_io_cpus_(""),
+    xsp_daq_work_stealing_(false),
+    xsp_daq_zero_copy_(false),
+    xsp_sim_count_rate_(100000.0),
+    xsp_sim_ring_frames_(64),
+    xsp_sim_threads_(2)
 {
   OdinData::configure_logging_mdc(OdinData::app_path.c_str());
   LOG4CXX_INFO(logger_, "Constructing XspressDetector");
@@ -58,7 +73,11 @@ XspressDetector::XspressDetector(bool simulation) :
     detector_ = boost::shared_ptr<ILibXspress>(new LibXspressWrapper()); 
   } else {
     LOG4CXX_INFO(logger_, "Loading LibXspressSimulator object");
-    detector_ = boost::shared_ptr<ILibXspress>(new LibXspressSimulator()); 
+    simulator_ = boost::shared_ptr<LibXspressSimulator>(new LibXspressSimulator());
+    simulator_->set_count_rate(xsp_sim_count_rate_);
+    simulator_->set_ring_frames(xsp_sim_ring_frames_);
+    simulator_->set_generator_threads(xsp_sim_threads_);
+    detector_ = simulator_;
   }
 
   // Setup a default for maximum channels to initialise all vectors of 
@@ -261,9 +280,32 @@ int XspressDetector::enableDAQ()
     if (xsp_daq_endpoints_.size() > 0){
       LOG4CXX_INFO(logger_, "XspressDetector creating DAQ object");
       // Create the DAQ object
-      daq_ = boost::shared_ptr<XspressDAQ>(new XspressDAQ(detector_, xsp_max_channels_, xsp_max_spectra_, xsp_daq_endpoints_));
+      daq_ = boost::shared_ptr<XspressDAQ>(new XspressDAQ(detector_, xsp_max_channels_, xsp_max_spectra_, xsp_daq_endpoints_, xsp_daq_io_cpus_));
       // Setup DAQ object with num_aux_data
       daq_->set_num_aux_data(xsp_num_aux_data_);
+      // Setup DAQ object with the number of frames per message
+      daq_->set_batch_size(xsp_daq_batch_size_);
+      // Setup DAQ object with the number of pooled frame buffers
+      daq_->set_pool_buffers(xsp_daq_pool_buffers_);
+      // Setup DAQ object with the wait policy
+      daq_->set_wait_policy(xsp_daq_wait_policy_);
+      daq_->set_wait_max_us(xsp_daq_wait_max_us_);
+      // Setup DAQ object with the live data update rate
+      daq_->set_live_update_frames(xsp_daq_live_update_frames_);
+      daq_->set_live_update_ms(xsp_daq_live_update_ms_);
+      // Setup DAQ object with the work sharing mode
+      daq_->set_work_stealing(xsp_daq_work_stealing_);
+      // Setup DAQ object with the zero copy mode
+      daq_->set_zero_copy(xsp_daq_zero_copy_);
+      // Pin the DAQ threads to their CPUs
+      if (daq_->set_control_cpus(xsp_daq_control_cpus_) != XSP_STATUS_OK){
+        setErrorString("Failed to pin DAQ control thread to CPUs [" + xsp_daq_control_cpus_ + "]");
+        status = XSP_STATUS_ERROR;
+      }
+      if (daq_->set_worker_cpus(xsp_daq_worker_cpus_) != XSP_STATUS_OK){
+        setErrorString("Failed to pin DAQ worker threads to their CPUs");
+        status = XSP_STATUS_ERROR;
+      }
     } else {
       LOG4CXX_ERROR(logger_, "Cannot set up DAQ as no endpoints have been specified");
       status = XSP_STATUS_ERROR;
@@ -974,6 +1016,293 @@ std::vector<std::string> XspressDetector::getXspDAQEndpoints()
   return xsp_daq_endpoints_;
 }
 
+int XspressDetector::setXspDAQBatchSize(uint32_t batch_size)
+{
+  return setXspDAQBatchSize(batch_size, xsp_daq_frames_per_message_);
+}
+
+int XspressDetector::setXspDAQBatchSize(uint32_t batch_size, uint32_t frames_per_message)
+{
+  int status = XSP_STATUS_OK;
+  // The frame receiver copies each message into a buffer sized for frames_per_message
+  // frames before it can check the size, so a larger batch would overrun the buffer.
+  // Both values are set together so that either can be reduced or increased first.
+  if (frames_per_message == 0 || batch_size > frames_per_message){
+    std::stringstream ss;
+    ss << "DAQ batch size " << batch_size << " exceeds the frame receiver frames per message "
+       << frames_per_message;
+    setErrorString(ss.str());
+    status = XSP_STATUS_ERROR;
+  } else {
+    xsp_daq_frames_per_message_ = frames_per_message;
+    xsp_daq_batch_size_ = batch_size;
+    // If the DAQ object exists then update the batch size
+    if (daq_){
+      daq_->set_batch_size(xsp_daq_batch_size_);
+    }
+  }
+  return status;
+}
+
+uint32_t XspressDetector::getXspDAQBatchSize()
+{
+  return xsp_daq_batch_size_;
+}
+
+uint32_t XspressDetector::getXspDAQFramesPerMessage()
+{
+  return xsp_daq_frames_per_message_;
+}
+
+void XspressDetector::setXspDAQPoolBuffers(uint32_t pool_buffers)
+{
+  xsp_daq_pool_buffers_ = pool_buffers;
+  // If the DAQ object exists then update the pool size, applied at the next acquisition
+  if (daq_){
+    daq_->set_pool_buffers(xsp_daq_pool_buffers_);
+  }
+}
+
+uint32_t XspressDetector::getXspDAQPoolBuffers()
+{
+  return xsp_daq_pool_buffers_;
+}
+
+uint32_t XspressDetector::getXspDAQPoolAllocated()
+{
+  uint32_t buffers = 0;
+  if (daq_){
+    buffers = daq_->get_pool_allocated();
+  }
+  return buffers;
+}
+
+uint32_t XspressDetector::getXspDAQPoolFree()
+{
+  uint32_t buffers = 0;
+  if (daq_){
+    buffers = daq_->get_pool_free_buffers();
+  }
+  return buffers;
+}
+
+uint64_t XspressDetector::getXspDAQPoolExhausted()
+{
+  uint64_t exhausted = 0;
+  if (daq_){
+    exhausted = daq_->get_pool_exhausted();
+  }
+  return exhausted;
+}
+
+void XspressDetector::resetDAQStatistics()
+{
+  if (daq_){
+    daq_->reset_statistics();
+  }
+}
+
+int XspressDetector::setXspDAQWaitPolicy(const std::string& policy)
+{
+  int status = XSP_STATUS_OK;
+  if (policy != "spin" && policy != "yield" && policy != "backoff" && policy != "notify"){
+    setErrorString("Invalid DAQ wait policy: " + policy);
+    status = XSP_STATUS_ERROR;
+  } else {
+    xsp_daq_wait_policy_ = policy;
+    // If the DAQ object exists then update the wait policy
+    if (daq_){
+      status = daq_->set_wait_policy(xsp_daq_wait_policy_);
+    }
+  }
+  return status;
+}
+
+std::string XspressDetector::getXspDAQWaitPolicy()
+{
+  return xsp_daq_wait_policy_;
+}
+
+void XspressDetector::setXspDAQWaitMaxUs(uint32_t wait_max_us)
+{
+  xsp_daq_wait_max_us_ = wait_max_us;
+  // If the DAQ object exists then update the maximum wait
+  if (daq_){
+    daq_->set_wait_max_us(xsp_daq_wait_max_us_);
+  }
+}
+
+uint32_t XspressDetector::getXspDAQWaitMaxUs()
+{
+  return xsp_daq_wait_max_us_;
+}
+
+void XspressDetector::setXspDAQLiveUpdateFrames(uint32_t frames)
+{
+  xsp_daq_live_update_frames_ = frames;
+  // If the DAQ object exists then update the live update rate
+  if (daq_){
+    daq_->set_live_update_frames(xsp_daq_live_update_frames_);
+  }
+}
+
+uint32_t XspressDetector::getXspDAQLiveUpdateFrames()
+{
+  return xsp_daq_live_update_frames_;
+}
+
+void XspressDetector::setXspDAQLiveUpdateMs(uint32_t update_ms)
+{
+  xsp_daq_live_update_ms_ = update_ms;
+  // If the DAQ object exists then update the live update rate
+  if (daq_){
+    daq_->set_live_update_ms(xsp_daq_live_update_ms_);
+  }
+}
+
+uint32_t XspressDetector::getXspDAQLiveUpdateMs()
+{
+  return xsp_daq_live_update_ms_;
+}
+
+int XspressDetector::setXspDAQControlCpus(const std::string& cpus)
+{
+  int status = XSP_STATUS_OK;
+  xsp_daq_control_cpus_ = cpus;
+  // If the DAQ object exists then pin the control thread now
+  if (daq_){
+    status = daq_->set_control_cpus(xsp_daq_control_cpus_);
+    if (status != XSP_STATUS_OK){
+      setErrorString("Failed to pin DAQ control thread to CPUs [" + cpus + "]");
+    }
+  }
+  return status;
+}
+
+std::string XspressDetector::getXspDAQControlCpus()
+{
+  return xsp_daq_control_cpus_;
+}
+
+int XspressDetector::setXspDAQWorkerCpus(const std::vector<std::string>& cpus)
+{
+  int status = XSP_STATUS_OK;
+  xsp_daq_worker_cpus_ = cpus;
+  // If the DAQ object exists then pin the worker threads now
+  if (daq_){
+    status = daq_->set_worker_cpus(xsp_daq_worker_cpus_);
+    if (status != XSP_STATUS_OK){
+      setErrorString("Failed to pin DAQ worker threads to their CPUs");
+    }
+  }
+  return status;
+}
+
+std::vector<std::string> XspressDetector::getXspDAQWorkerCpus()
+{
+  return xsp_daq_worker_cpus_;
+}
+
+void XspressDetector::setXspDAQIoCpus(const std::string& cpus)
+{
+  xsp_daq_io_cpus_ = cpus;
+  // The ZMQ IO threads can only be pinned when the DAQ is created
+  if (daq_){
+    LOG4CXX_WARN(logger_, "DAQ IO thread CPUs will be applied the next time the DAQ is enabled");
+  }
+}
+
+std::string XspressDetector::getXspDAQIoCpus()
+{
+  return xsp_daq_io_cpus_;
+}
+
+void XspressDetector::setXspDAQWorkStealing(bool work_stealing)
+{
+  xsp_daq_work_stealing_ = work_stealing;
+  // If the DAQ object exists then update the work sharing mode
+  if (daq_){
+    daq_->set_work_stealing(xsp_daq_work_stealing_);
+  }
+}
+
+bool XspressDetector::getXspDAQWorkStealing()
+{
+  return xsp_daq_work_stealing_;
+}
+
+void XspressDetector::setXspDAQZeroCopy(bool zero_copy)
+{
+  xsp_daq_zero_copy_ = zero_copy;
+  // If the DAQ object exists then update the zero copy mode
+  if (daq_){
+    daq_->set_zero_copy(xsp_daq_zero_copy_);
+  }
+}
+
+bool XspressDetector::getXspDAQZeroCopy()
+{
+  return xsp_daq_zero_copy_;
+}
+
+double XspressDetector::getXspDAQPollCpuTime()
+{
+  double cpu_time = 0.0;
+  if (daq_){
+    cpu_time = daq_->get_poll_cpu_time();
+  }
+  return cpu_time;
+}
+
+double XspressDetector::getXspDAQPollCpuLoad()
+{
+  double cpu_load = 0.0;
+  if (daq_){
+    cpu_load = daq_->get_poll_cpu_load();
+  }
+  return cpu_load;
+}
+
+void XspressDetector::setXspSimCountRate(double count_rate)
+{
+  xsp_sim_count_rate_ = count_rate;
+  // Only the simulator generates its own data
+  if (simulator_){
+    simulator_->set_count_rate(xsp_sim_count_rate_);
+  }
+}
+
+double XspressDetector::getXspSimCountRate()
+{
+  return xsp_sim_count_rate_;
+}
+
+void XspressDetector::setXspSimRingFrames(uint32_t ring_frames)
+{
+  xsp_sim_ring_frames_ = ring_frames;
+  if (simulator_){
+    simulator_->set_ring_frames(xsp_sim_ring_frames_);
+  }
+}
+
+uint32_t XspressDetector::getXspSimRingFrames()
+{
+  return xsp_sim_ring_frames_;
+}
+
+void XspressDetector::setXspSimThreads(uint32_t num_threads)
+{
+  xsp_sim_threads_ = num_threads;
+  if (simulator_){
+    simulator_->set_generator_threads(xsp_sim_threads_);
+  }
+}
+
+uint32_t XspressDetector::getXspSimThreads()
+{
+  return xsp_sim_threads_;
+}
+
 int XspressDetector::setSca5LowLimits(std::vector<uint32_t> sca5_low_limit)
 {
   int status = XSP_STATUS_OK;
@@ -1199,37 +1528,15 @@ std::vector<double> XspressDetector::getDtcInWindowRateGrad()
   return xsp_dtc_in_window_rate_grad_;
 }
 
-std::vector<uint32_t> XspressDetector::getLiveScalars(uint32_t index)
-{
-  std::vector<uint32_t> reply;
-  if (daq_){
-    reply = daq_->read_live_scalar(index);
-  } else {
-    reply.resize(xsp_mca_channels_);
-  }
-  return reply;
-}
-
-std::vector<double> XspressDetector::getLiveDtcFactors()
-{
-  std::vector<double> reply;
-  if (daq_){
-    reply = daq_->read_live_dtc();
-  } else {
-    reply.resize(xsp_mca_channels_);
-  }
-  return reply;
-}
-
-std::vector<double> XspressDetector::getLiveInpEst()
+void XspressDetector::getLiveData(std::vector<XspressLiveChannel>& live_data)
 {
-  std::vector<double> reply;
   if (daq_){
-    reply = daq_->read_live_inp_est();
+    daq_->read_live_data(live_data);
   } else {
-    reply.resize(xsp_mca_channels_);
+    XspressLiveChannel empty;
+    memset(&empty, 0, sizeof(empty));
+    live_data.assign(xsp_mca_channels_, empty);
   }
-  return reply;
 }
 
 bool XspressDetector::getXspAcquiring()
@@ -0,0 +1,443 @@
+/*
+ * XspressSimulatedData.cpp
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include <boost/random/uniform_01.hpp>
+#include <boost/random/poisson_distribution.hpp>
+
+#include "XspressSimulatedData.h"
+#include "logging.h"
+#include "DebugLevelLogger.h"
+
+#define DEFAULT_COUNT_RATE      100000.0
+#define DEFAULT_RING_FRAMES     64
+#define DEFAULT_NUM_THREADS     2
+// Upper limit on the memory used by the ring
+#define SIM_MAX_RING_BYTES      (512UL * 1024 * 1024)
+// Energy covered by the full 4096 bin spectrum (eV)
+#define SIM_FULL_SCALE_EV       40960.0
+// Fraction of the frame lost to preamplifier resets
+#define SIM_RESET_FRACTION      0.01
+// Number of detected events between preamplifier resets
+#define SIM_EVENTS_PER_RESET    2000
+// Pulse pair resolving time used to model pileup (s)
+#define SIM_PILEUP_TIME         0.4e-6
+// Seed for the first slot; each slot has its own seed so the ring does not
+// depend on the number of generator threads
+#define SIM_SEED                5489
+
+namespace Xspress
+{
+
+/**
+ * A simulated emission line.
+ */
+typedef struct
+{
+  double energy;     // eV
+  double intensity;  // relative to the other lines
+  double width;      // extra gaussian width in eV, 0 for a fluorescence line
+} XspressSimulatedLine;
+
+// Fluorescence lines from a mixed metal sample, with elastic and Compton
+// scattering from a 15 keV incident beam
+static const XspressSimulatedLine SIM_LINES[] = {
+  {  3692.0, 0.20,   0.0 },   // Ca Ka
+  {  6404.0, 1.00,   0.0 },   // Fe Ka
+  {  7058.0, 0.14,   0.0 },   // Fe Kb
+  {  8048.0, 0.60,   0.0 },   // Cu Ka
+  {  8639.0, 0.35,   0.0 },   // Zn Ka
+  {  8905.0, 0.08,   0.0 },   // Cu Kb
+  { 10551.0, 0.25,   0.0 },   // Pb La
+  { 12614.0, 0.18,   0.0 },   // Pb Lb
+  { 14400.0, 0.40, 350.0 },   // Compton
+  { 15000.0, 0.30,   0.0 }    // Elastic
+};
+static const int SIM_NUM_LINES = sizeof(SIM_LINES) / sizeof(SIM_LINES[0]);
+// Fraction of the counts in the scattering background
+static const double SIM_BACKGROUND = 0.15;
+
+/** Detector resolution (FWHM in eV) at the given energy, from electronic
+ * noise and Fano statistics in silicon.
+ */
+static double sim_fwhm(double energy)
+{
+  return sqrt(110.0 * 110.0 + 2.434 * energy);
+}
+
+XspressSimulatedData::XspressSimulatedData() :
+    logger_(log4cxx::Logger::getLogger("Xspress.XspressSimulatedData")),
+    count_rate_(DEFAULT_COUNT_RATE),
+    ring_frames_(DEFAULT_RING_FRAMES),
+    num_threads_(DEFAULT_NUM_THREADS),
+    num_channels_(0),
+    num_eng_(0),
+    num_aux_(0),
+    exposure_time_(0.0),
+    slots_(0),
+    valid_(false),
+    abort_(false)
+{
+}
+
+XspressSimulatedData::~XspressSimulatedData()
+{
+  stop();
+}
+
+void XspressSimulatedData::set_count_rate(double count_rate)
+{
+  if (count_rate != count_rate_){
+    count_rate_ = count_rate;
+    valid_ = false;
+  }
+}
+
+double XspressSimulatedData::get_count_rate()
+{
+  return count_rate_;
+}
+
+void XspressSimulatedData::set_ring_frames(uint32_t ring_frames)
+{
+  if (ring_frames > 0 && ring_frames != ring_frames_){
+    ring_frames_ = ring_frames;
+    valid_ = false;
+  }
+}
+
+uint32_t XspressSimulatedData::get_ring_frames()
+{
+  return ring_frames_;
+}
+
+void XspressSimulatedData::set_num_threads(uint32_t num_threads)
+{
+  if (num_threads > 0){
+    num_threads_ = num_threads;
+  }
+}
+
+uint32_t XspressSimulatedData::get_num_threads()
+{
+  return num_threads_;
+}
+
+/** Mark the ring as out of date so that it is regenerated on the next call
+ * to generate.
+ */
+void XspressSimulatedData::invalidate()
+{
+  valid_ = false;
+}
+
+/** Start generating the ring of frames for an acquisition.
+ *
+ * If the ring was already generated with the same parameters it is reused.
+ * Otherwise the generator threads are started and this call returns
+ * immediately; readers wait for each frame to be generated.
+ *
+ * \param[in] num_channels - number of channels.
+ * \param[in] num_eng - number of energy bins in each spectrum.
+ * \param[in] num_aux - number of aux (resgrade) planes.
+ * \param[in] exposure_time - frame time in seconds.
+ * \param[in] windows - SCA window limits for each channel.
+ */
+void XspressSimulatedData::generate(uint32_t num_channels,
+                                    uint32_t num_eng,
+                                    uint32_t num_aux,
+                                    double exposure_time,
+                                    const std::vector<XspressSimulatedWindows>& windows)
+{
+  bool same_windows = windows.size() == windows_.size();
+  for (size_t index = 0; same_windows && index < windows.size(); index++){
+    same_windows = windows[index].window0_low == windows_[index].window0_low &&
+                   windows[index].window0_high == windows_[index].window0_high &&
+                   windows[index].window1_low == windows_[index].window1_low &&
+                   windows[index].window1_high == windows_[index].window1_high;
+  }
+  if (valid_ && same_windows && num_channels == num_channels_ && num_eng == num_eng_ &&
+      num_aux == num_aux_ && exposure_time == exposure_time_){
+    return;
+  }
+  stop();
+
+  num_channels_ = num_channels;
+  num_eng_ = num_eng;
+  num_aux_ = num_aux;
+  exposure_time_ = exposure_time;
+  windows_ = windows;
+
+  // Limit the ring to the available memory
+  uint64_t frame_bytes = (uint64_t)num_channels_ * num_eng_ * num_aux_ * sizeof(uint32_t);
+  slots_ = ring_frames_;
+  if (frame_bytes > 0 && slots_ * frame_bytes > SIM_MAX_RING_BYTES){
+    slots_ = std::max((uint64_t)1, SIM_MAX_RING_BYTES / frame_bytes);
+  }
+  LOG4CXX_INFO(logger_, "[SIM] Generating " << slots_ << " frames of " << num_channels_ << " channels ["
+                        << num_eng_ << " x " << num_aux_ << "] at " << count_rate_ << " counts/s");
+
+  spectra_.reset(new uint32_t[(size_t)slots_ * num_channels_ * num_eng_ * num_aux_]);
+  scalars_.reset(new uint32_t[(size_t)slots_ * num_channels_ * SIM_NUM_SCALARS]);
+  ready_.reset(new boost::atomic<bool>[slots_]);
+  for (uint32_t slot = 0; slot < slots_; slot++){
+    ready_[slot] = false;
+  }
+
+  // Build the energy distribution for each channel
+  shape_cdf_.resize(num_channels_);
+  for (uint32_t channel = 0; channel < num_channels_; channel++){
+    build_shape(channel, shape_cdf_[channel]);
+  }
+  // Counts fall into progressively fewer higher resgrades
+  aux_cdf_.resize(num_aux_);
+  double total = 0.0;
+  for (uint32_t aux = 0; aux < num_aux_; aux++){
+    total += pow(0.6, (double)aux);
+    aux_cdf_[aux] = total;
+  }
+  for (uint32_t aux = 0; aux < num_aux_; aux++){
+    aux_cdf_[aux] /= total;
+  }
+
+  valid_ = true;
+  abort_ = false;
+  for (uint32_t index = 0; index < num_threads_; index++){
+    threads_.push_back(new boost::thread(&XspressSimulatedData::generate_task, this, index));
+  }
+}
+
+uint32_t XspressSimulatedData::get_num_eng()
+{
+  return num_eng_;
+}
+
+uint32_t XspressSimulatedData::get_num_aux()
+{
+  return num_aux_;
+}
+
+uint32_t XspressSimulatedData::get_num_channels()
+{
+  return num_channels_;
+}
+
+/** Return the spectrum for a frame and channel, waiting for it to be
+ * generated if necessary.
+ *
+ * \param[in] frame - frame number.
+ * \param[in] channel - channel number.
+ * \return pointer to num_aux planes of num_eng bins.
+ */
+uint32_t *XspressSimulatedData::spectrum(uint32_t frame, uint32_t channel)
+{
+  uint32_t slot = frame % slots_;
+  wait_for_slot(slot);
+  return &spectra_[(((size_t)slot * num_channels_) + channel) * num_eng_ * num_aux_];
+}
+
+/** Return the scalars for a frame and channel, waiting for them to be
+ * generated if necessary.
+ *
+ * \param[in] frame - frame number.
+ * \param[in] channel - channel number.
+ * \return pointer to SIM_NUM_SCALARS values.
+ */
+const uint32_t *XspressSimulatedData::scalars(uint32_t frame, uint32_t channel)
+{
+  uint32_t slot = frame % slots_;
+  wait_for_slot(slot);
+  return &scalars_[(((size_t)slot * num_channels_) + channel) * SIM_NUM_SCALARS];
+}
+
+void XspressSimulatedData::stop()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(ready_mutex_);
+    abort_ = true;
+    ready_cond_.notify_all();
+  }
+  std::vector<boost::thread *>::iterator iter;
+  for (iter = threads_.begin(); iter != threads_.end(); ++iter){
+    (*iter)->join();
+    delete (*iter);
+  }
+  threads_.clear();
+}
+
+void XspressSimulatedData::wait_for_slot(uint32_t slot)
+{
+  if (!ready_[slot]){
+    boost::unique_lock<boost::mutex> lock(ready_mutex_);
+    while (!ready_[slot] && !abort_){
+      ready_cond_.wait(lock);
+    }
+  }
+}
+
+void XspressSimulatedData::generate_task(uint32_t thread_index)
+{
+  boost::random::mt19937 rng;
+  for (uint32_t slot = thread_index; slot < slots_ && !abort_; slot += num_threads_){
+    generate_slot(slot, rng);
+    boost::lock_guard<boost::mutex> lock(ready_mutex_);
+    ready_[slot] = true;
+    ready_cond_.notify_all();
+  }
+  LOG4CXX_DEBUG_LEVEL(2, logger_, "[SIM] Generator thread " << thread_index << " complete");
+}
+
+/** Generate the spectra and scalars for every channel of a single slot.
+ *
+ * Counts are sampled event by event at low rates and bin by bin at high
+ * rates, which are statistically equivalent for Poisson counting.  Events
+ * lost to resets and pileup are reflected in the scalars so that the dead
+ * time correction recovers the configured count rate.
+ */
+void XspressSimulatedData::generate_slot(uint32_t slot, boost::random::mt19937& rng)
+{
+  rng.seed(SIM_SEED + slot);
+  boost::random::uniform_01<double> uniform;
+  uint32_t plane_bins = num_eng_ * num_aux_;
+  double pileup_prob = 1.0 - exp(-count_rate_ * SIM_PILEUP_TIME);
+  double good_mean = count_rate_ * exposure_time_ * (1.0 - SIM_RESET_FRACTION) * (1.0 - pileup_prob);
+  double window_scale = (double)num_eng_ / 4096.0;
+
+  for (uint32_t channel = 0; channel < num_channels_; channel++){
+    uint32_t *spectrum = &spectra_[(((size_t)slot * num_channels_) + channel) * plane_bins];
+    uint32_t *scalars = &scalars_[(((size_t)slot * num_channels_) + channel) * SIM_NUM_SCALARS];
+    const std::vector<double>& cdf = shape_cdf_[channel];
+    memset(spectrum, 0, plane_bins * sizeof(uint32_t));
+
+    uint32_t all_good = 0;
+    if (good_mean <= 0.0){
+      // No counts
+    } else if (good_mean < plane_bins){
+      boost::random::poisson_distribution<uint32_t, double> events(good_mean);
+      all_good = events(rng);
+      for (uint32_t event = 0; event < all_good; event++){
+        uint32_t bin = std::upper_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        uint32_t aux = std::upper_bound(aux_cdf_.begin(), aux_cdf_.end(), uniform(rng)) - aux_cdf_.begin();
+        spectrum[(std::min(aux, num_aux_ - 1) * num_eng_) + std::min(bin, num_eng_ - 1)]++;
+      }
+    } else {
+      double prev_aux = 0.0;
+      for (uint32_t aux = 0; aux < num_aux_; aux++){
+        double aux_mean = good_mean * (aux_cdf_[aux] - prev_aux);
+        prev_aux = aux_cdf_[aux];
+        double prev_bin = 0.0;
+        for (uint32_t bin = 0; bin < num_eng_; bin++){
+          double mean = aux_mean * (cdf[bin] - prev_bin);
+          prev_bin = cdf[bin];
+          if (mean > 0.0){
+            boost::random::poisson_distribution<uint32_t, double> counts(mean);
+            uint32_t value = counts(rng);
+            spectrum[(aux * num_eng_) + bin] = value;
+            all_good += value;
+          }
+        }
+      }
+    }
+
+    uint32_t pileup = 0;
+    if (all_good > 0 && pileup_prob > 0.0){
+      boost::random::poisson_distribution<uint32_t, double> pileup_dist(all_good * pileup_prob / (1.0 - pileup_prob));
+      pileup = pileup_dist(rng);
+    }
+    uint32_t all_event = all_good + pileup;
+    uint32_t ticks = (uint32_t)(exposure_time_ / SIM_CLOCK_PERIOD + 0.5);
+
+    // Sum the counts falling into each SCA window
+    uint32_t in_window[2] = {0, 0};
+    if (channel < windows_.size()){
+      uint32_t low[2] = {windows_[channel].window0_low, windows_[channel].window1_low};
+      uint32_t high[2] = {windows_[channel].window0_high, windows_[channel].window1_high};
+      for (int window = 0; window < 2; window++){
+        uint32_t first = (uint32_t)(low[window] * window_scale);
+        uint32_t last = std::min((uint32_t)(high[window] * window_scale), num_eng_ - 1);
+        for (uint32_t aux = 0; aux < num_aux_; aux++){
+          for (uint32_t bin = first; bin <= last && high[window] > 0; bin++){
+            in_window[window] += spectrum[(aux * num_eng_) + bin];
+          }
+        }
+      }
+    }
+
+    scalars[SIM_SCALAR_TIME] = ticks;
+    scalars[SIM_SCALAR_RESET_TICKS] = (uint32_t)(ticks * SIM_RESET_FRACTION);
+    scalars[SIM_SCALAR_RESET_COUNT] = all_event / SIM_EVENTS_PER_RESET + 1;
+    scalars[SIM_SCALAR_ALL_EVENT] = all_event;
+    scalars[SIM_SCALAR_ALL_GOOD] = all_good;
+    scalars[SIM_SCALAR_IN_WINDOW0] = in_window[0];
+    scalars[SIM_SCALAR_IN_WINDOW1] = in_window[1];
+    scalars[SIM_SCALAR_PILEUP] = pileup;
+    scalars[SIM_SCALAR_TOTAL_TICKS] = ticks;
+  }
+}
+
+/** Build the cumulative energy distribution for a channel.
+ *
+ * Each channel has a slightly different gain so that the channels are not
+ * identical.
+ *
+ * \param[in] channel - channel number.
+ * \param[out] cdf - cumulative distribution over the energy bins.
+ */
+void XspressSimulatedData::build_shape(uint32_t channel, std::vector<double>& cdf)
+{
+  std::vector<double> pdf(num_eng_, 0.0);
+  double bin_ev = SIM_FULL_SCALE_EV / num_eng_;
+  double gain = 1.0 + 0.002 * ((int)(channel % 5) - 2);
+
+  double line_total = 0.0;
+  for (int line = 0; line < SIM_NUM_LINES; line++){
+    line_total += SIM_LINES[line].intensity;
+  }
+  for (int line = 0; line < SIM_NUM_LINES; line++){
+    double centre = SIM_LINES[line].energy * gain;
+    double fwhm = sim_fwhm(centre);
+    double sigma = sqrt((fwhm / 2.3548) * (fwhm / 2.3548) + SIM_LINES[line].width * SIM_LINES[line].width);
+    double weight = (1.0 - SIM_BACKGROUND) * SIM_LINES[line].intensity / line_total;
+    int first = std::max(0, (int)((centre - 5.0 * sigma) / bin_ev));
+    int last = std::min((int)num_eng_ - 1, (int)((centre + 5.0 * sigma) / bin_ev));
+    double norm = bin_ev / (sigma * sqrt(2.0 * M_PI));
+    for (int bin = first; bin <= last; bin++){
+      double delta = ((bin + 0.5) * bin_ev - centre) / sigma;
+      pdf[bin] += weight * norm * exp(-0.5 * delta * delta);
+    }
+  }
+
+  // Scattering background falling away up to the elastic peak, with a low
+  // energy noise threshold
+  double background_total = 0.0;
+  std::vector<double> background(num_eng_, 0.0);
+  for (uint32_t bin = 0; bin < num_eng_; bin++){
+    double energy = (bin + 0.5) * bin_ev;
+    if (energy > 500.0 && energy < 15500.0 * gain){
+      background[bin] = 0.2 + exp(-energy / 3000.0);
+      background_total += background[bin];
+    }
+  }
+  for (uint32_t bin = 0; bin < num_eng_ && background_total > 0.0; bin++){
+    pdf[bin] += SIM_BACKGROUND * background[bin] / background_total;
+  }
+
+  cdf.resize(num_eng_);
+  double total = 0.0;
+  for (uint32_t bin = 0; bin < num_eng_; bin++){
+    total += pdf[bin];
+    cdf[bin] = total;
+  }
+  for (uint32_t bin = 0; bin < num_eng_ && total > 0.0; bin++){
+    cdf[bin] /= total;
+  }
+}
+
+} /* namespace Xspress */
@@ -73,6 +73,8 @@ namespace FrameProcessor
     // Plugin interface
     void status(OdinData::IpcMessage& status);
     void process_frame(boost::shared_ptr <Frame> frame);
+    void process_channel_frame(char *frame_bytes, Xspress::ListFrameHeader *header);
+    void record_packet_header(std::vector<uint32_t>& hdr, uint64_t header_word);
 
     uint32_t frame_count_;
     uint32_t frame_size_bytes_;
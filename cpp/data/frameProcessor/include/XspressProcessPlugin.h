@@ -10,11 +10,27 @@
 using namespace log4cxx;
 using namespace log4cxx::helpers;
 
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+
 #include "FrameProcessorPlugin.h"
+#include "DataBlockFrame.h"
 #include "XspressDefinitions.h"
 
+// Flags for the in-stream dead time correction (dtc/flags)
+#define XSP_DTC_CORRECTED_MCA   0x1   // Write dead time corrected spectra as mca_N_corrected
+#define XSP_DTC_CORRECTED_FLOAT 0x2   // Write the corrected spectra as float32 rather than rounded uint32
+#define XSP_DTC_MAX_FACTOR      1.0e6 // Largest dead time correction factor applied to the spectra
+
 namespace FrameProcessor {
 
+/**
+ * Memory block holding a chunk of spectra for a single channel.
+ *
+ * The spectra are copied straight into a DataBlockFrame, which is handed on
+ * by pointer once the block is full and replaced by a new frame taken from the
+ * odin-data block pool, so each spectrum is only copied once.
+ */
 class XspressMemoryBlock
 {
 public:
@@ -25,19 +41,25 @@ public:
   void reallocate();
   void reset();
   void add_frame(uint32_t frame_id, char *ptr);
+  char *claim_frame(uint32_t frame_id);
+  void clear_unfilled();
   bool check_full();
   uint32_t frames();
   uint32_t size();
   uint32_t current_byte_size();
   char *get_data_ptr();
+  boost::shared_ptr<Frame> take_frame(const FrameMetaData& meta_data);
 
 private:
+  boost::shared_ptr<DataBlockFrame> frame_;
   char *ptr_;
   uint32_t num_bytes_;
   uint32_t filled_size_;
   uint32_t frames_;
   uint32_t max_frames_;
   uint32_t frame_size_;
+  /** Slots of the block that have been claimed since the last reset */
+  std::vector<bool> filled_;
 
   /** Pointer to logger */
   LoggerPtr logger_;
@@ -71,11 +93,53 @@ private:
         void set_number_of_channels(uint32_t num_channels);
         void set_number_of_aux(uint32_t num_aux);
         void setup_memory_allocation();
+        void update_meta_header();
         
         // Plugin interface
         void process_frame(boost::shared_ptr <Frame> frame);
 
+        void process_mca_frame(uint32_t frame_id,
+                               FrameHeader *header,
+                               uint32_t *sca_ptr,
+                               double *dtc_ptr,
+                               double *inp_est_ptr,
+                               char *mca_ptr);
+
+        void process_live_view(uint32_t frame_id,
+                               FrameHeader *header,
+                               char *mca_ptr,
+                               boost::posix_time::ptime now);
+        void process_channel(uint32_t index,
+                             uint32_t first_frame_id,
+                             FrameHeader *header,
+                             double *dtc_ptr,
+                             char *mca_ptr);
+        void process_dtc_correction(uint32_t index,
+                                    FrameHeader *header,
+                                    uint32_t frame_id,
+                                    double dtc_factor,
+                                    uint32_t *spectra);
+        bool reduction_enabled();
+        uint32_t output_bins(uint32_t num_bins);
+        uint32_t output_aux(uint32_t num_aux);
+        void reduce_spectra(FrameHeader *header, uint32_t *spectra, uint32_t *reduced);
+        void queue_channel_block(uint32_t index,
+                                 uint32_t frame_id,
+                                 FrameHeader *header,
+                                 boost::shared_ptr<XspressMemoryBlock> block,
+                                 const std::string& name,
+                                 DataType data_type);
+        void process_reductions(uint32_t index, FrameHeader *header, uint32_t frame, uint32_t *spectra);
+        void process_channel_work();
+        void process_channels(uint32_t first_frame_id, FrameHeader *header, double *dtc_ptr, char *mca_ptr);
+        void publish_reductions(uint32_t first_frame_id, FrameHeader *header);
+        void worker_task(uint64_t generation);
+        void set_worker_threads(uint32_t num_threads);
+        void stop_workers();
+
         void send_scalars(uint32_t last_frame_id, uint32_t num_scalars, uint32_t first_channel, uint32_t num_channels);
+        void send_rois(uint32_t last_frame_id, uint32_t first_channel, uint32_t num_channels);
+        void send_sum_spectra(uint32_t first_channel, uint32_t num_channels, uint32_t num_bins);
 
         uint32_t num_frames_;
         uint32_t num_energy_bins_;
@@ -87,18 +151,84 @@ private:
         uint32_t concurrent_rank_;
         std::string acq_id_;
         std::string live_view_name_;
+        /** Push one live view frame in every live_view_frequency_ frames */
+        uint32_t live_view_frequency_;
+        /** Minimum time between live view frames (ms), overrides the frequency when non-zero */
+        uint32_t live_view_period_;
+        /** Sum the frames in each live view window */
+        bool live_view_sum_;
+        /** Sum the aux planes of the live view into one */
+        bool live_view_collapse_aux_;
+        /** Frames in the current live view window and the time the last live view frame was pushed */
+        uint32_t live_view_frames_;
+        boost::posix_time::ptime live_view_last_time_;
+        /** Summed spectra for the current live view window */
+        std::vector<uint32_t> live_view_accumulator_;
 
         /** Time the last scalar message was sent */
         boost::posix_time::ptime last_scalar_send_time_;
-        /** Memory block for scalars */
-        void *scalar_memblock_;
-        void *dtc_memblock_;
-        void *inp_est_memblock_;
+        /** Meta data header, the same for every meta data block of an acquisition */
+        std::string meta_header_;
+        /** Meta data block, a MetaHeader followed by the scalars, DTC factors and input estimates of each frame */
+        std::vector<char> meta_memblock_;
         /** Number of scalars recorded */
         uint32_t num_scalars_recorded_;
 
+        /** Energy bin ROIs, counts are taken from bins [low, high) summed over the aux planes */
+        std::vector<uint32_t> roi_low_;
+        std::vector<uint32_t> roi_high_;
+        /** ROI counts for each frame of the current message [frame][channel][roi] */
+        std::vector<uint32_t> roi_message_counts_;
+        /** ROI counts waiting to be published, a MetaHeader followed by [frame][channel][roi] */
+        std::vector<char> roi_memblock_;
+        /** Number of frames of ROI counts recorded */
+        uint32_t num_rois_recorded_;
+        /** Accumulate the sum spectrum of each channel over the acquisition */
+        bool sum_spectra_;
+        /** Sum spectra summed over the aux planes [channel][bin] */
+        std::vector<uint64_t> sum_spectra_accumulator_;
+
 
         std::vector<boost::shared_ptr<XspressMemoryBlock> > memory_ptrs_;
+        /** Memory blocks for the dead time corrected spectra of each channel */
+        std::vector<boost::shared_ptr<XspressMemoryBlock> > corrected_memory_ptrs_;
+        /** Dead time correction flags, see XSP_DTC_CORRECTED_MCA */
+        uint32_t dtc_flags_;
+        /** Number of energy bins summed into each stored bin */
+        uint32_t rebin_factor_;
+        /** Energy bin window [low, high) stored, a high bin of 0 keeps every bin from the low bin */
+        uint32_t rebin_low_;
+        uint32_t rebin_high_;
+        /** Aux plane stored, -1 stores every plane */
+        int32_t aux_select_;
+        /** Sum the aux planes into a single stored plane */
+        bool aux_sum_;
+        /** Completed blocks waiting to be pushed for each channel */
+        std::vector<std::vector<boost::shared_ptr<Frame> > > channel_frames_;
+
+        /** Worker threads sharing the channels of each message with the plugin thread */
+        std::vector<boost::thread *> workers_;
+        uint32_t num_worker_threads_;
+        /** Held while a message is processed or the workers are changed */
+        boost::mutex workers_mutex_;
+        /** Mutex and conditions used to dispatch messages to the workers */
+        boost::mutex work_mutex_;
+        boost::condition_variable work_cond_;
+        boost::condition_variable done_cond_;
+        /** Incremented each time a message is dispatched */
+        uint64_t work_generation_;
+        /** Message currently being processed */
+        uint32_t work_frame_id_;
+        FrameHeader *work_header_;
+        double *work_dtc_ptr_;
+        char *work_mca_ptr_;
+        uint32_t work_num_channels_;
+        /** Next channel of the message to be claimed */
+        boost::atomic<uint32_t> next_channel_;
+        /** Number of workers still processing the message */
+        uint32_t pending_workers_;
+        /** Set to stop the worker threads */
+        bool workers_stop_;
 
         /** Configuration constant for the acquisition ID used for meta data writing */
         static const std::string CONFIG_ACQ_ID;
@@ -108,6 +238,10 @@ private:
         static const std::string CONFIG_PROCESS_RANK;
 
         static const std::string CONFIG_LIVE_VIEW_NAME;
+        static const std::string CONFIG_LIVE_VIEW_FREQUENCY;
+        static const std::string CONFIG_LIVE_VIEW_PERIOD;
+        static const std::string CONFIG_LIVE_VIEW_SUM;
+        static const std::string CONFIG_LIVE_VIEW_COLLAPSE_AUX;
 
         static const std::string CONFIG_FRAMES;
 
@@ -116,6 +250,17 @@ private:
         
         static const std::string CONFIG_CHUNK;
 
+        static const std::string CONFIG_THREADS;
+
+        static const std::string CONFIG_ROIS;
+        static const std::string CONFIG_SUM_SPECTRA;
+
+        static const std::string CONFIG_REBIN_FACTOR;
+        static const std::string CONFIG_REBIN_LOW;
+        static const std::string CONFIG_REBIN_HIGH;
+        static const std::string CONFIG_AUX_SELECT;
+        static const std::string CONFIG_AUX_SUM;
+
         /** Pointer to logger */
         LoggerPtr logger_;
     };
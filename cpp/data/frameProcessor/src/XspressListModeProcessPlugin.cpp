@@ -321,6 +321,12 @@ void XspressListModeProcessPlugin::process_frame(boost::shared_ptr <Frame> frame
 
   LOG4CXX_DEBUG_LEVEL(2, logger_, "Received frame with " << header->packets_received << " packets");
 
+  if (header->channel != XSP_LIST_MIXED_CHANNELS){
+    // Every packet of the frame is from the same channel
+    process_channel_frame(frame_bytes, header);
+    return;
+  }
+
   for (int packet_index = 0; packet_index < header->packets_received; packet_index++){
 
     char *data_ptr = frame_bytes + sizeof(Xspress::ListFrameHeader) + (packet_index * Xspress::xspress_packet_size);
@@ -340,10 +346,7 @@ void XspressListModeProcessPlugin::process_frame(boost::shared_ptr <Frame> frame
     << " CHAN: " << std::dec << XSP3_HGT64_SOF_GET_CHAN(peek_ptr[0]));
 
     if (packet_headers_.count(channel) > 0){
-      packet_headers_[channel].clear();
-      packet_headers_[channel].push_back(XSP3_HGT64_SOF_GET_FRAME(peek_ptr[0]));
-      packet_headers_[channel].push_back(XSP3_HGT64_SOF_GET_PREV_TIME(peek_ptr[0]));
-      packet_headers_[channel].push_back(XSP3_HGT64_SOF_GET_CHAN(peek_ptr[0]));
+      record_packet_header(packet_headers_[channel], peek_ptr[0]);
 
       // Place the bytes into the store
       boost::shared_ptr <Frame> list_frame = (memory_ptrs_[channel])->add_block(pkt_size, data_ptr);
@@ -364,4 +367,53 @@ void XspressListModeProcessPlugin::process_frame(boost::shared_ptr <Frame> frame
   }
 }
 
+/**
+ * Process a frame assembled by the frame receiver from the packets of a
+ * single channel.  The memory block of the channel is looked up once and
+ * every packet is appended to it in order.
+ *
+ * \param[in] frame_bytes - pointer to the frame header followed by the packet slots.
+ * \param[in] header - frame header.
+ */
+void XspressListModeProcessPlugin::process_channel_frame(char *frame_bytes, Xspress::ListFrameHeader *header)
+{
+  uint32_t channel = header->channel;
+  std::map<uint32_t, boost::shared_ptr<XspressListModeMemoryBlock> >::iterator block = memory_ptrs_.find(channel);
+  if (block == memory_ptrs_.end()){
+    LOG4CXX_ERROR(logger_, "Bad channel, this plugin is not set up for channel " << channel);
+    return;
+  }
+
+  char *data_ptr = frame_bytes + sizeof(Xspress::ListFrameHeader);
+  for (uint32_t packet_index = 0; packet_index < header->packets_received; packet_index++){
+    boost::shared_ptr <Frame> list_frame = block->second->add_block(header->packet_headers[packet_index].packet_size, data_ptr);
+    if (list_frame){
+      LOG4CXX_DEBUG_LEVEL(1, logger_, "Completed frame for channel " << channel << ", pushing");
+      this->push(list_frame);
+    }
+    data_ptr += Xspress::xspress_packet_size;
+  }
+
+  if (header->packets_received > 0){
+    // Record the header of the last packet for status reporting
+    uint64_t *peek_ptr = (uint64_t *)(data_ptr - Xspress::xspress_packet_size);
+    record_packet_header(packet_headers_[channel], peek_ptr[0]);
+    if ((XSP3_HGT64_MASK_END_OF_FRAME&peek_ptr[0]) == XSP3_HGT64_MASK_END_OF_FRAME){
+      LOG4CXX_DEBUG_LEVEL(1, logger_, " Ch: " << channel << " EOF marker registered");
+    }
+  }
+}
+
+/**
+ * Store the time frame, previous frame time and channel of a packet header
+ * word for status reporting.
+ */
+void XspressListModeProcessPlugin::record_packet_header(std::vector<uint32_t>& hdr, uint64_t header_word)
+{
+  hdr.clear();
+  hdr.push_back(XSP3_HGT64_SOF_GET_FRAME(header_word));
+  hdr.push_back(XSP3_HGT64_SOF_GET_PREV_TIME(header_word));
+  hdr.push_back(XSP3_HGT64_SOF_GET_CHAN(header_word));
+}
+
 }
@@ -3,6 +3,7 @@
 //
 #include <iostream>
 #include <string>
+#include <cmath>
 #include "DataBlockFrame.h"
 #include "XspressProcessPlugin.h"
 #include "FrameProcessorDefinitions.h"
@@ -10,7 +11,6 @@
 #include "DebugLevelLogger.h"
 
 #define MAX_SCALAR_MEM_BLOCK_SIZE 4096
-#define DEFAULT_SCALAR_QTY 9
 #define SCALAR_POST_TIME_MS 1000
 
 namespace FrameProcessor {
@@ -22,6 +22,10 @@ const std::string XspressProcessPlugin::CONFIG_PROCESS_NUMBER       = "number";
 const std::string XspressProcessPlugin::CONFIG_PROCESS_RANK         = "rank";
 
 const std::string XspressProcessPlugin::CONFIG_LIVE_VIEW_NAME       = "live_view";
+const std::string XspressProcessPlugin::CONFIG_LIVE_VIEW_FREQUENCY  = "live_view_frequency";
+const std::string XspressProcessPlugin::CONFIG_LIVE_VIEW_PERIOD     = "live_view_period";
+const std::string XspressProcessPlugin::CONFIG_LIVE_VIEW_SUM        = "live_view_sum";
+const std::string XspressProcessPlugin::CONFIG_LIVE_VIEW_COLLAPSE_AUX = "live_view_collapse_aux";
 
 const std::string XspressProcessPlugin::CONFIG_FRAMES               = "frames";
 const std::string XspressProcessPlugin::CONFIG_DTC_FLAGS            = "dtc/flags";
@@ -29,11 +33,22 @@ const std::string XspressProcessPlugin::CONFIG_DTC_PARAMS           = "dtc/param
 
 const std::string XspressProcessPlugin::CONFIG_CHUNK                = "chunks";
 
+const std::string XspressProcessPlugin::CONFIG_THREADS              = "threads";
+
+const std::string XspressProcessPlugin::CONFIG_ROIS                 = "rois";
+const std::string XspressProcessPlugin::CONFIG_SUM_SPECTRA          = "sum_spectra";
+
+const std::string XspressProcessPlugin::CONFIG_REBIN_FACTOR         = "rebin/factor";
+const std::string XspressProcessPlugin::CONFIG_REBIN_LOW            = "rebin/low";
+const std::string XspressProcessPlugin::CONFIG_REBIN_HIGH           = "rebin/high";
+const std::string XspressProcessPlugin::CONFIG_AUX_SELECT           = "aux/select";
+const std::string XspressProcessPlugin::CONFIG_AUX_SUM              = "aux/sum";
+
 const std::string META_NAME = "xspress";
 const std::string META_XSPRESS_CHUNK = "xspress_meta_chunk";
-const std::string META_XSPRESS_SCALARS = "xspress_scalars";
-const std::string META_XSPRESS_DTC = "xspress_dtc";
-const std::string META_XSPRESS_INP_EST = "xspress_inp_est";
+const std::string META_XSPRESS_BLOCK = "xspress_meta_block";
+const std::string META_XSPRESS_ROI = "xspress_roi";
+const std::string META_XSPRESS_SUM = "xspress_sum";
 
 XspressMemoryBlock::XspressMemoryBlock() :
   ptr_(0),
@@ -50,9 +65,6 @@ XspressMemoryBlock::XspressMemoryBlock() :
 
 XspressMemoryBlock::~XspressMemoryBlock()
 {
-  if (ptr_){
-    free(ptr_);
-  }
 }
 
 void XspressMemoryBlock::set_size(uint32_t frame_size, uint32_t max_frames)
@@ -65,32 +77,67 @@ void XspressMemoryBlock::set_size(uint32_t frame_size, uint32_t max_frames)
 
 void XspressMemoryBlock::reallocate()
 {
-  LOG4CXX_INFO(logger_, "Reallocating XspressMemoryBlock to [" << num_bytes_ << "] bytes");
-  if (ptr_){
-    free(ptr_);
+  LOG4CXX_DEBUG_LEVEL(3, logger_, "Allocating XspressMemoryBlock frame of [" << num_bytes_ << "] bytes");
+  // The frame memory is taken from the odin-data block pool, so once the pool
+  // is warm this does not allocate.  The memory is recycled and may hold spectra
+  // from an earlier block, so any slot that is not filled by add_frame or
+  // claim_frame is cleared by clear_unfilled before the block is handed on.
+  if (num_bytes_ > 0){
+    frame_ = boost::shared_ptr<DataBlockFrame>(new DataBlockFrame(FrameMetaData(), num_bytes_));
+    ptr_ = static_cast<char *>(frame_->get_data_ptr());
+  } else {
+    frame_.reset();
+    ptr_ = 0;
   }
-  ptr_ = (char *)malloc(num_bytes_);
   reset();
 }
 
 void XspressMemoryBlock::reset()
 {
-  memset(ptr_, 0, num_bytes_);
   frames_ = 0;
   filled_size_ = 0;
+  filled_.assign(max_frames_, false);
 }
 
 void XspressMemoryBlock::add_frame(uint32_t frame_id, char *ptr)
 {
 //  LOG4CXX_INFO(logger_, "Adding frame [" << frame_id << "] to XspressMemoryBlock");
+  memcpy(claim_frame(frame_id), ptr, frame_size_);
+//  LOG4CXX_INFO(logger_, "Frames [" << frames_ << " / " << max_frames_ << "]");
+}
+
+/**
+ * Claim the space for a frame in the block so that it can be filled in place.
+ *
+ * \param[in] frame_id - frame number.
+ * \return pointer to the space for the frame.
+ */
+char *XspressMemoryBlock::claim_frame(uint32_t frame_id)
+{
   // Work out the pointer offset
   uint32_t frame_offset = frame_id % max_frames_;
   char *dest = ptr_;
   dest += (frame_offset * frame_size_);
-  memcpy(dest, ptr, frame_size_);
   frames_ += 1;
   filled_size_ = (frame_offset+1) * frame_size_;
-//  LOG4CXX_INFO(logger_, "Frames [" << frames_ << " / " << max_frames_ << "]");
+  filled_[frame_offset] = true;
+  return dest;
+}
+
+/**
+ * Zero the slots of the block that have not been filled, for example where
+ * frames are missing, so they do not hold stale spectra from an earlier block.
+ */
+void XspressMemoryBlock::clear_unfilled()
+{
+  if (!ptr_){
+    return;
+  }
+  for (uint32_t frame_offset = 0; frame_offset < max_frames_; frame_offset++){
+    if (!filled_[frame_offset]){
+      memset(ptr_ + (frame_offset * frame_size_), 0, frame_size_);
+    }
+  }
 }
 
 bool XspressMemoryBlock::check_full()
@@ -123,6 +170,21 @@ char *XspressMemoryBlock::get_data_ptr()
   return ptr_;
 }
 
+/**
+ * Hand on the full block of spectra and start filling a new one.
+ *
+ * \param[in] meta_data - meta data describing the block.
+ * \return the frame holding the block of spectra.
+ */
+boost::shared_ptr<Frame> XspressMemoryBlock::take_frame(const FrameMetaData& meta_data)
+{
+  boost::shared_ptr<Frame> frame = frame_;
+  clear_unfilled();
+  frame->set_meta_data(meta_data);
+  reallocate();
+  return frame;
+}
+
 XspressProcessPlugin::XspressProcessPlugin() :
   num_frames_(1),
   num_energy_bins_(4096),
@@ -134,20 +196,44 @@ XspressProcessPlugin::XspressProcessPlugin() :
   concurrent_rank_(0),
   acq_id_(""),
   live_view_name_(""),
+  live_view_frequency_(1),
+  live_view_period_(0),
+  live_view_sum_(false),
+  live_view_collapse_aux_(false),
+  live_view_frames_(0),
+  live_view_last_time_(boost::posix_time::min_date_time),
   last_scalar_send_time_(boost::posix_time::min_date_time),
-  scalar_memblock_(0),
-  dtc_memblock_(0),
-  inp_est_memblock_(0),
-  num_scalars_recorded_(0)
+  num_scalars_recorded_(0),
+  num_rois_recorded_(0),
+  sum_spectra_(false),
+  dtc_flags_(0),
+  rebin_factor_(1),
+  rebin_low_(0),
+  rebin_high_(0),
+  aux_select_(-1),
+  aux_sum_(false),
+  num_worker_threads_(0),
+  work_generation_(0),
+  work_frame_id_(0),
+  work_header_(0),
+  work_dtc_ptr_(0),
+  work_mca_ptr_(0),
+  work_num_channels_(0),
+  next_channel_(0),
+  pending_workers_(0),
+  workers_stop_(false)
 {
   // Setup logging for the class
   logger_ = Logger::getLogger("FP.XspressProcessPlugin");
   LOG4CXX_INFO(logger_, "XspressProcessPlugin version " << this->get_version_long() << " loaded");
+  update_meta_header();
 }
 
 XspressProcessPlugin::~XspressProcessPlugin()
 {
   LOG4CXX_TRACE(logger_, "XspressProcessPlugin destructor.");
+  boost::lock_guard<boost::mutex> lock(workers_mutex_);
+  stop_workers();
 }
 
 void XspressProcessPlugin::configure(OdinData::IpcMessage& config, OdinData::IpcMessage& reply)
@@ -167,6 +253,102 @@ void XspressProcessPlugin::configure(OdinData::IpcMessage& config, OdinData::Ipc
   if (config.has_param(XspressProcessPlugin::CONFIG_ACQ_ID)) {
     this->acq_id_ = config.get_param<std::string>(XspressProcessPlugin::CONFIG_ACQ_ID);
     LOG4CXX_INFO(logger_, "Acquisition ID set to " << this->acq_id_);
+    update_meta_header();
+  }
+
+  // Check for the energy bin ROIs, given as a flat list of [low, high) bin pairs
+  if (config.has_param(XspressProcessPlugin::CONFIG_ROIS)) {
+    const rapidjson::Value& rois = config.get_param<const rapidjson::Value&>(XspressProcessPlugin::CONFIG_ROIS);
+    if (!rois.IsArray() || (rois.Size() % 2) != 0){
+      LOG4CXX_ERROR(logger_, "ROIs must be a list of low and high energy bin pairs");
+      reply.set_nack("ROIs must be a list of low and high energy bin pairs");
+    } else {
+      std::vector<uint32_t> roi_low;
+      std::vector<uint32_t> roi_high;
+      std::stringstream ss;
+      ss << "Configure energy bin ROIs [";
+      for (rapidjson::SizeType index = 0; index < rois.Size(); index += 2){
+        roi_low.push_back(rois[index].GetUint());
+        roi_high.push_back(rois[index + 1].GetUint());
+        if (roi_low.back() >= roi_high.back()){
+          ss << "] invalid, the low bin of each ROI must be below the high bin";
+          break;
+        }
+        ss << "[" << roi_low.back() << ", " << roi_high.back() << ")";
+        if (index + 2 < rois.Size()){
+          ss << ", ";
+        }
+      }
+      if (roi_low.size() == roi_high.size() && (roi_low.empty() || roi_low.back() < roi_high.back())){
+        ss << "]";
+        LOG4CXX_INFO(logger_, ss.str());
+        this->roi_low_ = roi_low;
+        this->roi_high_ = roi_high;
+        this->num_rois_recorded_ = 0;
+      } else {
+        LOG4CXX_ERROR(logger_, ss.str());
+        reply.set_nack(ss.str());
+      }
+    }
+  }
+
+  // Check for the dead time correction flags
+  if (config.has_param(XspressProcessPlugin::CONFIG_DTC_FLAGS)) {
+    uint32_t dtc_flags = config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_DTC_FLAGS);
+    if (dtc_flags != this->dtc_flags_){
+      this->dtc_flags_ = dtc_flags;
+      LOG4CXX_INFO(logger_, "Dead time correction flags set to " << this->dtc_flags_);
+      setup_memory_allocation();
+    }
+  }
+
+  // Check for the energy bin and aux plane reduction of the stored spectra
+  bool reduction_changed = false;
+  if (config.has_param(XspressProcessPlugin::CONFIG_REBIN_FACTOR)) {
+    this->rebin_factor_ = std::max(1u, config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_REBIN_FACTOR));
+    LOG4CXX_INFO(logger_, "Energy bin rebinning factor set to " << this->rebin_factor_);
+    reduction_changed = true;
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_REBIN_LOW)) {
+    this->rebin_low_ = config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_REBIN_LOW);
+    LOG4CXX_INFO(logger_, "Energy bin window low bin set to " << this->rebin_low_);
+    reduction_changed = true;
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_REBIN_HIGH)) {
+    this->rebin_high_ = config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_REBIN_HIGH);
+    LOG4CXX_INFO(logger_, "Energy bin window high bin set to " << this->rebin_high_);
+    reduction_changed = true;
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_AUX_SELECT)) {
+    this->aux_select_ = config.get_param<int32_t>(XspressProcessPlugin::CONFIG_AUX_SELECT);
+    LOG4CXX_INFO(logger_, "Aux plane selection set to " << this->aux_select_);
+    reduction_changed = true;
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_AUX_SUM)) {
+    this->aux_sum_ = config.get_param<bool>(XspressProcessPlugin::CONFIG_AUX_SUM);
+    LOG4CXX_INFO(logger_, "Aux plane summing set to " << this->aux_sum_);
+    reduction_changed = true;
+  }
+  if (reduction_changed){
+    if (this->rebin_high_ > 0 && this->rebin_high_ <= this->rebin_low_){
+      LOG4CXX_ERROR(logger_, "Energy bin window high bin must be above the low bin, storing every bin");
+      reply.set_nack("Energy bin window high bin must be above the low bin");
+      this->rebin_low_ = 0;
+      this->rebin_high_ = 0;
+    }
+    uint32_t high = (this->rebin_high_ > 0) ? std::min(this->rebin_high_, this->num_energy_bins_) : this->num_energy_bins_;
+    if (high > this->rebin_low_ && ((high - this->rebin_low_) % this->rebin_factor_) != 0){
+      LOG4CXX_WARN(logger_, "Energy bin window of " << (high - this->rebin_low_) << " bins is not a multiple of the rebinning factor, the last "
+                            << ((high - this->rebin_low_) % this->rebin_factor_) << " bins will not be stored");
+    }
+    LOG4CXX_INFO(logger_, "Storing " << output_aux(this->num_aux_) << " aux planes of " << output_bins(this->num_energy_bins_) << " energy bins");
+    setup_memory_allocation();
+  }
+
+  // Check for sum spectra accumulation
+  if (config.has_param(XspressProcessPlugin::CONFIG_SUM_SPECTRA)) {
+    this->sum_spectra_ = config.get_param<bool>(XspressProcessPlugin::CONFIG_SUM_SPECTRA);
+    LOG4CXX_INFO(logger_, "Sum spectra accumulation set to " << this->sum_spectra_);
   }
 
   /**
@@ -210,6 +392,19 @@ void XspressProcessPlugin::configure(OdinData::IpcMessage& config, OdinData::Ipc
     rapidjson::Value value_num_frames;
     value_num_frames.SetInt(num_frames_);
     meta_document.AddMember(key_num_frames, value_num_frames, meta_document.GetAllocator());
+    // Add the reductions so the meta writer can define their datasets
+    rapidjson::Value key_num_rois("number_of_rois", meta_document.GetAllocator());
+    rapidjson::Value value_num_rois;
+    value_num_rois.SetInt(roi_low_.size());
+    meta_document.AddMember(key_num_rois, value_num_rois, meta_document.GetAllocator());
+    rapidjson::Value key_sum_spectra("sum_spectra", meta_document.GetAllocator());
+    rapidjson::Value value_sum_spectra;
+    value_sum_spectra.SetBool(sum_spectra_);
+    meta_document.AddMember(key_sum_spectra, value_sum_spectra, meta_document.GetAllocator());
+    rapidjson::Value key_num_bins("number_of_bins", meta_document.GetAllocator());
+    rapidjson::Value value_num_bins;
+    value_num_bins.SetInt(num_energy_bins_);
+    meta_document.AddMember(key_num_bins, value_num_bins, meta_document.GetAllocator());
 
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -228,6 +423,30 @@ void XspressProcessPlugin::configure(OdinData::IpcMessage& config, OdinData::Ipc
     this->live_view_name_ = config.get_param<std::string>(XspressProcessPlugin::CONFIG_LIVE_VIEW_NAME);
     LOG4CXX_INFO(logger_, "Live View destination name set to " << this->live_view_name_);
   }
+
+  // Check for the live view decimation and reduction
+  if (config.has_param(XspressProcessPlugin::CONFIG_LIVE_VIEW_FREQUENCY)) {
+    this->live_view_frequency_ = std::max(1u, config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_LIVE_VIEW_FREQUENCY));
+    LOG4CXX_INFO(logger_, "Live View frequency set to 1 in " << this->live_view_frequency_ << " frames");
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_LIVE_VIEW_PERIOD)) {
+    this->live_view_period_ = config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_LIVE_VIEW_PERIOD);
+    LOG4CXX_INFO(logger_, "Live View period set to " << this->live_view_period_ << " ms");
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_LIVE_VIEW_SUM)) {
+    this->live_view_sum_ = config.get_param<bool>(XspressProcessPlugin::CONFIG_LIVE_VIEW_SUM);
+    LOG4CXX_INFO(logger_, "Live View summing set to " << this->live_view_sum_);
+  }
+  if (config.has_param(XspressProcessPlugin::CONFIG_LIVE_VIEW_COLLAPSE_AUX)) {
+    this->live_view_collapse_aux_ = config.get_param<bool>(XspressProcessPlugin::CONFIG_LIVE_VIEW_COLLAPSE_AUX);
+    LOG4CXX_INFO(logger_, "Live View aux collapsing set to " << this->live_view_collapse_aux_);
+  }
+
+  // Check for the number of channel worker threads
+  if (config.has_param(XspressProcessPlugin::CONFIG_THREADS)) {
+    uint32_t num_threads = config.get_param<uint32_t>(XspressProcessPlugin::CONFIG_THREADS);
+    this->set_worker_threads(num_threads);
+  }
 }
 
 void XspressProcessPlugin::requestConfiguration(OdinData::IpcMessage& reply)
@@ -241,6 +460,22 @@ void XspressProcessPlugin::requestConfiguration(OdinData::IpcMessage& reply)
                   XspressProcessPlugin::CONFIG_PROCESS_RANK, this->concurrent_rank_);
   reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_ACQ_ID, this->acq_id_);
   reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_LIVE_VIEW_NAME, this->live_view_name_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_LIVE_VIEW_FREQUENCY, this->live_view_frequency_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_LIVE_VIEW_PERIOD, this->live_view_period_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_LIVE_VIEW_SUM, this->live_view_sum_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_LIVE_VIEW_COLLAPSE_AUX, this->live_view_collapse_aux_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_THREADS, this->num_worker_threads_);
+  for (size_t index = 0; index < this->roi_low_.size(); index++){
+    reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_ROIS + "[]", this->roi_low_[index]);
+    reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_ROIS + "[]", this->roi_high_[index]);
+  }
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_SUM_SPECTRA, this->sum_spectra_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_DTC_FLAGS, this->dtc_flags_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_REBIN_FACTOR, this->rebin_factor_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_REBIN_LOW, this->rebin_low_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_REBIN_HIGH, this->rebin_high_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_AUX_SELECT, this->aux_select_);
+  reply.set_param(get_name() + "/" + XspressProcessPlugin::CONFIG_AUX_SUM, this->aux_sum_);
 }
 
 /**
@@ -264,9 +499,38 @@ void XspressProcessPlugin::configureProcess(OdinData::IpcMessage &config, OdinDa
   if (config.has_param(XspressProcessPlugin::CONFIG_PROCESS_RANK)) {
     this->concurrent_rank_ = config.get_param<size_t>(XspressProcessPlugin::CONFIG_PROCESS_RANK);
     LOG4CXX_INFO(logger_, "Process rank changed to " << this->concurrent_rank_);
+    update_meta_header();
   }
 }
 
+/**
+ * Build the JSON header published with every meta data block.  It only holds
+ * the values that are fixed for an acquisition, the values that change from
+ * block to block are held in the MetaHeader at the start of each block, so
+ * the header is only built when the configuration changes.
+ */
+void XspressProcessPlugin::update_meta_header()
+{
+  rapidjson::Document meta_document;
+  meta_document.SetObject();
+
+  // Add Acquisition ID
+  rapidjson::Value key_acq_id("acqID", meta_document.GetAllocator());
+  rapidjson::Value value_acq_id;
+  value_acq_id.SetString(acq_id_.c_str(), acq_id_.size(), meta_document.GetAllocator());
+  meta_document.AddMember(key_acq_id, value_acq_id, meta_document.GetAllocator());
+  // Add rank
+  rapidjson::Value key_rank("rank", meta_document.GetAllocator());
+  rapidjson::Value value_rank;
+  value_rank.SetInt(concurrent_rank_);
+  meta_document.AddMember(key_rank, value_rank, meta_document.GetAllocator());
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  meta_document.Accept(writer);
+  meta_header_ = buffer.GetString();
+}
+
 // Version functions
 int XspressProcessPlugin::get_version_major()
 {
@@ -314,27 +578,26 @@ void XspressProcessPlugin::setup_memory_allocation()
 
   // Allocate large enough blocks of memory to hold frames_per_block spectra
   // Allocate one block of memory for each channel
-  uint32_t frame_size = num_energy_bins_ * num_aux_ * sizeof(uint32_t);
+  // The blocks hold the spectra after any energy bin and aux plane reduction
+  uint32_t frame_size = output_bins(num_energy_bins_) * output_aux(num_aux_) * sizeof(uint32_t);
   LOG4CXX_DEBUG_LEVEL(3, logger_, "frames_per_block_ inside the setup_memory_allocation method: " << frames_per_block_);
   for (int index = 0; index <= num_channels_; index++){
     boost::shared_ptr<XspressMemoryBlock> ptr = boost::shared_ptr<XspressMemoryBlock>(new XspressMemoryBlock());
     ptr->set_size(frame_size, frames_per_block_);
     memory_ptrs_.push_back(ptr);
   }
-
-  // Init the scalar memory allocation
-  if (scalar_memblock_){
-    free(scalar_memblock_);
-  }
-  scalar_memblock_ = malloc(sizeof(uint32_t) * this->frames_per_block_ * num_channels_ * DEFAULT_SCALAR_QTY);
-  if (dtc_memblock_){
-    free(dtc_memblock_);
-  }
-  dtc_memblock_ = malloc(sizeof(double) * this->frames_per_block_ * num_channels_);
-  if (inp_est_memblock_){
-    free(inp_est_memblock_);
+  // The corrected spectra are the same size whether written as uint32 or float32
+  corrected_memory_ptrs_.clear();
+  if (dtc_flags_ & XSP_DTC_CORRECTED_MCA){
+    for (int index = 0; index < num_channels_; index++){
+      boost::shared_ptr<XspressMemoryBlock> ptr = boost::shared_ptr<XspressMemoryBlock>(new XspressMemoryBlock());
+      ptr->set_size(frame_size, frames_per_block_);
+      corrected_memory_ptrs_.push_back(ptr);
+    }
   }
-  inp_est_memblock_ = malloc(sizeof(double) * this->frames_per_block_ * num_channels_);
+  channel_frames_.clear();
+  channel_frames_.resize(num_channels_);
+  num_rois_recorded_ = 0;
 }
 
 void XspressProcessPlugin::process_frame(boost::shared_ptr <Frame> frame)
@@ -356,9 +619,13 @@ void XspressProcessPlugin::process_frame(boost::shared_ptr <Frame> frame)
     for (int index = 0; index < num_channels_; index++){
       memory_ptrs_[index]->reset();
     }
+    for (size_t index = 0; index < corrected_memory_ptrs_.size(); index++){
+      corrected_memory_ptrs_[index]->reset();
+    }
 
-    // Reset the number of scalars recorded to zero
+    // Reset the number of scalars and ROI counts recorded to zero
     num_scalars_recorded_ = 0;
+    num_rois_recorded_ = 0;
   }
 
   // Check the number of channels.  If the number of channels is different
@@ -373,6 +640,15 @@ void XspressProcessPlugin::process_frame(boost::shared_ptr <Frame> frame)
     set_number_of_aux(header->num_aux);
   }
 
+  // Clear the sum spectra at the start of an acquisition and size the ROI
+  // counts before any channels are processed
+  uint32_t num_sum_values = sum_spectra_ ? (num_channels_ * header->num_energy_bins) : 0;
+  if (frame_id == 0 || sum_spectra_accumulator_.size() != num_sum_values){
+    sum_spectra_accumulator_.assign(num_sum_values, 0);
+  }
+  roi_memblock_.resize(sizeof(MetaHeader) + (frames_per_block_ * num_channels_ * roi_low_.size() * sizeof(uint32_t)));
+  roi_message_counts_.resize(header->num_frames * num_channels_ * roi_low_.size());
+
   // If the frame number is greater than the current memory allocation clear out the memory
   // and update the starting block
 
@@ -383,28 +659,62 @@ void XspressProcessPlugin::process_frame(boost::shared_ptr <Frame> frame)
   uint32_t num_scalar_values = header->num_scalars * header->num_channels;
   uint32_t num_dtc_factors = header->num_channels;
   uint32_t num_inp_est = header->num_channels;
-  uint32_t first_channel_index = header->first_channel;
+  // The DAQ may send several consecutive frames in a single message, in which case
+  // each section of the message holds the values for every frame in turn
+  uint32_t num_message_frames = header->num_frames;
 
   char *raw_sca_ptr = frame_bytes;
   raw_sca_ptr += sizeof(FrameHeader);
   uint32_t *sca_ptr = (uint32_t *)raw_sca_ptr;
-  char *raw_dtc_ptr = frame_bytes;
-  raw_dtc_ptr += (sizeof(FrameHeader) + (num_scalar_values*sizeof(uint32_t)));
+  char *raw_dtc_ptr = raw_sca_ptr;
+  raw_dtc_ptr += (num_message_frames * num_scalar_values * sizeof(uint32_t));
   double *dtc_ptr = (double *)raw_dtc_ptr;
-  char *raw_inp_est_ptr = frame_bytes;
-  raw_inp_est_ptr += (sizeof(FrameHeader) + (num_scalar_values*sizeof(uint32_t)) + (num_dtc_factors*sizeof(double)));
+  char *raw_inp_est_ptr = raw_dtc_ptr;
+  raw_inp_est_ptr += (num_message_frames * num_dtc_factors * sizeof(double));
   double *inp_est_ptr = (double *)raw_inp_est_ptr;
+  char *mca_ptr = raw_inp_est_ptr;
+  mca_ptr += (num_message_frames * num_inp_est * sizeof(double));
+
+  char *frame_mca_ptr = mca_ptr;
+  for (uint32_t index = 0; index < num_message_frames; index++){
+    process_mca_frame(frame_id + index, header, sca_ptr, dtc_ptr, inp_est_ptr, frame_mca_ptr);
+    sca_ptr += num_scalar_values;
+    dtc_ptr += num_dtc_factors;
+    inp_est_ptr += num_inp_est;
+    frame_mca_ptr += (mca_size * header->num_channels);
+  }
+
+  // Add the spectra to the memory blocks, in parallel across channels if configured
+  process_channels(frame_id, header, (double *)raw_dtc_ptr, mca_ptr);
+}
 
-  // Memcpy the scalars into the correct memory location
-  uint32_t *dest_ptr = (uint32_t *)scalar_memblock_;
-  dest_ptr += (num_scalar_values * num_scalars_recorded_);
-  memcpy(dest_ptr, sca_ptr, num_scalar_values * sizeof(uint32_t));
-  double *dest_dtc_ptr = (double *)dtc_memblock_;
-  dest_dtc_ptr += (num_dtc_factors * num_scalars_recorded_);
-  memcpy(dest_dtc_ptr, dtc_ptr, num_dtc_factors * sizeof(double));
-  double *dest_inp_est_ptr = (double *)inp_est_memblock_;
-  dest_inp_est_ptr += (num_inp_est * num_scalars_recorded_);
-  memcpy(dest_inp_est_ptr, inp_est_ptr, num_inp_est * sizeof(double));
+void XspressProcessPlugin::process_mca_frame(uint32_t frame_id,
+                                             FrameHeader *header,
+                                             uint32_t *sca_ptr,
+                                             double *dtc_ptr,
+                                             double *inp_est_ptr,
+                                             char *mca_ptr)
+{
+  uint32_t num_scalar_values = header->num_scalars * header->num_channels;
+  uint32_t num_dtc_factors = header->num_channels;
+  uint32_t num_inp_est = header->num_channels;
+
+  // Memcpy the scalars, DTC factors and input estimates into the record for
+  // this frame in the meta data block
+  uint32_t scalar_bytes = num_scalar_values * sizeof(uint32_t);
+  uint32_t dtc_bytes = num_dtc_factors * sizeof(double);
+  uint32_t inp_est_bytes = num_inp_est * sizeof(double);
+  uint32_t record_bytes = scalar_bytes + dtc_bytes + inp_est_bytes;
+  uint32_t block_bytes = sizeof(MetaHeader) + (record_bytes * frames_per_block_);
+  if (meta_memblock_.size() != block_bytes){
+    meta_memblock_.resize(block_bytes);
+  }
+  char *dest_ptr = &meta_memblock_[sizeof(MetaHeader) + (record_bytes * num_scalars_recorded_)];
+  memcpy(dest_ptr, sca_ptr, scalar_bytes);
+  dest_ptr += scalar_bytes;
+  memcpy(dest_ptr, dtc_ptr, dtc_bytes);
+  dest_ptr += dtc_bytes;
+  memcpy(dest_ptr, inp_est_ptr, inp_est_bytes);
   num_scalars_recorded_ += 1;
 
   // Calculate the elapsed time since we last posted meta data
@@ -419,156 +729,677 @@ void XspressProcessPlugin::process_frame(boost::shared_ptr <Frame> frame)
     last_scalar_send_time_ = now;
   }
 
-  char *mca_ptr = frame_bytes;
-  mca_ptr += (sizeof(FrameHeader) +
-             (num_scalar_values*sizeof(uint32_t)) +
-             (num_dtc_factors*sizeof(double)) +
-             (num_inp_est*sizeof(double))
-             );
-
   // Create the live view frame and push it
+  process_live_view(frame_id, header, mca_ptr, now);
+  LOG4CXX_DEBUG_LEVEL(1, logger_, "FrameId = " << frame_id);
+
+  // As this is the last frame to send, post the remaining scalars ahead of the MCA blocks
+  if (frame_id == (num_frames_ - 1) && num_scalars_recorded_ > 0){
+    LOG4CXX_DEBUG_LEVEL(1, logger_, "Sending the metadata for the last frame");
+    send_scalars(frame_id, header->num_scalars, header->first_channel, header->num_channels);
+  }
+}
+
+/**
+ * Push the live view frame for a frame if one is due.
+ *
+ * The live view can be decimated, either to one frame in every
+ * live_view_frequency frames or to one frame every live_view_period ms.  When
+ * live_view_sum is set the frames in each decimation window are summed into
+ * the frame that is pushed, and when live_view_collapse_aux is set the aux
+ * planes are summed into a single plane.  The last frame of the acquisition is
+ * always pushed.
+ *
+ * \param[in] frame_id - frame number.
+ * \param[in] header - header of the message.
+ * \param[in] mca_ptr - MCA data for every channel of the frame.
+ * \param[in] now - time the frame is being processed.
+ */
+void XspressProcessPlugin::process_live_view(uint32_t frame_id,
+                                             FrameHeader *header,
+                                             char *mca_ptr,
+                                             boost::posix_time::ptime now)
+{
+  if (live_view_name_.empty()){
+    return;
+  }
+  uint32_t num_bins = header->num_energy_bins;
+  uint32_t num_aux = header->num_aux;
+  uint32_t live_aux = live_view_collapse_aux_ ? 1 : num_aux;
+  uint32_t live_values = num_channels_ * live_aux * num_bins;
+  uint32_t *src = (uint32_t *)mca_ptr;
+
+  if (frame_id == 0 || live_view_accumulator_.size() != live_values){
+    live_view_accumulator_.assign(live_values, 0);
+    live_view_frames_ = 0;
+    live_view_last_time_ = now;
+  }
+  live_view_frames_++;
+
+  if (live_view_sum_){
+    uint32_t *acc = &live_view_accumulator_[0];
+    for (uint32_t channel = 0; channel < num_channels_; channel++){
+      for (uint32_t aux = 0; aux < num_aux; aux++){
+        uint32_t *dest = acc + ((channel * live_aux) + (live_view_collapse_aux_ ? 0 : aux)) * num_bins;
+        for (uint32_t bin = 0; bin < num_bins; bin++){
+          dest[bin] += src[bin];
+        }
+        src += num_bins;
+      }
+    }
+  }
+
+  // Check whether a live view frame is due
+  bool due = (frame_id == (num_frames_ - 1));
+  if (live_view_period_ > 0){
+    due = due || (now - live_view_last_time_).total_milliseconds() >= live_view_period_;
+  } else {
+    due = due || live_view_frames_ >= live_view_frequency_;
+  }
+  if (!due){
+    return;
+  }
+
   dimensions_t live_dims;
   live_dims.push_back(num_channels_);
-  live_dims.push_back(header->num_aux);
-  live_dims.push_back(header->num_energy_bins);
+  live_dims.push_back(live_aux);
+  live_dims.push_back(num_bins);
   FrameMetaData live_metadata(frame_id, "live", raw_32bit, "", live_dims);
-  boost::shared_ptr<Frame> live_frame(new DataBlockFrame(live_metadata, (mca_size*num_channels_)));
-  memcpy(live_frame->get_data_ptr(), mca_ptr, (mca_size*num_channels_));
+  // Record how many frames are included in the live view frame
+  live_metadata.set_parameter("live_frames", live_view_frames_);
+  boost::shared_ptr<Frame> live_frame(new DataBlockFrame(live_metadata, live_values * sizeof(uint32_t)));
+  uint32_t *dest = (uint32_t *)live_frame->get_data_ptr();
+  if (live_view_sum_){
+    memcpy(dest, &live_view_accumulator_[0], live_values * sizeof(uint32_t));
+    memset(&live_view_accumulator_[0], 0, live_values * sizeof(uint32_t));
+  } else if (live_view_collapse_aux_ && num_aux > 1){
+    for (uint32_t channel = 0; channel < num_channels_; channel++){
+      memcpy(dest, src, num_bins * sizeof(uint32_t));
+      src += num_bins;
+      for (uint32_t aux = 1; aux < num_aux; aux++){
+        for (uint32_t bin = 0; bin < num_bins; bin++){
+          dest[bin] += src[bin];
+        }
+        src += num_bins;
+      }
+      dest += num_bins;
+    }
+  } else {
+    memcpy(dest, mca_ptr, live_values * sizeof(uint32_t));
+  }
   // Set the chunking size to dimension of 1
   live_frame->set_outer_chunk_size(1);
   // Push out the live MCA data to the live view plugin only
   this->push(live_view_name_, live_frame);
-  LOG4CXX_DEBUG_LEVEL(1, logger_, "FrameId = " << frame_id);
-  for (int index = 0; index < num_channels_; index++){
-    memory_ptrs_[index]->add_frame(frame_id, mca_ptr);
-    mca_ptr += mca_size;
+  live_view_frames_ = 0;
+  live_view_last_time_ = now;
+}
 
-    // Check if the buffer is full
-    if (memory_ptrs_[index]->check_full())
-    {
-      if (frame_id == (num_frames_ - 1))
-      {
-        LOG4CXX_DEBUG_LEVEL(1, logger_, "Sending the metadata as the last frame when the queue is full");
-        send_scalars(frame_id, header->num_scalars, header->first_channel, header->num_channels);
+/**
+ * Add the spectra of a single channel to its memory block for every frame in
+ * a message.
+ *
+ * Each channel owns its own memory block so channels can be processed
+ * concurrently.  Completed blocks are queued on the channel rather than
+ * pushed so that they can be pushed in order once every channel is done.
+ *
+ * \param[in] index - channel index within the message.
+ * \param[in] first_frame_id - frame number of the first frame in the message.
+ * \param[in] header - header of the message.
+ * \param[in] dtc_ptr - start of the dead time correction factors in the message.
+ * \param[in] mca_ptr - start of the MCA data in the message.
+ */
+void XspressProcessPlugin::process_channel(uint32_t index,
+                                           uint32_t first_frame_id,
+                                           FrameHeader *header,
+                                           double *dtc_ptr,
+                                           char *mca_ptr)
+{
+  uint32_t mca_size = header->num_energy_bins * header->num_aux * sizeof(uint32_t);
+  uint32_t first_channel_index = header->first_channel;
+  mca_ptr += (index * mca_size);
+  std::stringstream ss;
+  ss << "mca_" << index + first_channel_index;
+  std::string name = ss.str();
+
+  bool reduce = reduction_enabled();
+
+  for (uint32_t frame = 0; frame < header->num_frames; frame++){
+    uint32_t frame_id = first_frame_id + frame;
+    // Store the spectra, reducing them straight into the memory block if required
+    uint32_t *stored = (uint32_t *)mca_ptr;
+    if (reduce){
+      stored = (uint32_t *)memory_ptrs_[index]->claim_frame(frame_id);
+      reduce_spectra(header, (uint32_t *)mca_ptr, stored);
+    } else {
+      memory_ptrs_[index]->add_frame(frame_id, mca_ptr);
+    }
+    // ROIs and sum spectra are always taken from the full spectra
+    process_reductions(index, header, frame, (uint32_t *)mca_ptr);
+    if (dtc_flags_ & XSP_DTC_CORRECTED_MCA){
+      process_dtc_correction(index, header, frame_id, dtc_ptr[(frame * header->num_channels) + index], stored);
+    }
+
+    queue_channel_block(index, frame_id, header, memory_ptrs_[index], name, raw_32bit);
+    if (dtc_flags_ & XSP_DTC_CORRECTED_MCA){
+      queue_channel_block(index, frame_id, header, corrected_memory_ptrs_[index], name + "_corrected",
+                          (dtc_flags_ & XSP_DTC_CORRECTED_FLOAT) ? raw_float : raw_32bit);
+    }
+    mca_ptr += (mca_size * header->num_channels);
+  }
+}
+
+/**
+ * Write the dead time corrected spectra of a single channel for one frame
+ * straight into its corrected memory block.  The spectra are scaled by the
+ * dead time correction factor of the channel for the frame and either stored
+ * as float32 or rounded to the nearest count.  A factor that is not finite
+ * or is negative is replaced with 1.0, as for the DAQ live data, and large
+ * factors are limited to XSP_DTC_MAX_FACTOR.  Rounded counts saturate at the
+ * largest uint32 value.
+ *
+ * \param[in] index - channel index within the message.
+ * \param[in] header - header of the message.
+ * \param[in] frame_id - frame number.
+ * \param[in] dtc_factor - dead time correction factor of the channel for the frame.
+ * \param[in] spectra - stored spectra of the channel for the frame, one for each stored aux plane.
+ */
+void XspressProcessPlugin::process_dtc_correction(uint32_t index,
+                                                  FrameHeader *header,
+                                                  uint32_t frame_id,
+                                                  double dtc_factor,
+                                                  uint32_t *spectra)
+{
+  uint32_t num_values = output_bins(header->num_energy_bins) * output_aux(header->num_aux);
+  if (std::isinf(dtc_factor) || std::isnan(dtc_factor) || dtc_factor < 0.0){
+    LOG4CXX_DEBUG_LEVEL(2, logger_, "Invalid DTC factor " << dtc_factor << " for frame " << frame_id << ", using 1.0");
+    dtc_factor = 1.0;
+  } else if (dtc_factor > XSP_DTC_MAX_FACTOR){
+    dtc_factor = XSP_DTC_MAX_FACTOR;
+  }
+  float factor = (float)dtc_factor;
+  char *dest = corrected_memory_ptrs_[index]->claim_frame(frame_id);
+
+  if (dtc_flags_ & XSP_DTC_CORRECTED_FLOAT){
+    float *corrected = (float *)dest;
+    for (uint32_t value = 0; value < num_values; value++){
+      corrected[value] = spectra[value] * factor;
+    }
+  } else {
+    uint32_t *corrected = (uint32_t *)dest;
+    // 4294967296.0f is the smallest float above the uint32 range
+    const float limit = 4294967296.0f;
+    for (uint32_t value = 0; value < num_values; value++){
+      float count = spectra[value] * factor + 0.5f;
+      corrected[value] = count < limit ? (uint32_t)count : UINT32_MAX;
+    }
+  }
+}
+
+/**
+ * Check whether the stored spectra are reduced from the spectra received.
+ *
+ * \return true if any energy bin or aux plane reduction is configured.
+ */
+bool XspressProcessPlugin::reduction_enabled()
+{
+  return rebin_factor_ > 1 || rebin_low_ > 0 || rebin_high_ > 0 || aux_select_ >= 0 || aux_sum_;
+}
+
+/**
+ * Number of energy bins stored for each spectrum after rebinning.  Bins left
+ * over at the top of the window that do not fill a whole stored bin are
+ * dropped.
+ *
+ * \param[in] num_bins - number of energy bins received.
+ * \return number of energy bins stored.
+ */
+uint32_t XspressProcessPlugin::output_bins(uint32_t num_bins)
+{
+  uint32_t low = std::min(rebin_low_, num_bins);
+  uint32_t high = (rebin_high_ > 0) ? std::min(rebin_high_, num_bins) : num_bins;
+  return (high > low) ? ((high - low) / rebin_factor_) : 0;
+}
+
+/**
+ * Number of aux planes stored for each spectrum.
+ *
+ * \param[in] num_aux - number of aux planes received.
+ * \return number of aux planes stored.
+ */
+uint32_t XspressProcessPlugin::output_aux(uint32_t num_aux)
+{
+  if (aux_sum_ || aux_select_ >= 0){
+    return std::min(1u, num_aux);
+  }
+  return num_aux;
+}
+
+/**
+ * Reduce the spectra of a channel for one frame to the stored energy bins
+ * and aux planes.  The energy bin window is cropped and each group of
+ * rebin_factor bins summed into one, then either every aux plane is kept,
+ * a single plane is selected or the planes are summed into one.  The loops
+ * are kept simple so that the compiler vectorises them.
+ *
+ * \param[in] header - header of the message.
+ * \param[in] spectra - spectra of the channel for the frame, one for each aux plane.
+ * \param[out] reduced - reduced spectra, one for each stored aux plane.
+ */
+void XspressProcessPlugin::reduce_spectra(FrameHeader *header, uint32_t *spectra, uint32_t *reduced)
+{
+  uint32_t num_bins = header->num_energy_bins;
+  uint32_t num_aux = header->num_aux;
+  uint32_t low = std::min(rebin_low_, num_bins);
+  uint32_t out_bins = output_bins(num_bins);
+  uint32_t factor = rebin_factor_;
+
+  // Work out the range of aux planes to store
+  uint32_t first_aux = 0;
+  uint32_t last_aux = num_aux;
+  if (!aux_sum_ && aux_select_ >= 0 && num_aux > 0){
+    first_aux = std::min((uint32_t)aux_select_, num_aux - 1);
+    last_aux = first_aux + 1;
+  }
+
+  memset(reduced, 0, output_aux(num_aux) * out_bins * sizeof(uint32_t));
+  for (uint32_t aux = first_aux; aux < last_aux; aux++){
+    uint32_t *src = spectra + (aux * num_bins) + low;
+    uint32_t *dest = reduced + (aux_sum_ ? 0 : ((aux - first_aux) * out_bins));
+    if (factor == 1){
+      for (uint32_t bin = 0; bin < out_bins; bin++){
+        dest[bin] += src[bin];
+      }
+    } else {
+      for (uint32_t bin = 0; bin < out_bins; bin++){
+        uint32_t sum = 0;
+        for (uint32_t sub = 0; sub < factor; sub++){
+          sum += src[(bin * factor) + sub];
+        }
+        dest[bin] += sum;
       }
-      // Create the frame and push it
+    }
+  }
+}
+
+/**
+ * Queue the block of spectra for a channel to be pushed if it is full, or if
+ * the last frame of the acquisition has been added to it.
+ *
+ * \param[in] index - channel index within the message.
+ * \param[in] frame_id - frame number of the frame just added to the block.
+ * \param[in] header - header of the message.
+ * \param[in] block - memory block of the channel.
+ * \param[in] name - dataset name of the block.
+ * \param[in] data_type - data type of the spectra in the block.
+ */
+void XspressProcessPlugin::queue_channel_block(uint32_t index,
+                                               uint32_t frame_id,
+                                               FrameHeader *header,
+                                               boost::shared_ptr<XspressMemoryBlock> block,
+                                               const std::string& name,
+                                               DataType data_type)
+{
+  std::vector<boost::shared_ptr<Frame> >& output = channel_frames_[index];
+
+  // Check if the buffer is full
+  if (block->check_full())
+  {
+    // Create the frame and push it
+    dimensions_t mca_dims;
+    mca_dims.push_back(output_aux(header->num_aux));
+    mca_dims.push_back(output_bins(header->num_energy_bins));
+    // Calculate the ID of the frame we need to push
+    // This must be offset according to the rank and number of processes
+    uint32_t push_frame_id = ((frame_id / frames_per_block_) * concurrent_processes_) + concurrent_rank_;
+    FrameMetaData mca_metadata(push_frame_id, name, data_type, "", mca_dims);
+    // Hand the block on without copying, the memory block starts on a new frame
+    boost::shared_ptr<Frame> mca_frame = block->take_frame(mca_metadata);
+    // Set the chunking size
+    mca_frame->set_outer_chunk_size(frames_per_block_);
+    // Queue the MCA data to be pushed
+    output.push_back(mca_frame);
+  }
+  else
+  {
+    // Check if we are writing out the last block which is not full size
+    if (frame_id == (num_frames_ - 1)){
       dimensions_t mca_dims;
-      mca_dims.push_back(header->num_aux);
-      mca_dims.push_back(header->num_energy_bins);
-      std::stringstream ss;
-      ss << "mca_" << index + first_channel_index;
+      mca_dims.push_back(output_aux(header->num_aux));
+      mca_dims.push_back(output_bins(header->num_energy_bins));
       // Calculate the ID of the frame we need to push
       // This must be offset according to the rank and number of processes
       uint32_t push_frame_id = ((frame_id / frames_per_block_) * concurrent_processes_) + concurrent_rank_;
-      FrameMetaData mca_metadata(push_frame_id, ss.str(), raw_32bit, "", mca_dims);
-      boost::shared_ptr<Frame> mca_frame(new DataBlockFrame(mca_metadata, memory_ptrs_[index]->size()));
-      memcpy(mca_frame->get_data_ptr(), memory_ptrs_[index]->get_data_ptr(), memory_ptrs_[index]->size());
+      FrameMetaData mca_metadata(push_frame_id, name, data_type, "", mca_dims);
+      // Zero any slots of missing frames before the block is copied out
+      block->clear_unfilled();
+      boost::shared_ptr<Frame> mca_frame(new DataBlockFrame(mca_metadata, block->current_byte_size()));
+      memcpy(mca_frame->get_data_ptr(), block->get_data_ptr(), block->current_byte_size());
       // Set the chunking size
-      mca_frame->set_outer_chunk_size(frames_per_block_);
-      // Push out the MCA data
-      this->push(mca_frame);
+      mca_frame->set_outer_chunk_size((int)block->frames());
+      // Queue the MCA data to be pushed
+      output.push_back(mca_frame);
       // Reset the memory block
-      memory_ptrs_[index]->reset();
+      block->reset();
+      LOG4CXX_DEBUG_LEVEL(3, logger_, "Pushed partially full frame as required frame count reached");
+    }
+  }
+}
+
+/**
+ * Update the ROI counts and the sum spectrum of a single channel for one
+ * frame.  Both are summed over the aux planes.  Each channel only writes its
+ * own counts and sum spectrum so channels can be processed concurrently.  The
+ * inner loops are kept simple so that the compiler vectorises them.
+ *
+ * \param[in] index - channel index within the message.
+ * \param[in] header - header of the message.
+ * \param[in] frame - frame index within the message.
+ * \param[in] spectra - spectra of the channel for the frame, one for each aux plane.
+ */
+void XspressProcessPlugin::process_reductions(uint32_t index,
+                                              FrameHeader *header,
+                                              uint32_t frame,
+                                              uint32_t *spectra)
+{
+  uint32_t num_bins = header->num_energy_bins;
+  uint32_t num_aux = header->num_aux;
+  uint32_t num_rois = roi_low_.size();
+
+  if (num_rois > 0){
+    uint32_t *counts = &roi_message_counts_[((frame * num_channels_) + index) * num_rois];
+    for (uint32_t roi = 0; roi < num_rois; roi++){
+      uint32_t low = roi_low_[roi];
+      uint32_t high = std::min(roi_high_[roi], num_bins);
+      uint32_t count = 0;
+      for (uint32_t aux = 0; aux < num_aux; aux++){
+        uint32_t *src = spectra + (aux * num_bins);
+        for (uint32_t bin = low; bin < high; bin++){
+          count += src[bin];
+        }
+      }
+      counts[roi] = count;
+    }
+  }
+
+  if (sum_spectra_){
+    uint64_t *acc = &sum_spectra_accumulator_[index * num_bins];
+    for (uint32_t aux = 0; aux < num_aux; aux++){
+      uint32_t *src = spectra + (aux * num_bins);
+      for (uint32_t bin = 0; bin < num_bins; bin++){
+        acc[bin] += src[bin];
+      }
+    }
+  }
+}
+
+/**
+ * Process channels from the current message until every channel has been
+ * claimed.  Called by each worker thread and by the plugin thread itself.
+ */
+void XspressProcessPlugin::process_channel_work()
+{
+  uint32_t index;
+  while ((index = next_channel_++) < work_num_channels_){
+    process_channel(index, work_frame_id_, work_header_, work_dtc_ptr_, work_mca_ptr_);
+  }
+}
+
+/**
+ * Add the spectra of every channel in a message to the memory blocks and push
+ * any completed blocks.
+ *
+ * When worker threads are configured the channels are shared between them and
+ * the plugin thread.  Blocks are always pushed from the plugin thread in frame
+ * then channel order, the same order as processing the channels serially.
+ *
+ * \param[in] first_frame_id - frame number of the first frame in the message.
+ * \param[in] header - header of the message.
+ * \param[in] dtc_ptr - start of the dead time correction factors in the message.
+ * \param[in] mca_ptr - start of the MCA data in the message.
+ */
+void XspressProcessPlugin::process_channels(uint32_t first_frame_id, FrameHeader *header, double *dtc_ptr, char *mca_ptr)
+{
+  boost::lock_guard<boost::mutex> workers_lock(workers_mutex_);
+  {
+    boost::lock_guard<boost::mutex> lock(work_mutex_);
+    work_frame_id_ = first_frame_id;
+    work_header_ = header;
+    work_dtc_ptr_ = dtc_ptr;
+    work_mca_ptr_ = mca_ptr;
+    work_num_channels_ = num_channels_;
+    next_channel_ = 0;
+    pending_workers_ = workers_.size();
+    work_generation_++;
+  }
+  if (!workers_.empty()){
+    work_cond_.notify_all();
+  }
+  process_channel_work();
+  if (!workers_.empty()){
+    boost::unique_lock<boost::mutex> lock(work_mutex_);
+    while (pending_workers_ > 0){
+      done_cond_.wait(lock);
+    }
+  }
+
+  // Publish the ROI counts and sum spectra ahead of the MCA blocks
+  publish_reductions(first_frame_id, header);
+
+  // Every channel completes its blocks on the same frames, so taking one block
+  // from each channel in turn preserves the serial push order
+  bool pushed = true;
+  for (uint32_t block = 0; pushed; block++){
+    pushed = false;
+    for (uint32_t index = 0; index < num_channels_; index++){
+      if (block < channel_frames_[index].size()){
+        this->push(channel_frames_[index][block]);
+        pushed = true;
+      }
+    }
+  }
+  for (uint32_t index = 0; index < num_channels_; index++){
+    channel_frames_[index].clear();
+  }
+}
+
+/**
+ * Record the ROI counts of every frame in a message, publishing them once a
+ * block of frames has been recorded, and publish the sum spectra once the last
+ * frame of the acquisition has been processed.
+ *
+ * \param[in] first_frame_id - frame number of the first frame in the message.
+ * \param[in] header - header of the message.
+ */
+void XspressProcessPlugin::publish_reductions(uint32_t first_frame_id, FrameHeader *header)
+{
+  uint32_t frame_counts = num_channels_ * roi_low_.size();
+  for (uint32_t frame = 0; frame < header->num_frames; frame++){
+    uint32_t frame_id = first_frame_id + frame;
+    if (frame_counts > 0){
+      memcpy(&roi_memblock_[sizeof(MetaHeader) + (num_rois_recorded_ * frame_counts * sizeof(uint32_t))],
+             &roi_message_counts_[frame * frame_counts],
+             frame_counts * sizeof(uint32_t));
+      num_rois_recorded_++;
+      if (num_rois_recorded_ == frames_per_block_ || frame_id == (num_frames_ - 1)){
+        send_rois(frame_id, header->first_channel, num_channels_);
+      }
     }
-    else
+    if (sum_spectra_ && frame_id == (num_frames_ - 1)){
+      LOG4CXX_DEBUG_LEVEL(1, logger_, "Sending the sum spectra for the last frame");
+      send_sum_spectra(header->first_channel, num_channels_, header->num_energy_bins);
+    }
+  }
+}
+
+/**
+ * Worker thread loop, processing channels for each message dispatched by
+ * process_channels until the workers are stopped.
+ *
+ * \param[in] generation - dispatch generation when the worker was started.
+ */
+void XspressProcessPlugin::worker_task(uint64_t generation)
+{
+  while (true){
     {
-      // Check if we are writing out the last block which is not full size
-      if (frame_id == (num_frames_ - 1)){
-        LOG4CXX_DEBUG_LEVEL(1, logger_, "Sending the metadata as the last frame when the queue is not full");
-        // As this is the last frame block to send, post the scalar buffer as well
-        send_scalars(frame_id, header->num_scalars, header->first_channel, header->num_channels);
-
-        dimensions_t mca_dims;
-        mca_dims.push_back(header->num_aux);
-        mca_dims.push_back(header->num_energy_bins);
-        std::stringstream ss;
-        ss << "mca_" << index + first_channel_index;
-        // Calculate the ID of the frame we need to push
-        // This must be offset according to the rank and number of processes
-        uint32_t push_frame_id = ((frame_id / frames_per_block_) * concurrent_processes_) + concurrent_rank_;
-        FrameMetaData mca_metadata(push_frame_id, ss.str(), raw_32bit, "", mca_dims);
-        boost::shared_ptr<Frame> mca_frame(new DataBlockFrame(mca_metadata, memory_ptrs_[index]->current_byte_size()));
-        memcpy(mca_frame->get_data_ptr(), memory_ptrs_[index]->get_data_ptr(), memory_ptrs_[index]->current_byte_size());
-        // Set the chunking size
-        mca_frame->set_outer_chunk_size((int)memory_ptrs_[index]->frames());
-        // Push out the MCA data
-        this->push(mca_frame);
-        // Reset the memory block
-        memory_ptrs_[index]->reset();
-        LOG4CXX_DEBUG_LEVEL(3, logger_, "Pushed partially full frame as required frame count reached");
+      boost::unique_lock<boost::mutex> lock(work_mutex_);
+      while (!workers_stop_ && work_generation_ == generation){
+        work_cond_.wait(lock);
       }
+      if (workers_stop_){
+        return;
+      }
+      generation = work_generation_;
     }
+    process_channel_work();
+    {
+      boost::lock_guard<boost::mutex> lock(work_mutex_);
+      if (--pending_workers_ == 0){
+        done_cond_.notify_all();
+      }
+    }
+  }
+}
+
+/**
+ * Set the number of worker threads used to process channels in addition to
+ * the plugin thread.  Zero processes every channel on the plugin thread.
+ *
+ * \param[in] num_threads - number of worker threads.
+ */
+void XspressProcessPlugin::set_worker_threads(uint32_t num_threads)
+{
+  // Wait for any message being processed before changing the workers
+  boost::lock_guard<boost::mutex> lock(workers_mutex_);
+  stop_workers();
+  workers_stop_ = false;
+  for (uint32_t index = 0; index < num_threads; index++){
+    workers_.push_back(new boost::thread(&XspressProcessPlugin::worker_task, this, work_generation_));
   }
+  num_worker_threads_ = num_threads;
+  LOG4CXX_INFO(logger_, "Number of channel worker threads set to " << num_threads);
 }
 
+void XspressProcessPlugin::stop_workers()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(work_mutex_);
+    workers_stop_ = true;
+  }
+  work_cond_.notify_all();
+  for (size_t index = 0; index < workers_.size(); index++){
+    workers_[index]->join();
+    delete workers_[index];
+  }
+  workers_.clear();
+}
+
+/**
+ * Fill in the MetaHeader at the start of a meta data block.
+ *
+ * \param[in] block - start of the meta data block.
+ * \param[in] frame_id - frame number of the first frame in the block.
+ * \param[in] num_frames - number of frames in the block.
+ * \param[in] first_channel - index of the first channel.
+ * \param[in] num_channels - number of channels.
+ * \param[in] num_values - number of values for each channel.
+ */
+static void fill_meta_header(char *block,
+                             uint32_t frame_id,
+                             uint32_t num_frames,
+                             uint32_t first_channel,
+                             uint32_t num_channels,
+                             uint32_t num_values)
+{
+  MetaHeader *meta_header = reinterpret_cast<MetaHeader *>(block);
+  memset(meta_header, 0, sizeof(MetaHeader));
+  meta_header->frame_id = frame_id;
+  meta_header->num_frames = num_frames;
+  meta_header->first_channel = first_channel;
+  meta_header->num_channels = num_channels;
+  meta_header->num_values = num_values;
+}
+
+/**
+ * Publish the scalars, DTC factors and input estimates recorded since the last
+ * block was published as a single meta data block.
+ *
+ * The block holds a MetaHeader followed by a record for each frame, holding
+ * the uint32 scalars ordered by channel then scalar, then the double DTC
+ * factor of each channel, then the double input estimate of each channel.
+ *
+ * \param[in] last_frame_id - frame number of the last frame recorded.
+ * \param[in] num_scalars - number of scalars for each channel.
+ * \param[in] first_channel - index of the first channel.
+ * \param[in] num_channels - number of channels.
+ */
 void XspressProcessPlugin::send_scalars(uint32_t last_frame_id, uint32_t num_scalars, uint32_t first_channel, uint32_t num_channels)
 {
-  uint32_t num_scalar_values = num_scalars * num_channels;
-  uint32_t num_dtc_factors = num_channels;
-  uint32_t num_inp_est = num_channels;
+  uint32_t record_bytes = num_channels * ((num_scalars * sizeof(uint32_t)) + (2 * sizeof(double)));
   uint32_t frame_id = last_frame_id - num_scalars_recorded_ + 1;
 
-  rapidjson::Document meta_document;
-  meta_document.SetObject();
+  fill_meta_header(&meta_memblock_[0], frame_id, num_scalars_recorded_, first_channel, num_channels, num_scalars);
 
-  // Add Acquisition ID
-  rapidjson::Value key_acq_id("acqID", meta_document.GetAllocator());
-  rapidjson::Value value_acq_id;
-  value_acq_id.SetString(acq_id_.c_str(), acq_id_.size(), meta_document.GetAllocator());
-  meta_document.AddMember(key_acq_id, value_acq_id, meta_document.GetAllocator());
-  // Add rank
-  rapidjson::Value key_rank("rank", meta_document.GetAllocator());
-  rapidjson::Value value_rank;
-  value_rank.SetInt(concurrent_rank_);
-  meta_document.AddMember(key_rank, value_rank, meta_document.GetAllocator());
-  // Add frame_id
-  rapidjson::Value key_frame_id("frame_id", meta_document.GetAllocator());
-  rapidjson::Value value_frame_id;
-  value_frame_id.SetInt(frame_id);
-  meta_document.AddMember(key_frame_id, value_frame_id, meta_document.GetAllocator());
-  // Add number of data points
-  rapidjson::Value key_qty("qty_scalars", meta_document.GetAllocator());
-  rapidjson::Value value_qty;
-  value_qty.SetInt(num_scalar_values);
-  meta_document.AddMember(key_qty, value_qty, meta_document.GetAllocator());
-  // Add channel index
-  rapidjson::Value key_index("channel_index", meta_document.GetAllocator());
-  rapidjson::Value value_index;
-  value_index.SetInt(first_channel);
-  meta_document.AddMember(key_index, value_index, meta_document.GetAllocator());
-  // Add number of channels
-  rapidjson::Value key_num("number_of_channels", meta_document.GetAllocator());
-  rapidjson::Value value_num;
-  value_num.SetInt(num_channels);
-  meta_document.AddMember(key_num, value_num, meta_document.GetAllocator());
-  rapidjson::Value key_num_frames("number_of_frames", meta_document.GetAllocator());
-  rapidjson::Value value_num_frames;
-  value_num_frames.SetInt(num_scalars_recorded_);
-  meta_document.AddMember(key_num_frames, value_num_frames, meta_document.GetAllocator());
+  LOG4CXX_DEBUG_LEVEL(3, logger_, "Publishing MCA scalars for " << num_scalars_recorded_ << " frames from frame " << frame_id);
+  this->publish_meta(META_NAME,
+                      META_XSPRESS_BLOCK,
+                      &meta_memblock_[0],
+                      sizeof(MetaHeader) + (record_bytes * num_scalars_recorded_),
+                      meta_header_);
 
-  rapidjson::StringBuffer buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-  meta_document.Accept(writer);
+  num_scalars_recorded_ = 0;
+}
 
-  LOG4CXX_DEBUG_LEVEL(3, logger_, "Publishing MCA scalars: " << buffer.GetString());
-  this->publish_meta(META_NAME,
-                      META_XSPRESS_SCALARS,
-                      scalar_memblock_,
-                      num_scalar_values * num_scalars_recorded_ * sizeof(uint32_t),
-                      buffer.GetString());
+/**
+ * Publish the ROI counts recorded since the last block was published.
+ *
+ * The block holds a MetaHeader followed by the uint32 counts ordered by
+ * frame, then channel, then ROI.
+ *
+ * \param[in] last_frame_id - frame number of the last frame recorded.
+ * \param[in] first_channel - index of the first channel.
+ * \param[in] num_channels - number of channels.
+ */
+void XspressProcessPlugin::send_rois(uint32_t last_frame_id, uint32_t first_channel, uint32_t num_channels)
+{
+  uint32_t num_rois = roi_low_.size();
+  uint32_t frame_id = last_frame_id - num_rois_recorded_ + 1;
 
-  this->publish_meta(META_NAME,
-                      META_XSPRESS_DTC,
-                      dtc_memblock_,
-                      num_dtc_factors * num_scalars_recorded_ * sizeof(double),
-                      buffer.GetString());
+  fill_meta_header(&roi_memblock_[0], frame_id, num_rois_recorded_, first_channel, num_channels, num_rois);
 
+  LOG4CXX_DEBUG_LEVEL(3, logger_, "Publishing ROI counts for " << num_rois_recorded_ << " frames from frame " << frame_id);
   this->publish_meta(META_NAME,
-                      META_XSPRESS_INP_EST,
-                      inp_est_memblock_,
-                      num_inp_est * num_scalars_recorded_ * sizeof(double),
-                      buffer.GetString());
+                      META_XSPRESS_ROI,
+                      &roi_memblock_[0],
+                      sizeof(MetaHeader) + (num_channels * num_rois * num_rois_recorded_ * sizeof(uint32_t)),
+                      meta_header_);
 
-  num_scalars_recorded_ = 0;
+  num_rois_recorded_ = 0;
+}
+
+/**
+ * Publish the sum spectrum of each channel accumulated over the acquisition.
+ *
+ * The block holds a MetaHeader followed by the uint64 sums ordered by
+ * channel, then bin.
+ *
+ * \param[in] first_channel - index of the first channel.
+ * \param[in] num_channels - number of channels.
+ * \param[in] num_bins - number of energy bins in each spectrum.
+ */
+void XspressProcessPlugin::send_sum_spectra(uint32_t first_channel, uint32_t num_channels, uint32_t num_bins)
+{
+  uint32_t sum_bytes = num_channels * num_bins * sizeof(uint64_t);
+  std::vector<char> block(sizeof(MetaHeader) + sum_bytes);
+
+  fill_meta_header(&block[0], 0, 1, first_channel, num_channels, num_bins);
+  memcpy(&block[sizeof(MetaHeader)], &sum_spectra_accumulator_[0], sum_bytes);
+
+  LOG4CXX_DEBUG_LEVEL(3, logger_, "Publishing sum spectra for " << num_channels << " channels");
+  this->publish_meta(META_NAME,
+                      META_XSPRESS_SUM,
+                      &block[0],
+                      block.size(),
+                      meta_header_);
 }
 }
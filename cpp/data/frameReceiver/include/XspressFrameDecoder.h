@@ -36,6 +36,8 @@ namespace FrameReceiver {
     // decoder interface
     void init(LoggerPtr& logger, OdinData::IpcMessage& config_msg);
 
+    void request_configuration(const std::string param_prefix, OdinData::IpcMessage& config_reply);
+
     const size_t get_frame_buffer_size(void) const;
 
     const size_t get_frame_header_size(void) const;
@@ -52,9 +54,15 @@ namespace FrameReceiver {
     void get_status(const std::string param_prefix, OdinData::IpcMessage &status_msg);
 
   private:
+    size_t get_message_size(const FrameHeader *header) const;
+
     void *current_frame_buffer_;
     void *dropped_frame_buffer_;
     int32_t current_frame_buffer_id_;
+    /** Number of bytes of the current (possibly multipart) message received */
+    size_t current_offset_;
+    /** Is the remainder of the current message being discarded */
+    bool discard_message_;
     uint32_t current_frame_number_;
     enum XspressState current_state;
     // statistics
@@ -63,6 +71,10 @@ namespace FrameReceiver {
     uint32_t numEnergy;
     uint32_t numAux;
     size_t currentChannel;
+    uint32_t framesPerMessage;
+
+    /** Configuration constant for the maximum number of frames sent in one DAQ message */
+    static const std::string CONFIG_FRAMES_PER_MESSAGE;
 
   };
 
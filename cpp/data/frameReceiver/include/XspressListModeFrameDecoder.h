@@ -8,7 +8,15 @@
 #ifndef SRC_XSPRESSLISTMODEDECODER_H
 #define SRC_XSPRESSLISTMODEDECODER_H
 
+#include <map>
+#include <vector>
+#include <deque>
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
 #include <log4cxx/logger.h>
 #include <log4cxx/basicconfigurator.h>
 #include <log4cxx/propertyconfigurator.h>
@@ -23,6 +31,89 @@ using namespace log4cxx::helpers;
 
 namespace FrameReceiver {
 
+/**
+ * Entry in the table mapping the source of list mode packets to the system
+ * channel of the first channel of the card.  The address and port are held
+ * in network byte order so they can be compared straight against the source
+ * address of each packet.
+ */
+typedef struct
+{
+  in_addr_t address;
+  /** Source port, 0 matches any port */
+  in_port_t port;
+  uint32_t first_channel;
+} ChannelMapEntry;
+
+/**
+ * Frame being assembled for a single channel when frames are assembled per
+ * channel.  The state of the current frame is swapped in and out of the
+ * decoder as packets arrive from each channel.
+ */
+typedef struct
+{
+  int32_t buffer_id;
+  void *buffer;
+  uint32_t frame_number;
+  bool dropping;
+} ChannelFrame;
+
+// Default number of packets received between batched receives when there is no backlog
+#define XSP_LIST_DEFAULT_BATCH_INTERVAL 64
+// Number of system channels statistics are recorded for
+#define XSP_LIST_STATS_CHANNELS 64
+// Header frame number recorded before the first packet of a channel
+#define XSP_LIST_NO_FRAME 0xFFFFFFFF
+
+/**
+ * Statistics recorded for each system channel.  The counters are updated
+ * with relaxed atomic operations by the RX thread, and the ACK sender thread
+ * for ACKs, so they can be read at any time without locking.
+ */
+typedef struct
+{
+  boost::atomic<uint64_t> packets;
+  boost::atomic<uint64_t> bytes;
+  /** Packets received while no frame buffer was available */
+  boost::atomic<uint64_t> dropped;
+  /** Packets ignored during the initialisation time, these are not lost */
+  boost::atomic<uint64_t> discarded;
+  /** Time frames missing from the header frame number sequence */
+  boost::atomic<uint64_t> frame_gaps;
+  boost::atomic<uint64_t> eofs;
+  boost::atomic<uint64_t> acks_sent;
+} ChannelStatistics;
+
+// Size of an ACK packet (int32 words)
+#define XSPRESS_ACK_SIZE 6
+
+/**
+ * ACK waiting to be sent by the ACK sender thread.  The ACK is sent on the
+ * socket connected to the card for the channel map entry that matched the
+ * EOF packet, or to the source address of the packet if no entry matched.
+ */
+typedef struct
+{
+  /** Channel map entry of the card, -1 if the source is not in the channel map */
+  int32_t entry;
+  /** System channel the ACK is sent for */
+  uint32_t channel;
+  struct sockaddr_in address;
+  uint32_t data[XSPRESS_ACK_SIZE];
+} AckMessage;
+
+/**
+ * Receive socket of the RX thread for a port, used for batched receives.
+ */
+typedef struct
+{
+  int socket;
+  /** The last batched receive filled up, so more packets are likely to be waiting */
+  bool backlog;
+  /** Packets received since the last batched receive */
+  uint32_t packets;
+} ReceiveSocket;
+
 class XspressListModeFrameDecoder : public FrameDecoderUDP {
 
   public:
@@ -48,7 +139,9 @@ class XspressListModeFrameDecoder : public FrameDecoderUDP {
     const size_t get_frame_buffer_size(void) const;
     const size_t get_frame_header_size(void) const;
 
-    inline const bool requires_header_peek(void) const { return true; };
+    // Packets are received straight into their slot in the frame so the header only needs peeking
+    // to find the channel frame when frames are assembled per channel
+    inline const bool requires_header_peek(void) const { return per_channel_frames_; };
     const size_t get_packet_header_size(void) const;
     void process_packet_header(size_t bytes_received, int port, struct sockaddr_in* from_addr);
 
@@ -64,12 +157,61 @@ class XspressListModeFrameDecoder : public FrameDecoderUDP {
 
     void* get_packet_header_buffer(void);
 
+    // Called by the RX thread with the socket it receives on for each port to enable batched receives
+    void set_receive_socket(int port, int receive_socket);
+
     //uint32_t get_frame_number(void) const;
     //uint32_t get_packet_number(void) const;
 
 
   private:
-    boost::shared_ptr<void> current_raw_packet_header_;
+    void claim_frame_buffer(void);
+    void select_channel_frame(uint32_t channel);
+    uint8_t* get_packet_slot(uint32_t packet) const;
+    FrameDecoder::FrameReceiveState process_packet_data(uint8_t* packet, size_t bytes_received, int port, struct sockaddr_in* from_addr);
+    FrameDecoder::FrameReceiveState receive_batch(ReceiveSocket& receive, int port, FrameDecoder::FrameReceiveState frame_state);
+    void configure_channel_map(const rapidjson::Value& channel_map);
+    void add_channel_map_entry(const std::string& address, uint16_t port, uint32_t first_channel);
+    int32_t find_channel_map_entry(const struct sockaddr_in* from_addr);
+    void open_ack_sockets(void);
+    void close_ack_sockets(void);
+    void queue_ack(int32_t entry, const struct sockaddr_in* from_addr, uint32_t frame, uint32_t chan_of_card, uint32_t channel);
+    void update_statistics(uint32_t channel, uint64_t header, size_t bytes_received);
+    void start_ack_sender(void);
+    void stop_ack_sender(void);
+    void ack_sender_task(void);
+
+    /** Slot in the current frame the current packet is received into */
+    uint8_t* current_packet_buffer_;
+    /** Header word of the current packet when it is peeked to find the channel frame */
+    uint64_t current_raw_packet_header_;
+    /** Assemble a separate frame for each channel rather than sharing frames between channels */
+    bool per_channel_frames_;
+    /** Frames being assembled for each system channel, and the channel currently swapped in */
+    std::vector<ChannelFrame> channel_frames_;
+    uint32_t active_channel_;
+    /** Maximum number of packets received by each batched receive, 0 disables batching */
+    uint32_t batch_packets_;
+    /** Packets received between batched receives when the last one did not fill up */
+    uint32_t batch_interval_;
+    /** Receive sockets of the RX thread for each port, set through set_receive_socket */
+    std::map<int, ReceiveSocket> receive_sockets_;
+    /** Message headers, buffers and addresses for batched receives */
+    std::vector<struct mmsghdr> batch_msgs_;
+    std::vector<struct iovec> batch_iovecs_;
+    std::vector<struct sockaddr_in> batch_addrs_;
+    /** Configuration constant for the maximum number of packets in a batched receive */
+    static const std::string CONFIG_BATCH_PACKETS;
+    /** Configuration constant for the number of packets between batched receives */
+    static const std::string CONFIG_BATCH_INTERVAL;
+    /** Configuration constant for assembling frames per channel */
+    static const std::string CONFIG_PER_CHANNEL_FRAMES;
+    /** Configuration constants for the mapping of packet sources to channels */
+    static const std::string CONFIG_CHANNEL_MAP;
+    static const std::string CONFIG_CHANNEL_MAP_ADDRESS;
+    static const std::string CONFIG_CHANNEL_MAP_PORT;
+    static const std::string CONFIG_CHANNEL_MAP_CHANNEL;
+
     boost::shared_ptr<void> dropped_frame_buffer_;
     void *current_frame_buffer_;
     Xspress::ListFrameHeader *current_frame_header_;
@@ -81,9 +223,30 @@ class XspressListModeFrameDecoder : public FrameDecoderUDP {
     enum XspressState current_state;
     // statistics
     unsigned int frames_dropped_;
-    std::map<std::string, uint32_t> channel_map_;
-    struct sockaddr_in server_address_;
-    int server_socket_;
+    /** Statistics for each system channel */
+    boost::scoped_array<ChannelStatistics> channel_stats_;
+    /** One more than the highest system channel a packet has been received from */
+    boost::atomic<uint32_t> stats_channels_;
+    /** Header frame number of the last packet from each channel, only used by the RX thread */
+    uint32_t last_header_frame_[XSP_LIST_STATS_CHANNELS];
+    /** Totals reported by the last call to monitor_buffers */
+    uint64_t monitor_dropped_;
+    uint64_t monitor_frame_gaps_;
+    /** Packet source to first channel table, searched in order */
+    std::vector<ChannelMapEntry> channel_map_;
+    /** Index of the entry that matched the last packet */
+    size_t last_channel_map_entry_;
+    /** ACK sockets connected to the card of each channel map entry, -1 if not open.  The
+        sockets are only opened and closed while the ACK sender thread is stopped */
+    std::vector<int> ack_sockets_;
+    /** Unconnected socket used to ACK packets from sources not in the channel map */
+    int unmapped_ack_socket_;
+    /** ACKs queued by the RX thread for the ACK sender thread */
+    std::deque<AckMessage> ack_queue_;
+    boost::mutex ack_mutex_;
+    boost::condition_variable ack_condition_;
+    boost::shared_ptr<boost::thread> ack_thread_;
+    bool ack_running_;
     // Init time structure
     struct timespec init_time_;
     // Initialising flag
@@ -3,9 +3,13 @@
 
 namespace FrameReceiver {
 
+    const std::string XspressFrameDecoder::CONFIG_FRAMES_PER_MESSAGE = "frames_per_message";
+
     XspressFrameDecoder::XspressFrameDecoder() : FrameDecoderZMQ(), current_frame_buffer_(NULL), current_frame_number_(0),
-                                         current_frame_buffer_id_(-1), current_state(WAITING_FOR_HEADER),
-                                         frames_dropped_(0), numChannels(8), numEnergy(4096), numAux(1), currentChannel(0) 
+                                         current_frame_buffer_id_(-1), current_offset_(0), discard_message_(false),
+                                         current_state(WAITING_FOR_HEADER),
+                                         frames_dropped_(0), numChannels(8), numEnergy(4096), numAux(1), currentChannel(0),
+                                         framesPerMessage(1)
     {
       // Allocate memory for the dropped frames buffer
       dropped_frame_buffer_ = malloc(get_frame_buffer_size());
@@ -18,42 +22,125 @@ namespace FrameReceiver {
         this->logger_ = Logger::getLogger("FR.XspressFrameDecoder");
         this->logger_->setLevel(Level::getAll());
         FrameDecoder::init(logger, config_msg);
+
+        // Check for the maximum number of frames batched into a single message by the DAQ
+        if (config_msg.has_param(XspressFrameDecoder::CONFIG_FRAMES_PER_MESSAGE)) {
+          framesPerMessage = config_msg.get_param<unsigned int>(XspressFrameDecoder::CONFIG_FRAMES_PER_MESSAGE);
+          if (framesPerMessage == 0) {
+            framesPerMessage = 1;
+          }
+          LOG4CXX_INFO(logger_, "Frames per message set to " << framesPerMessage);
+          // The dropped frame buffer must be able to hold a full message
+          free(dropped_frame_buffer_);
+          dropped_frame_buffer_ = malloc(get_frame_buffer_size());
+        }
         LOG4CXX_INFO(logger_, "Xspress frame decoder init complete");
     }
 
+    void XspressFrameDecoder::request_configuration(const std::string param_prefix, OdinData::IpcMessage& config_reply)
+    {
+        // Call the base class method to populate parameters
+        FrameDecoder::request_configuration(param_prefix, config_reply);
+        config_reply.set_param(param_prefix + XspressFrameDecoder::CONFIG_FRAMES_PER_MESSAGE, framesPerMessage);
+    }
+
     void *XspressFrameDecoder::get_next_message_buffer(void) {
-        if (__builtin_expect(empty_buffer_queue_.empty(), false)) {
-          // dropped for not having buffers available
-          frames_dropped_++;
-          LOG4CXX_ERROR(logger_, "XspressFrameDecoder: Dropped " << frames_dropped_ << " frames");
-          current_frame_buffer_ = dropped_frame_buffer_;
-          // use last valid buffer
-        } else if (current_frame_buffer_id_ == -1) {
-          current_frame_buffer_id_ = empty_buffer_queue_.front();
-          empty_buffer_queue_.pop();
-          current_frame_buffer_ = buffer_manager_->get_buffer_address(current_frame_buffer_id_);
+        // The parts of a multipart message are received one after another into the same buffer
+        if (discard_message_) {
+          return dropped_frame_buffer_;
         }
-        return current_frame_buffer_;
+        if (current_offset_ == 0) {
+          if (__builtin_expect(empty_buffer_queue_.empty(), false)) {
+            // dropped for not having buffers available
+            frames_dropped_++;
+            LOG4CXX_ERROR(logger_, "XspressFrameDecoder: Dropped " << frames_dropped_ << " frames");
+            current_frame_buffer_ = dropped_frame_buffer_;
+            // use last valid buffer
+          } else if (current_frame_buffer_id_ == -1) {
+            current_frame_buffer_id_ = empty_buffer_queue_.front();
+            empty_buffer_queue_.pop();
+            current_frame_buffer_ = buffer_manager_->get_buffer_address(current_frame_buffer_id_);
+          }
+        }
+        return static_cast<char *>(current_frame_buffer_) + current_offset_;
     }
 
     FrameDecoder::FrameReceiveState XspressFrameDecoder::process_message(size_t bytes_received)
     {
+        FrameDecoder::FrameReceiveState state = FrameDecoder::FrameReceiveStateComplete;
         FrameHeader *header_ = reinterpret_cast<FrameHeader*> (current_frame_buffer_);
-        current_frame_number_ = header_->frame_number;
-        if (current_frame_buffer_id_ != -1){
-          ready_callback_(current_frame_buffer_id_, current_frame_number_);
+        if (discard_message_){
+          // The remaining parts of a dropped message are ignored
+          return state;
+        }
+        current_offset_ += bytes_received;
+        if (current_offset_ < sizeof(FrameHeader)){
+          // Not enough data received to contain a header
+          state = FrameDecoder::FrameReceiveStateIncomplete;
+        } else if (current_offset_ > get_frame_buffer_size() || get_message_size(header_) > get_frame_buffer_size()){
+          // The message does not fit, so the buffer cannot be passed on for processing.  Any
+          // further parts of the message are received into the dropped frame buffer.
+          frames_dropped_ += header_->num_frames;
+          LOG4CXX_ERROR(logger_, "XspressFrameDecoder: Message of " << get_message_size(header_) << " bytes containing "
+                        << header_->num_frames << " frames exceeds buffer size, check "
+                        << CONFIG_FRAMES_PER_MESSAGE << " is at least the DAQ batch size");
+          if (current_frame_buffer_id_ != -1){
+            empty_buffer_queue_.push(current_frame_buffer_id_);
+            current_frame_buffer_id_ = -1;
+          }
+          discard_message_ = true;
+        } else if (current_offset_ < get_message_size(header_)){
+          // The MCA data of a zero copy message follows in further parts
+          state = FrameDecoder::FrameReceiveStateIncomplete;
+        } else {
+          current_frame_number_ = header_->frame_number;
+          if (current_frame_buffer_id_ != -1){
+            ready_callback_(current_frame_buffer_id_, current_frame_number_);
+          }
         }
-        return FrameDecoder::FrameReceiveStateComplete;
+        return state;
     }
 
     void XspressFrameDecoder::frame_meta_data(int meta)
     {
       // end of message bit
       if (meta & 1) {
+        if (discard_message_) {
+          // Already accounted for when the message was dropped
+        } else if (current_offset_ > 0 && current_offset_ < sizeof(FrameHeader)) {
+          // A short message can never be processed
+          frames_dropped_++;
+          LOG4CXX_ERROR(logger_, "XspressFrameDecoder: Message of " << current_offset_ << " bytes is too short");
+          if (current_frame_buffer_id_ != -1){
+            empty_buffer_queue_.push(current_frame_buffer_id_);
+          }
+        } else if (current_offset_ > 0 && current_offset_ < get_message_size(reinterpret_cast<FrameHeader*>(current_frame_buffer_))) {
+          // The message ended before all of the parts were received
+          FrameHeader *header_ = reinterpret_cast<FrameHeader*> (current_frame_buffer_);
+          frames_dropped_ += header_->num_frames;
+          LOG4CXX_ERROR(logger_, "XspressFrameDecoder: Incomplete message of " << current_offset_ << " bytes containing "
+                        << header_->num_frames << " frames");
+          if (current_frame_buffer_id_ != -1){
+            empty_buffer_queue_.push(current_frame_buffer_id_);
+          }
+        }
         current_frame_buffer_id_ = -1;
+        current_offset_ = 0;
+        discard_message_ = false;
       }
     }
 
+    /** Calculate the total size of a message from its header.
+     *
+     * \param[in] header - the message header.
+     * \return the size of the message in bytes.
+     */
+    size_t XspressFrameDecoder::get_message_size(const FrameHeader *header) const {
+        size_t channel_size = (header->num_energy_bins * header->num_aux + header->num_scalars) * sizeof(uint32_t) +
+                              (2 * sizeof(double));
+        return sizeof(FrameHeader) + ((size_t)header->num_frames * header->num_channels * channel_size);
+    }
+
     void XspressFrameDecoder::monitor_buffers(void) {
       LOG4CXX_DEBUG_LEVEL(1, logger_, "Empty: " << empty_buffer_queue_.size() << " Dropped: " << frames_dropped_);
     }
@@ -64,7 +151,9 @@ namespace FrameReceiver {
     }
 
     const size_t XspressFrameDecoder::get_frame_buffer_size(void) const {
-        return (numChannels * ((numEnergy * numAux + XSP3_SW_NUM_SCALERS)*sizeof(uint32_t)) + sizeof(FrameHeader));
+        // Each channel of each frame carries its spectrum, scalars, DTC factor and input estimate
+        return (framesPerMessage * numChannels * (((numEnergy * numAux + XSP3_SW_NUM_SCALERS)*sizeof(uint32_t)) + (2 * sizeof(double)))
+                + sizeof(FrameHeader));
     }
 
     const size_t XspressFrameDecoder::get_frame_header_size(void) const {
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -6,35 +10,59 @@
 
 // Port on xspress to send ACK packets to
 #define XSPRESS_ACK_PORT 30124
-// Size of ACK packet (int32 words)
-#define XSPRESS_ACK_SIZE 6
 // Initialisation time (us).  For this duration after init packets will be ignored
 #define XSPRESS_INIT_TIME 1000000
 
 namespace FrameReceiver {
 
+    const std::string XspressListModeFrameDecoder::CONFIG_BATCH_PACKETS = "batch_packets";
+    const std::string XspressListModeFrameDecoder::CONFIG_BATCH_INTERVAL = "batch_interval";
+    const std::string XspressListModeFrameDecoder::CONFIG_PER_CHANNEL_FRAMES = "per_channel_frames";
+    const std::string XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP = "channel_map";
+    const std::string XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_ADDRESS = "address";
+    const std::string XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_PORT = "port";
+    const std::string XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_CHANNEL = "channel";
+
     XspressListModeFrameDecoder::XspressListModeFrameDecoder() : FrameDecoderUDP(),
+      current_packet_buffer_(NULL),
+      current_raw_packet_header_(0),
+      per_channel_frames_(false),
+      active_channel_(0),
+      batch_packets_(0),
+      batch_interval_(XSP_LIST_DEFAULT_BATCH_INTERVAL),
       current_frame_buffer_(NULL),
       current_frame_number_(0),
       dropping_frame_data_(false),
       current_frame_buffer_id_(-1),
       current_state(WAITING_FOR_HEADER),
       frames_dropped_(0),
-      server_socket_(0),
+      channel_stats_(new ChannelStatistics[XSP_LIST_STATS_CHANNELS]),
+      stats_channels_(0),
+      monitor_dropped_(0),
+      monitor_frame_gaps_(0),
+      last_channel_map_entry_(0),
+      unmapped_ack_socket_(-1),
+      ack_running_(false),
       initialising_(true)
     {
       // Allocate memory for the dropped frames buffer
-      current_raw_packet_header_.reset(new uint8_t[Xspress::packet_header_size]);
       dropped_frame_buffer_.reset(new uint8_t[get_frame_buffer_size()]);
 
-      // Add channel to IP mapping
-      channel_map_["192.168.0.66"] = 0;
-      channel_map_["192.168.0.70"] = 10;
-      channel_map_["192.168.0.74"] = 20;
-      channel_map_["192.168.0.78"] = 30;
+      reset_statistics();
+      for (uint32_t channel = 0; channel < XSP_LIST_STATS_CHANNELS; channel++){
+        last_header_frame_[channel] = XSP_LIST_NO_FRAME;
+      }
+
+      // Default channel to IP mapping, replaced by the channel_map configuration
+      add_channel_map_entry("192.168.0.66", 0, 0);
+      add_channel_map_entry("192.168.0.70", 0, 10);
+      add_channel_map_entry("192.168.0.74", 0, 20);
+      add_channel_map_entry("192.168.0.78", 0, 30);
     }
 
     XspressListModeFrameDecoder::~XspressListModeFrameDecoder() {
+      stop_ack_sender();
+      close_ack_sockets();
     }
 
     // Version functions
@@ -62,13 +90,297 @@ namespace FrameReceiver {
         this->logger_ = Logger::getLogger("FR.XspressListModeFrameDecoder");
         this->logger_->setLevel(Level::getAll());
         FrameDecoder::init(logger, config_msg);
+
+        // Check for the maximum number of packets received by each batched receive
+        if (config_msg.has_param(XspressListModeFrameDecoder::CONFIG_BATCH_PACKETS)) {
+          batch_packets_ = config_msg.get_param<unsigned int>(XspressListModeFrameDecoder::CONFIG_BATCH_PACKETS);
+          LOG4CXX_INFO(logger_, "Batched receive set to " << batch_packets_ << " packets");
+          batch_msgs_.resize(XSP_PACKETS_PER_FRAME);
+          batch_iovecs_.resize(XSP_PACKETS_PER_FRAME);
+          batch_addrs_.resize(XSP_PACKETS_PER_FRAME);
+        }
+
+        // Check for the number of packets received between batched receives without a backlog
+        if (config_msg.has_param(XspressListModeFrameDecoder::CONFIG_BATCH_INTERVAL)) {
+          batch_interval_ = std::max(1u, config_msg.get_param<unsigned int>(XspressListModeFrameDecoder::CONFIG_BATCH_INTERVAL));
+          LOG4CXX_INFO(logger_, "Batched receive interval set to " << batch_interval_ << " packets");
+        }
+
+        // Check for assembling frames per channel
+        if (config_msg.has_param(XspressListModeFrameDecoder::CONFIG_PER_CHANNEL_FRAMES)) {
+          per_channel_frames_ = config_msg.get_param<bool>(XspressListModeFrameDecoder::CONFIG_PER_CHANNEL_FRAMES);
+          LOG4CXX_INFO(logger_, "Per channel frame assembly " << (per_channel_frames_ ? "enabled" : "disabled"));
+          if (per_channel_frames_ && batch_packets_ > 0){
+            // The channel of a packet is only known once it has been received
+            LOG4CXX_WARN(logger_, "Batched receive is not used when frames are assembled per channel");
+          }
+        }
+        channel_frames_.clear();
+        active_channel_ = 0;
+
+        // Check for the mapping of packet sources to channels
+        if (config_msg.has_param(XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP)) {
+          configure_channel_map(config_msg.get_param<const rapidjson::Value&>(XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP));
+        }
+
+        // Connect an ACK socket to each card and start sending ACKs.  The sender thread
+        // uses the sockets without locking so it is stopped while they are replaced
+        stop_ack_sender();
+        open_ack_sockets();
+        start_ack_sender();
         LOG4CXX_INFO(logger_, "Xspress list mode frame decoder init complete");
         gettime(&init_time_);
   }
 
     void XspressListModeFrameDecoder::request_configuration(const std::string param_prefix, OdinData::IpcMessage& config_reply)
     {
+      // Call the base class method to populate parameters
+      FrameDecoder::request_configuration(param_prefix, config_reply);
+      config_reply.set_param(param_prefix + XspressListModeFrameDecoder::CONFIG_BATCH_PACKETS, batch_packets_);
+      config_reply.set_param(param_prefix + XspressListModeFrameDecoder::CONFIG_BATCH_INTERVAL, batch_interval_);
+      config_reply.set_param(param_prefix + XspressListModeFrameDecoder::CONFIG_PER_CHANNEL_FRAMES, per_channel_frames_);
+      for (size_t index = 0; index < channel_map_.size(); index++){
+        std::stringstream ss;
+        ss << param_prefix << XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP << "/" << index << "/";
+        struct in_addr address;
+        address.s_addr = channel_map_[index].address;
+        config_reply.set_param(ss.str() + XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_ADDRESS, std::string(inet_ntoa(address)));
+        config_reply.set_param(ss.str() + XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_PORT, (unsigned int)ntohs(channel_map_[index].port));
+        config_reply.set_param(ss.str() + XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_CHANNEL, channel_map_[index].first_channel);
+      }
+    }
+
+    /**
+     * Replace the packet source to channel table.  The configuration is a list
+     * of entries, each with the source address of a card, an optional source
+     * port and the system channel of the first channel of the card, e.g.
+     * [{"address": "192.168.0.66", "channel": 0}, {"address": "192.168.0.70", "port": 30125, "channel": 10}]
+     *
+     * \param[in] channel_map - list of channel map entries.
+     */
+    void XspressListModeFrameDecoder::configure_channel_map(const rapidjson::Value& channel_map)
+    {
+      if (!channel_map.IsArray()){
+        LOG4CXX_ERROR(logger_, "Channel map must be a list of entries, keeping the current channel map");
+        return;
+      }
+      channel_map_.clear();
+      last_channel_map_entry_ = 0;
+      for (rapidjson::SizeType index = 0; index < channel_map.Size(); index++){
+        const rapidjson::Value& entry = channel_map[index];
+        if (!entry.IsObject() ||
+            !entry.HasMember(XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_ADDRESS.c_str()) ||
+            !entry.HasMember(XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_CHANNEL.c_str())){
+          LOG4CXX_ERROR(logger_, "Channel map entry " << index << " must have an address and a channel, ignoring it");
+          continue;
+        }
+        uint16_t port = 0;
+        if (entry.HasMember(XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_PORT.c_str())){
+          port = entry[XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_PORT.c_str()].GetUint();
+        }
+        std::string address = entry[XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_ADDRESS.c_str()].GetString();
+        uint32_t first_channel = entry[XspressListModeFrameDecoder::CONFIG_CHANNEL_MAP_CHANNEL.c_str()].GetUint();
+        add_channel_map_entry(address, port, first_channel);
+        LOG4CXX_INFO(logger_, "Mapped packets from " << address << ":" << port << " to first channel " << first_channel);
+      }
+    }
+
+    /**
+     * Add an entry to the packet source to channel table.
+     *
+     * \param[in] address - source address of the card.
+     * \param[in] port - source port of the card, 0 for any port.
+     * \param[in] first_channel - system channel of the first channel of the card.
+     */
+    void XspressListModeFrameDecoder::add_channel_map_entry(const std::string& address, uint16_t port, uint32_t first_channel)
+    {
+      struct in_addr source;
+      if (inet_aton(address.c_str(), &source) == 0){
+        LOG4CXX_ERROR(logger_, "Invalid channel map address " << address << ", ignoring it");
+        return;
+      }
+      ChannelMapEntry entry;
+      entry.address = source.s_addr;
+      entry.port = htons(port);
+      entry.first_channel = first_channel;
+      channel_map_.push_back(entry);
+    }
+
+    /**
+     * Look up the channel map entry of the card that sent a packet.  Packets
+     * arrive in bursts from each card so the entry that matched the last
+     * packet is checked first.
+     *
+     * \param[in] from_addr - source address of the packet.
+     * \return index of the channel map entry, -1 if the source is not mapped.
+     */
+    int32_t XspressListModeFrameDecoder::find_channel_map_entry(const struct sockaddr_in* from_addr)
+    {
+      in_addr_t address = from_addr->sin_addr.s_addr;
+      in_port_t port = from_addr->sin_port;
+      size_t num_entries = channel_map_.size();
+      if (last_channel_map_entry_ < num_entries){
+        const ChannelMapEntry& last = channel_map_[last_channel_map_entry_];
+        if (last.address == address && (last.port == 0 || last.port == port)){
+          return last_channel_map_entry_;
+        }
+      }
+      for (size_t index = 0; index < num_entries; index++){
+        const ChannelMapEntry& entry = channel_map_[index];
+        if (entry.address == address && (entry.port == 0 || entry.port == port)){
+          last_channel_map_entry_ = index;
+          return index;
+        }
+      }
+      return -1;
+    }
+
+    /**
+     * Open a UDP socket connected to the ACK port of the card for each channel
+     * map entry, and an unconnected socket for ACKs to sources that are not in
+     * the channel map.  Any sockets already open are closed first.  Must only
+     * be called while the ACK sender thread is stopped.
+     */
+    void XspressListModeFrameDecoder::open_ack_sockets(void)
+    {
+      close_ack_sockets();
+      ack_sockets_.assign(channel_map_.size(), -1);
+      for (size_t index = 0; index < channel_map_.size(); index++){
+        struct sockaddr_in ack_address;
+        memset(&ack_address, 0, sizeof(ack_address));
+        ack_address.sin_family = AF_INET;
+        ack_address.sin_addr.s_addr = channel_map_[index].address;
+        ack_address.sin_port = htons(XSPRESS_ACK_PORT);
+
+        int ack_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (ack_socket < 0 || connect(ack_socket, (struct sockaddr *)&ack_address, sizeof(ack_address)) < 0){
+          LOG4CXX_ERROR(logger_, "Failed to open ACK socket to " << inet_ntoa(ack_address.sin_addr)
+                                 << ":" << XSPRESS_ACK_PORT << ": " << strerror(errno));
+          if (ack_socket >= 0){
+            close(ack_socket);
+          }
+          continue;
+        }
+        ack_sockets_[index] = ack_socket;
+        LOG4CXX_DEBUG_LEVEL(1, logger_, "Opened ACK socket to " << inet_ntoa(ack_address.sin_addr) << ":" << XSPRESS_ACK_PORT);
+      }
+      unmapped_ack_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    }
 
+    /**
+     * Close all ACK sockets.  Must only be called while the ACK sender thread
+     * is stopped.
+     */
+    void XspressListModeFrameDecoder::close_ack_sockets(void)
+    {
+      for (size_t index = 0; index < ack_sockets_.size(); index++){
+        if (ack_sockets_[index] >= 0){
+          close(ack_sockets_[index]);
+        }
+      }
+      ack_sockets_.clear();
+      if (unmapped_ack_socket_ >= 0){
+        close(unmapped_ack_socket_);
+        unmapped_ack_socket_ = -1;
+      }
+    }
+
+    /**
+     * Queue an ACK for an EOF packet to be sent by the ACK sender thread, so
+     * the RX thread never waits on ACK transmission.
+     *
+     * \param[in] entry - channel map entry of the card, -1 if not mapped.
+     * \param[in] from_addr - source address of the EOF packet.
+     * \param[in] frame - time frame number of the EOF packet.
+     * \param[in] chan_of_card - channel of the card the EOF packet was sent for.
+     * \param[in] channel - system channel the EOF packet was sent for.
+     */
+    void XspressListModeFrameDecoder::queue_ack(int32_t entry, const struct sockaddr_in* from_addr, uint32_t frame, uint32_t chan_of_card, uint32_t channel)
+    {
+      AckMessage ack;
+      ack.entry = entry;
+      ack.channel = channel;
+      ack.address = *from_addr;
+      ack.address.sin_port = htons(XSPRESS_ACK_PORT);
+      ack.data[0] = 0;
+      ack.data[1] = XSP_10GTX_SOF | XSP_10GTX_EOF; // Single packet frame
+      ack.data[2] = frame;
+      ack.data[3] = chan_of_card;
+      ack.data[4] = 0; // Dummy data sent with EOF
+      ack.data[5] = 0; // Dummy data sent with EOF
+      {
+        boost::lock_guard<boost::mutex> lock(ack_mutex_);
+        ack_queue_.push_back(ack);
+      }
+      ack_condition_.notify_one();
+    }
+
+    /**
+     * Start the ACK sender thread if it is not running.
+     */
+    void XspressListModeFrameDecoder::start_ack_sender(void)
+    {
+      if (!ack_thread_){
+        ack_running_ = true;
+        ack_thread_.reset(new boost::thread(&XspressListModeFrameDecoder::ack_sender_task, this));
+      }
+    }
+
+    /**
+     * Stop the ACK sender thread and wait for it to exit.  Any ACKs still
+     * queued are sent once the thread is started again.
+     */
+    void XspressListModeFrameDecoder::stop_ack_sender(void)
+    {
+      if (ack_thread_){
+        {
+          boost::lock_guard<boost::mutex> lock(ack_mutex_);
+          ack_running_ = false;
+        }
+        ack_condition_.notify_all();
+        ack_thread_->join();
+        ack_thread_.reset();
+      }
+    }
+
+    /**
+     * ACK sender thread.  Waits for ACKs queued by the RX thread and sends each
+     * to the ACK port of the card the EOF packet came from.  The hardware
+     * filters on the destination port, which is the same for all channels of
+     * a card.  The queue is swapped out under the lock and the ACKs are sent
+     * with it released, so the RX thread is only held up for the time taken
+     * to append an ACK.
+     */
+    void XspressListModeFrameDecoder::ack_sender_task(void)
+    {
+      std::deque<AckMessage> pending;
+      boost::unique_lock<boost::mutex> lock(ack_mutex_);
+      while (ack_running_){
+        if (ack_queue_.empty()){
+          ack_condition_.wait(lock);
+          continue;
+        }
+        pending.swap(ack_queue_);
+        lock.unlock();
+        while (!pending.empty()){
+          const AckMessage& ack = pending.front();
+          ssize_t sent = -1;
+          if (ack.entry >= 0 && (size_t)ack.entry < ack_sockets_.size() && ack_sockets_[ack.entry] >= 0){
+            sent = send(ack_sockets_[ack.entry], ack.data, sizeof(ack.data), 0);
+          } else if (unmapped_ack_socket_ >= 0){
+            sent = sendto(unmapped_ack_socket_, ack.data, sizeof(ack.data), 0,
+                          (const struct sockaddr *)&ack.address, sizeof(ack.address));
+          }
+          if (sent < 0){
+            LOG4CXX_ERROR(logger_, "Failed to send ACK for frame " << ack.data[2] << " channel " << ack.data[3]
+                                   << " to " << inet_ntoa(ack.address.sin_addr) << ": " << strerror(errno));
+          } else if (ack.channel < XSP_LIST_STATS_CHANNELS){
+            channel_stats_[ack.channel].acks_sent.fetch_add(1, boost::memory_order_relaxed);
+          }
+          pending.pop_front();
+        }
+        lock.lock();
+      }
     }
 
     const size_t XspressListModeFrameDecoder::get_frame_buffer_size(void) const
@@ -86,7 +398,60 @@ namespace FrameReceiver {
       return Xspress::packet_header_size;
     }
 
+    /**
+     * Called by the RX thread with the peeked header word of a packet when
+     * frames are assembled per channel.  The frame of the channel that sent
+     * the packet is swapped in, claiming a frame buffer if the channel has no
+     * current frame, so the payload is received into the next slot of that
+     * frame.
+     */
     void XspressListModeFrameDecoder::process_packet_header(size_t bytes_received, int port, struct sockaddr_in* from_addr)
+    {
+      if (!per_channel_frames_){
+        // Packet headers are not peeked, the frame buffer is claimed by get_packet_header_buffer
+        return;
+      }
+      int32_t entry = find_channel_map_entry(from_addr);
+      uint32_t channel = (entry < 0 ? 0 : channel_map_[entry].first_channel) + XSP_SOF_GET_CHAN(current_raw_packet_header_);
+      select_channel_frame(channel);
+      if (current_frame_buffer_id_ == -1){
+        claim_frame_buffer();
+      }
+      current_packet_buffer_ = get_packet_slot(current_frame_header_->packets_received);
+    }
+
+    /**
+     * Swap in the frame being assembled for a channel, saving the state of the
+     * frame of the previous channel.
+     *
+     * \param[in] channel - system channel of the packet.
+     */
+    void XspressListModeFrameDecoder::select_channel_frame(uint32_t channel)
+    {
+      if (channel == active_channel_ && !channel_frames_.empty()){
+        return;
+      }
+      if (!channel_frames_.empty()){
+        ChannelFrame& active = channel_frames_[active_channel_];
+        active.buffer_id = current_frame_buffer_id_;
+        active.buffer = current_frame_buffer_;
+        active.frame_number = current_frame_number_;
+        active.dropping = dropping_frame_data_;
+      }
+      if (channel >= channel_frames_.size()){
+        ChannelFrame empty = {-1, NULL, 0, false};
+        channel_frames_.resize(channel + 1, empty);
+      }
+      ChannelFrame& selected = channel_frames_[channel];
+      current_frame_buffer_id_ = selected.buffer_id;
+      current_frame_buffer_ = selected.buffer;
+      current_frame_header_ = reinterpret_cast<Xspress::ListFrameHeader*>(current_frame_buffer_);
+      current_frame_number_ = selected.frame_number;
+      dropping_frame_data_ = selected.dropping;
+      active_channel_ = channel;
+    }
+
+    void XspressListModeFrameDecoder::claim_frame_buffer(void)
     {
       if (initialising_){
         // For the initialisation duration ignore incoming spurious packets to allow time for the FP 
@@ -106,9 +471,8 @@ namespace FrameReceiver {
         if (empty_buffer_queue_.empty() || initialising_){
           current_frame_buffer_ = dropped_frame_buffer_.get();
           if (!dropping_frame_data_){
-            uint64_t *lptr = (uint64_t *)get_packet_header_buffer();
             if (!initialising_){
-              LOG4CXX_ERROR(logger_, "Time Frame: " << XSP_SOF_GET_FRAME(*lptr) << " received but no free buffers available. Dropping packet");
+              LOG4CXX_ERROR(logger_, "Packet received but no free buffers available. Dropping packets");
             }
             dropping_frame_data_ = true;
           }
@@ -125,70 +489,77 @@ namespace FrameReceiver {
         // Initialise frame header
         current_frame_header_ = reinterpret_cast<Xspress::ListFrameHeader*>(current_frame_buffer_);
         current_frame_header_->packets_received = 0;
+        current_frame_header_->channel = per_channel_frames_ ? active_channel_ : XSP_LIST_MIXED_CHANNELS;
       }
     }
 
-    void* XspressListModeFrameDecoder::get_next_payload_buffer(void) const
+    /**
+     * Address of a packet slot in the current frame.  Each slot holds the
+     * packet header word followed by the packet payload.
+     */
+    uint8_t* XspressListModeFrameDecoder::get_packet_slot(uint32_t packet) const
     {
-      uint8_t* next_receive_location =
-        reinterpret_cast<uint8_t*>(current_frame_buffer_)
+      return reinterpret_cast<uint8_t*>(current_frame_buffer_)
         + get_frame_header_size()
-        + (get_next_payload_size() * current_frame_header_->packets_received)
-        + get_packet_header_size();
+        + (Xspress::xspress_packet_size * packet);
+    }
 
-      return reinterpret_cast<void*>(next_receive_location);
+    void* XspressListModeFrameDecoder::get_next_payload_buffer(void) const
+    {
+      return reinterpret_cast<void*>(get_packet_slot(current_frame_header_->packets_received) + get_packet_header_size());
     }
 
     size_t XspressListModeFrameDecoder::get_next_payload_size(void) const
     {
-      return Xspress::xspress_packet_size;
+      // The header word and payload of a packet together fill one slot
+      return Xspress::xspress_packet_size - get_packet_header_size();
     }
 
     FrameDecoder::FrameReceiveState XspressListModeFrameDecoder::process_packet(size_t bytes_received, int port, struct sockaddr_in* from_addr)
+    {
+      if (per_channel_frames_){
+        // The header word was received separately to find the channel frame
+        memcpy(current_packet_buffer_, &current_raw_packet_header_, get_packet_header_size());
+        return process_packet_data(current_packet_buffer_, bytes_received, port, from_addr);
+      }
+      FrameDecoder::FrameReceiveState frame_state = process_packet_data(current_packet_buffer_, bytes_received, port, from_addr);
+      if (batch_packets_ > 0){
+        // Receive any further packets waiting on the socket in one call.  This is only tried
+        // while the last batch filled up, or every batch_interval packets, so that a socket
+        // that is usually empty does not cost an extra call for every packet
+        std::map<int, ReceiveSocket>::iterator iter = receive_sockets_.find(port);
+        if (iter != receive_sockets_.end()){
+          ReceiveSocket& receive = iter->second;
+          receive.packets++;
+          if (receive.backlog || receive.packets >= batch_interval_){
+            frame_state = receive_batch(receive, port, frame_state);
+          }
+        }
+      }
+      return frame_state;
+    }
+
+    /**
+     * Process a packet that has been received into its slot in the current frame.
+     */
+    FrameDecoder::FrameReceiveState XspressListModeFrameDecoder::process_packet_data(uint8_t* packet, size_t bytes_received, int port, struct sockaddr_in* from_addr)
     {
       FrameDecoder::FrameReceiveState frame_state = FrameDecoder::FrameReceiveStateIncomplete;
       bool end_of_frame = false;
-      uint64_t *lptr = (uint64_t *)get_packet_header_buffer();
+      uint64_t *lptr = (uint64_t *)packet;
       uint64_t chan_of_card = XSP_SOF_GET_CHAN(*lptr);
-      char *ip = inet_ntoa(from_addr->sin_addr);
-      std::string str_ip(ip);
-      uint64_t channel = channel_map_[str_ip] + chan_of_card;
-
-      // We need to copy the 2 word packet header into the frame at the correct location
-      uint8_t* packet_header_location = reinterpret_cast<uint8_t*>(current_frame_buffer_)
-                                  			+ get_frame_header_size()
-			                                  + (get_next_payload_size() * current_frame_header_->packets_received);
-      memcpy(packet_header_location, get_packet_header_buffer(), get_packet_header_size());
+      int32_t entry = find_channel_map_entry(from_addr);
+      uint64_t channel = (entry < 0 ? 0 : channel_map_[entry].first_channel) + chan_of_card;
 
       if (*lptr & XSP_MASK_END_OF_FRAME){
         // Acknowledge packet to send if get a end of frame marker.
         end_of_frame = true;
-        uint32_t tbuff[XSPRESS_ACK_SIZE];
-        tbuff[0] = 0;
-        tbuff[1] = XSP_10GTX_SOF | XSP_10GTX_EOF; // Single packet frame
-        tbuff[2] = XSP_SOF_GET_FRAME(*lptr); // Frame
-        tbuff[3] = chan_of_card;
-        tbuff[4] = 0; // Dummy data sent with EOF
-        tbuff[5] = 0; // Dummy data sent with EOF
-        LOG4CXX_DEBUG_LEVEL(1, logger_, "Sending ack for channel: " << chan_of_card << " socket: " << ip << ":" << port);
-
-        // If the reply socket has not been created yet then do so now
-        if (server_socket_ == 0){
-          server_address_.sin_family = AF_INET;
-          (server_address_.sin_addr).s_addr = inet_addr(ip);
-          server_address_.sin_port = htons(XSPRESS_ACK_PORT);
-
-          socklen_t addr_size = sizeof(server_address_);
-
-          server_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-          connect(server_socket_, (struct sockaddr *)&server_address_, addr_size);
-        }
-        // Send ack to ACK_PORT, same address EOF packet came from.
-        // Hardware set to filter on destination port which is the same on the FEM for all channels.
-        write(server_socket_, tbuff, sizeof(u_int32_t)*XSPRESS_ACK_SIZE);
+        LOG4CXX_DEBUG_LEVEL(1, logger_, "Sending ack for channel: " << chan_of_card << " socket: " << inet_ntoa(from_addr->sin_addr) << ":" << port);
+        queue_ack(entry, from_addr, XSP_SOF_GET_FRAME(*lptr), chan_of_card, channel);
       }
+      update_statistics(channel, *lptr, bytes_received);
 
-      LOG4CXX_DEBUG_LEVEL(3, logger_, "Packet => channel_of_card: " << chan_of_card << " channel: " << channel << " socket: " << ip << ":" << port);
+      LOG4CXX_DEBUG_LEVEL(3, logger_, "Packet => channel_of_card: " << chan_of_card << " channel: " << channel << " socket: " << inet_ntoa(from_addr->sin_addr) << ":" << port);
       // Set the size of the packet in the frame header
       current_frame_header_->packet_headers[current_frame_header_->packets_received].packet_size = bytes_received;
       // Set the channel number in the frame header
@@ -214,24 +585,220 @@ namespace FrameReceiver {
       return frame_state;
     }
 
-    void XspressListModeFrameDecoder::monitor_buffers(void)
+    /**
+     * Record a packet in the statistics of its channel.  Gaps are counted when
+     * the header frame number of a channel skips forward.  A frame number that
+     * goes backwards is taken as the start of a new acquisition.  Packets
+     * ignored during the initialisation time are counted as discarded rather
+     * than dropped.
+     *
+     * \param[in] channel - system channel of the packet.
+     * \param[in] header - header word of the packet.
+     * \param[in] bytes_received - size of the packet.
+     */
+    void XspressListModeFrameDecoder::update_statistics(uint32_t channel, uint64_t header, size_t bytes_received)
     {
+      if (channel >= XSP_LIST_STATS_CHANNELS){
+        return;
+      }
+      ChannelStatistics& stats = channel_stats_[channel];
+      stats.packets.fetch_add(1, boost::memory_order_relaxed);
+      stats.bytes.fetch_add(bytes_received, boost::memory_order_relaxed);
+      if (header & XSP_MASK_END_OF_FRAME){
+        stats.eofs.fetch_add(1, boost::memory_order_relaxed);
+      }
+      if (dropping_frame_data_ && initialising_){
+        // Spurious packets ignored while the frame processors start up are not lost, and
+        // their frame numbers are not used to look for gaps
+        stats.discarded.fetch_add(1, boost::memory_order_relaxed);
+        return;
+      }
+      if (dropping_frame_data_){
+        stats.dropped.fetch_add(1, boost::memory_order_relaxed);
+      }
+
+      uint32_t frame = XSP_SOF_GET_FRAME(header);
+      uint32_t last_frame = last_header_frame_[channel];
+      if (last_frame != XSP_LIST_NO_FRAME && frame > last_frame + 1){
+        stats.frame_gaps.fetch_add(frame - last_frame - 1, boost::memory_order_relaxed);
+        LOG4CXX_DEBUG_LEVEL(1, logger_, "Channel " << channel << " header frame jumped from " << last_frame << " to " << frame);
+      }
+      last_header_frame_[channel] = frame;
 
+      if (channel >= stats_channels_.load(boost::memory_order_relaxed)){
+        stats_channels_.store(channel + 1, boost::memory_order_relaxed);
+      }
     }
 
-    void XspressListModeFrameDecoder::get_status(const std::string param_prefix, OdinData::IpcMessage& status_msg)
+    void XspressListModeFrameDecoder::monitor_buffers(void)
     {
+      uint64_t dropped = 0;
+      uint64_t frame_gaps = 0;
+      uint32_t num_channels = stats_channels_.load(boost::memory_order_relaxed);
+      for (uint32_t channel = 0; channel < num_channels; channel++){
+        dropped += channel_stats_[channel].dropped.load(boost::memory_order_relaxed);
+        frame_gaps += channel_stats_[channel].frame_gaps.load(boost::memory_order_relaxed);
+      }
+      if (dropped > monitor_dropped_ || frame_gaps > monitor_frame_gaps_){
+        LOG4CXX_WARN(logger_, "List mode packets lost, dropped for no buffer: " << (dropped - monitor_dropped_)
+                              << " missing time frames: " << (frame_gaps - monitor_frame_gaps_));
+      }
+      monitor_dropped_ = dropped;
+      monitor_frame_gaps_ = frame_gaps;
+      LOG4CXX_DEBUG_LEVEL(1, logger_, "Empty: " << empty_buffer_queue_.size() << " Dropped: " << dropped << " Gaps: " << frame_gaps);
+    }
 
+    void XspressListModeFrameDecoder::get_status(const std::string param_prefix, OdinData::IpcMessage& status_msg)
+    {
+      status_msg.set_param(param_prefix + "name", std::string("XspressListModeFrameDecoder"));
+      uint64_t dropped = 0;
+      uint64_t frame_gaps = 0;
+      uint32_t num_channels = stats_channels_.load(boost::memory_order_relaxed);
+      for (uint32_t channel = 0; channel < num_channels; channel++){
+        ChannelStatistics& stats = channel_stats_[channel];
+        uint64_t packets = stats.packets.load(boost::memory_order_relaxed);
+        if (packets == 0){
+          continue;
+        }
+        std::stringstream ss;
+        ss << param_prefix << "channels/" << channel << "/";
+        status_msg.set_param(ss.str() + "packets", packets);
+        status_msg.set_param(ss.str() + "bytes", stats.bytes.load(boost::memory_order_relaxed));
+        status_msg.set_param(ss.str() + "dropped", stats.dropped.load(boost::memory_order_relaxed));
+        status_msg.set_param(ss.str() + "discarded", stats.discarded.load(boost::memory_order_relaxed));
+        status_msg.set_param(ss.str() + "frame_gaps", stats.frame_gaps.load(boost::memory_order_relaxed));
+        status_msg.set_param(ss.str() + "eofs", stats.eofs.load(boost::memory_order_relaxed));
+        status_msg.set_param(ss.str() + "acks_sent", stats.acks_sent.load(boost::memory_order_relaxed));
+        dropped += stats.dropped.load(boost::memory_order_relaxed);
+        frame_gaps += stats.frame_gaps.load(boost::memory_order_relaxed);
+      }
+      status_msg.set_param(param_prefix + "packets_dropped", dropped);
+      status_msg.set_param(param_prefix + "frame_gaps", frame_gaps);
     }
 
+    /**
+     * Zero the statistics of every channel.  The last header frame number of
+     * each channel is kept, it is only used by the RX thread.
+     */
     void XspressListModeFrameDecoder::reset_statistics(void)
     {
-
+      for (uint32_t channel = 0; channel < XSP_LIST_STATS_CHANNELS; channel++){
+        ChannelStatistics& stats = channel_stats_[channel];
+        stats.packets.store(0, boost::memory_order_relaxed);
+        stats.bytes.store(0, boost::memory_order_relaxed);
+        stats.dropped.store(0, boost::memory_order_relaxed);
+        stats.discarded.store(0, boost::memory_order_relaxed);
+        stats.frame_gaps.store(0, boost::memory_order_relaxed);
+        stats.eofs.store(0, boost::memory_order_relaxed);
+        stats.acks_sent.store(0, boost::memory_order_relaxed);
+      }
+      monitor_dropped_ = 0;
+      monitor_frame_gaps_ = 0;
     }
 
+    /**
+     * Called by the RX thread before each packet is received.  The packet is
+     * received straight into the next free slot of the current frame, so a
+     * frame buffer is claimed first if there is no current frame.
+     */
     void* XspressListModeFrameDecoder::get_packet_header_buffer(void)
     {
-      return current_raw_packet_header_.get();
+      if (per_channel_frames_){
+        // The header word is peeked to find the channel frame before the payload is received
+        return reinterpret_cast<void*>(&current_raw_packet_header_);
+      }
+      if (current_frame_buffer_id_ == -1){
+        claim_frame_buffer();
+      }
+      current_packet_buffer_ = get_packet_slot(current_frame_header_->packets_received);
+      return current_packet_buffer_;
+    }
+
+    /**
+     * Receive the packets already waiting on the socket for a port with a
+     * single recvmmsg call, scattering each packet straight into the next free
+     * slot of the current frame.  Packets received into the slots of a frame
+     * that is completed earlier in the same batch are moved into the next
+     * frame.  Dropped packets are received one at a time into the dropped
+     * frame buffer.  The socket is recorded as having a backlog if every
+     * packet of the batch was received.
+     *
+     * \param[in] receive - receive socket of the port.
+     * \param[in] port - port the packets are received on.
+     * \param[in] frame_state - state of the frame after the last packet.
+     * \return state of the frame after the last packet received.
+     */
+    FrameDecoder::FrameReceiveState XspressListModeFrameDecoder::receive_batch(ReceiveSocket& receive, int port, FrameDecoder::FrameReceiveState frame_state)
+    {
+      uint32_t remaining = batch_packets_;
+      while (remaining > 0){
+        if (current_frame_buffer_id_ == -1){
+          claim_frame_buffer();
+        }
+        uint32_t first_packet = current_frame_header_->packets_received;
+        uint32_t num_packets = dropping_frame_data_ ? 1 : (XSP_PACKETS_PER_FRAME - first_packet);
+        num_packets = std::min(num_packets, remaining);
+        uint8_t* receive_frame = reinterpret_cast<uint8_t*>(current_frame_buffer_);
+
+        for (uint32_t index = 0; index < num_packets; index++){
+          batch_iovecs_[index].iov_base = get_packet_slot(first_packet + index);
+          batch_iovecs_[index].iov_len = Xspress::xspress_packet_size;
+          memset(&batch_msgs_[index].msg_hdr, 0, sizeof(struct msghdr));
+          batch_msgs_[index].msg_hdr.msg_iov = &batch_iovecs_[index];
+          batch_msgs_[index].msg_hdr.msg_iovlen = 1;
+          batch_msgs_[index].msg_hdr.msg_name = &batch_addrs_[index];
+          batch_msgs_[index].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+        int received = recvmmsg(receive.socket, &batch_msgs_[0], num_packets, MSG_DONTWAIT, NULL);
+        if (received <= 0){
+          break;
+        }
+
+        for (int index = 0; index < received; index++){
+          uint8_t* packet = reinterpret_cast<uint8_t*>(batch_iovecs_[index].iov_base);
+          size_t bytes_received = batch_msgs_[index].msg_len;
+          if (reinterpret_cast<uint8_t*>(current_frame_buffer_) != receive_frame || current_frame_buffer_id_ == -1){
+            // The frame was completed by an earlier packet of the batch
+            if (current_frame_buffer_id_ == -1){
+              claim_frame_buffer();
+            }
+            uint8_t* slot = get_packet_slot(current_frame_header_->packets_received);
+            memcpy(slot, packet, bytes_received);
+            packet = slot;
+          }
+          frame_state = process_packet_data(packet, bytes_received, port, &batch_addrs_[index]);
+        }
+        remaining -= received;
+        if ((uint32_t)received < num_packets){
+          // The socket has been drained
+          break;
+        }
+      }
+      receive.backlog = (remaining == 0);
+      receive.packets = 0;
+      return frame_state;
+    }
+
+    /**
+     * Set the socket the RX thread receives on for a port.  Batched receives
+     * are only made on sockets set here, as the RX thread owns the sockets and
+     * only reports the port with each packet.
+     *
+     * \param[in] port - port the socket is bound to.
+     * \param[in] receive_socket - the socket, or -1 to disable batched receives on the port.
+     */
+    void XspressListModeFrameDecoder::set_receive_socket(int port, int receive_socket)
+    {
+      if (receive_socket < 0){
+        receive_sockets_.erase(port);
+        return;
+      }
+      ReceiveSocket receive;
+      receive.socket = receive_socket;
+      receive.backlog = false;
+      receive.packets = 0;
+      receive_sockets_[port] = receive;
+      LOG4CXX_INFO(logger_, "Batched receive of up to " << batch_packets_ << " packets enabled on port " << port);
     }
 
 }
@@ -0,0 +1,285 @@
+/**
+ * XspressListModeGenerator.h
+ *
+ * Software list-mode event stream generator.  Produces correctly encoded
+ * Xspress 4 list-mode UDP packets and X3X2 16-bit field TCP frames so that
+ * the list-mode frame receivers and processors can be exercised and their
+ * throughput measured on localhost without any hardware.
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#ifndef XspressListModeGenerator_H_
+#define XspressListModeGenerator_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include <boost/atomic.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include <log4cxx/logger.h>
+
+// Clock period used for event times (80 MHz)
+#define LIST_CLOCK_PERIOD 12.5e-9
+
+// Port on the card that list-mode acknowledgements are sent to
+#define LIST_ACK_PORT 30124
+// Size of an acknowledgement packet (32 bit words)
+#define LIST_ACK_SIZE 6
+
+// Maximum number of channels addressed by a single card (4 bit channel field)
+#define LIST_MAX_CHANNELS_PER_CARD 16
+
+// Xspress 4 event words.  Each packet starts with the SOF header word and is
+// followed by one 64 bit word for each event, holding the event height, the
+// time of the event in clock ticks from the start of the time frame and the
+// event flags.  The channel sits in the same bits as in the header word.
+#define LIST_EVENT_SET_HEIGHT(x)    (((uint64_t)(x)&0xFFFF)<<0)
+#define LIST_EVENT_SET_TIME(x)      (((uint64_t)(x)&0xFFFFFFFF)<<16)
+#define LIST_EVENT_MASK_RESET       ((uint64_t)1<<56)
+#define LIST_EVENT_MASK_MARKER      ((uint64_t)1<<57)
+#define LIST_EVENT_SET_CHAN(x)      (((uint64_t)(x)&0xF)<<60)
+
+// X3X2 16 bit fields, a 4 bit field id followed by a 12 bit value
+#define X3X2_FIELD(id, value)       ((uint16_t)((((id)&0xF)<<12) | ((value)&0xFFF)))
+#define X3X2_FIELD_HEIGHT           0
+#define X3X2_FIELD_ACQUISITION      1
+#define X3X2_FIELD_TIME_FRAME_0     4
+#define X3X2_FIELD_TIME_FRAME_1     5
+#define X3X2_FIELD_TIME_FRAME_2     6
+#define X3X2_FIELD_TIME_FRAME_3     7
+#define X3X2_FIELD_TIME_FRAME_4     8
+#define X3X2_FIELD_CHANNEL          9
+#define X3X2_FIELD_TIME_STAMP_0     10
+#define X3X2_FIELD_TIME_STAMP_1     11
+#define X3X2_FIELD_TIME_STAMP_2     12
+#define X3X2_FIELD_TIME_STAMP_3     13
+#define X3X2_FIELD_RESET            14
+#define X3X2_FIELD_PAD              15
+#define X3X2_FIELD_IDS              16
+#define X3X2_FLAG_END_OF_FRAME      0x1
+#define X3X2_FLAG_TTL_A             0x2
+#define X3X2_FLAG_TTL_B             0x4
+#define X3X2_FLAG_DUMMY             0x8
+// Most fields written for a single event, the full state followed by the height
+#define X3X2_MAX_EVENT_FIELDS       12
+
+namespace FrameSimulator
+{
+
+/**
+ * Type of a generated list-mode event.
+ */
+typedef enum
+{
+  LIST_EVENT_HEIGHT = 0,
+  LIST_EVENT_RESET,
+  LIST_EVENT_MARKER
+} ListModeEventType;
+
+/**
+ * A single generated event.
+ */
+typedef struct
+{
+  /** Time of the event in clock ticks from the start of the time frame */
+  uint32_t time;
+  /** System channel of the event, marker channels follow the detector channels */
+  uint16_t channel;
+  /** Event height, or the reset width for a reset event */
+  uint16_t height;
+  /** Type of the event */
+  ListModeEventType type;
+} ListModeEvent;
+
+/**
+ * Parameters of the generated event stream.
+ */
+typedef struct
+{
+  /** Number of detector channels */
+  uint32_t num_channels;
+  /** Event rate for each detector channel (events/s) */
+  std::vector<double> rates;
+  /** Number of marker channels */
+  uint32_t marker_channels;
+  /** Marker rate on each marker channel (markers/s) */
+  double marker_rate;
+  /** Rate of preamplifier resets on each detector channel (resets/s) */
+  double reset_rate;
+  /** Width of each reset, during which no events are recorded (clock ticks) */
+  uint32_t reset_ticks;
+  /** Duration of each time frame (s) */
+  double frame_time;
+  /** Number of time frames generated before the stream repeats */
+  uint32_t template_frames;
+  /** Seed for the random number generator */
+  uint32_t seed;
+} ListModeGeneratorConfig;
+
+/**
+ * Statistics recorded by a sender for a single card.
+ */
+typedef struct
+{
+  uint64_t frames;
+  uint64_t packets;
+  uint64_t bytes;
+  uint64_t events;
+  uint64_t acks;
+  uint64_t ack_timeouts;
+  uint64_t send_errors;
+  /** Times the first and last time frames started and finished sending (ns) */
+  uint64_t start_ns;
+  uint64_t end_ns;
+} ListModeSenderStats;
+
+/**
+ * The XspressListModeEventSource class generates the events for a ring of
+ * template time frames.  Events on each detector channel arrive as a Poisson
+ * process at the configured rate, with heights drawn from a pair of emission
+ * lines on a flat background.  Resets interrupt the stream for the reset width
+ * and marker channels emit evenly spaced marker events.  The events for each
+ * frame are held in time order across all channels so that every encoder can
+ * read the same stream.
+ */
+class XspressListModeEventSource
+{
+public:
+  XspressListModeEventSource(const ListModeGeneratorConfig& config);
+  virtual ~XspressListModeEventSource();
+  void generate();
+  const std::vector<ListModeEvent>& frame_events(uint64_t frame) const;
+  uint32_t get_frame_ticks() const;
+  uint32_t get_total_channels() const;
+  const ListModeGeneratorConfig& get_config() const;
+  uint64_t get_template_events() const;
+
+private:
+  uint16_t event_height(boost::random::mt19937& rng);
+
+  /** Pointer to the logging facility */
+  log4cxx::LoggerPtr                        logger_;
+  /** Stream parameters */
+  ListModeGeneratorConfig                   config_;
+  /** Duration of each time frame in clock ticks */
+  uint32_t                                  frame_ticks_;
+  /** Time ordered events for each template frame */
+  std::vector<std::vector<ListModeEvent> >  frames_;
+};
+
+/**
+ * The XspressListModeUDPSender class sends the event stream for a single
+ * Xspress 4 card as list-mode UDP packets.  Each channel of the card sends
+ * its events for a time frame as a sequence of packets of at most
+ * XSPRESS_RX_BUFF_LWORDS 64 bit words, each starting with the SOF header
+ * word, with the end of frame marker set in the header word of the last
+ * packet.  The packets are encoded once for each template frame and only the
+ * frame number in the header words is patched as the stream repeats.
+ */
+class XspressListModeUDPSender
+{
+public:
+  XspressListModeUDPSender(const XspressListModeEventSource& source,
+                           uint32_t card,
+                           uint32_t channels_per_card,
+                           const std::string& card_address,
+                           const std::string& destination_address,
+                           uint16_t destination_port);
+  virtual ~XspressListModeUDPSender();
+  bool open(bool wait_ack);
+  void run(uint64_t num_frames,
+           bool realtime,
+           double ack_timeout,
+           boost::atomic<bool> *running);
+  const ListModeSenderStats& get_stats() const;
+
+private:
+  void encode();
+  bool wait_for_acks(uint32_t frame, uint32_t expected, double timeout);
+
+  /** Pointer to the logging facility */
+  log4cxx::LoggerPtr                                  logger_;
+  /** Source of the events */
+  const XspressListModeEventSource&                   source_;
+  /** Card index and the system channels it sends */
+  uint32_t                                            card_;
+  uint32_t                                            first_channel_;
+  uint32_t                                            num_channels_;
+  /** Addresses used by the card */
+  std::string                                         card_address_;
+  struct sockaddr_in                                  destination_;
+  /** Data and acknowledgement sockets */
+  int                                                 data_socket_;
+  int                                                 ack_socket_;
+  /** Encoded packets [template frame][channel of card][packet][word] */
+  std::vector<std::vector<std::vector<std::vector<uint64_t> > > > packets_;
+  /** Statistics */
+  ListModeSenderStats                                 stats_;
+};
+
+/**
+ * The X3X2ListModeTCPSender class sends the event stream for a single X3X2
+ * card as fixed size TCP frames of X3X2_MINI_FIELDS_PER_FRAME 16 bit fields.
+ * Fields are only written when their value changes, except at the start of
+ * each TCP frame where the full event state is written again as the decoder
+ * does not carry it across frames.  Unused fields are padded.  Marker events
+ * are written in TCP frames of their own as the processor discards any frame
+ * containing a channel it is not configured for.
+ */
+class X3X2ListModeTCPSender
+{
+public:
+  X3X2ListModeTCPSender(const XspressListModeEventSource& source,
+                        uint32_t card,
+                        uint32_t channels_per_card,
+                        const std::string& listen_address,
+                        uint16_t listen_port,
+                        uint16_t acquisition_number);
+  virtual ~X3X2ListModeTCPSender();
+  bool open(double accept_timeout);
+  void run(uint64_t num_frames,
+           bool realtime,
+           boost::atomic<bool> *running);
+  const ListModeSenderStats& get_stats() const;
+
+private:
+  void write_field(uint32_t id, uint32_t value);
+  void write_state(uint64_t time_frame, uint32_t flags, uint32_t chan_of_card, uint64_t time_stamp);
+  void complete_tcp_frame();
+  bool send_tcp_frames();
+
+  /** Pointer to the logging facility */
+  log4cxx::LoggerPtr                  logger_;
+  /** Source of the events */
+  const XspressListModeEventSource&   source_;
+  /** Card index and the system channels it sends */
+  uint32_t                            card_;
+  uint32_t                            first_channel_;
+  uint32_t                            num_channels_;
+  /** Address and port listened on for the frame receiver */
+  std::string                         listen_address_;
+  uint16_t                            listen_port_;
+  /** Acquisition number written at the start of every TCP frame */
+  uint16_t                            acquisition_number_;
+  /** Listening and connected sockets */
+  int                                 listen_socket_;
+  int                                 data_socket_;
+  /** Complete TCP frames waiting to be sent followed by the partial frame */
+  std::vector<uint16_t>               fields_;
+  /** Number of fields in the partial frame */
+  uint32_t                            frame_fields_;
+  /** Last value written for each field id in the partial frame (-1 if not written) */
+  int32_t                             last_value_[X3X2_FIELD_IDS];
+  /** Statistics */
+  ListModeSenderStats                 stats_;
+};
+
+} /* namespace FrameSimulator */
+
+#endif /* XspressListModeGenerator_H_ */
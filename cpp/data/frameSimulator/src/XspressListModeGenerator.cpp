@@ -0,0 +1,693 @@
+/**
+ * XspressListModeGenerator.cpp
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cmath>
+
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/exponential_distribution.hpp>
+#include <boost/thread.hpp>
+
+#include "XspressListModeGenerator.h"
+#include "XspressDefinitions.h"
+#include "X3X2Definitions.h"
+#include "DebugLevelLogger.h"
+
+// Size requested for the socket send buffers
+#define LIST_SOCKET_BUFFER_SIZE (8*1024*1024)
+
+namespace FrameSimulator
+{
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/** Sleep until the end of a time frame when pacing the stream in real time.
+ *
+ * \param[in] start_ns - time the first time frame started (ns).
+ * \param[in] frame - time frame that is about to be sent.
+ * \param[in] frame_time - duration of each time frame (s).
+ */
+static void wait_for_frame(uint64_t start_ns, uint64_t frame, double frame_time)
+{
+  uint64_t due_ns = start_ns + (uint64_t)((double)(frame + 1) * frame_time * 1000000000.0);
+  uint64_t now_ns = monotonic_ns();
+  if (due_ns > now_ns){
+    struct timespec ts;
+    ts.tv_sec = (due_ns - now_ns) / 1000000000;
+    ts.tv_nsec = (due_ns - now_ns) % 1000000000;
+    nanosleep(&ts, NULL);
+  }
+}
+
+static bool event_before(const ListModeEvent& a, const ListModeEvent& b)
+{
+  if (a.time != b.time){
+    return a.time < b.time;
+  }
+  return a.channel < b.channel;
+}
+
+static void clear_stats(ListModeSenderStats& stats)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+XspressListModeEventSource::XspressListModeEventSource(const ListModeGeneratorConfig& config) :
+  logger_(log4cxx::Logger::getLogger("Xspress.ListModeGenerator")),
+  config_(config),
+  frame_ticks_(0)
+{
+  frame_ticks_ = (uint32_t)std::max(1.0, std::floor(config_.frame_time / LIST_CLOCK_PERIOD + 0.5));
+  if (config_.template_frames == 0){
+    config_.template_frames = 1;
+  }
+}
+
+XspressListModeEventSource::~XspressListModeEventSource()
+{
+}
+
+/** Generate the events for every template frame.
+ *
+ * Each detector channel is simulated over the whole ring of template frames
+ * so that resets and the dead time following them carry over from one frame
+ * to the next.
+ */
+void XspressListModeEventSource::generate()
+{
+  boost::random::mt19937 rng(config_.seed);
+  uint64_t total_ticks = (uint64_t)frame_ticks_ * config_.template_frames;
+  frames_.assign(config_.template_frames, std::vector<ListModeEvent>());
+
+  for (uint32_t channel = 0; channel < config_.num_channels; channel++){
+    double rate = config_.rates.empty() ? 0.0 : config_.rates[std::min((size_t)channel, config_.rates.size() - 1)];
+    double event_lambda = rate * LIST_CLOCK_PERIOD;
+    double reset_lambda = config_.reset_rate * LIST_CLOCK_PERIOD;
+    if (event_lambda <= 0.0 && reset_lambda <= 0.0){
+      continue;
+    }
+    boost::random::exponential_distribution<double> event_gap(event_lambda > 0.0 ? event_lambda : 1.0);
+    boost::random::exponential_distribution<double> reset_gap(reset_lambda > 0.0 ? reset_lambda : 1.0);
+    double next_event = event_lambda > 0.0 ? event_gap(rng) : (double)total_ticks;
+    double next_reset = reset_lambda > 0.0 ? reset_gap(rng) : (double)total_ticks;
+
+    while (next_event < (double)total_ticks || next_reset < (double)total_ticks){
+      ListModeEvent event;
+      event.channel = channel;
+      uint64_t ticks;
+      if (next_reset <= next_event){
+        ticks = (uint64_t)next_reset;
+        event.type = LIST_EVENT_RESET;
+        event.height = (uint16_t)std::min(config_.reset_ticks, (uint32_t)0xFFFF);
+        // No events are recorded while the channel is in reset
+        double resume = next_reset + config_.reset_ticks;
+        if (event_lambda > 0.0 && next_event < resume){
+          next_event = resume + event_gap(rng);
+        }
+        next_reset = resume + (reset_lambda > 0.0 ? reset_gap(rng) : (double)total_ticks);
+      } else {
+        ticks = (uint64_t)next_event;
+        event.type = LIST_EVENT_HEIGHT;
+        event.height = event_height(rng);
+        next_event += event_gap(rng);
+      }
+      event.time = (uint32_t)(ticks % frame_ticks_);
+      frames_[ticks / frame_ticks_].push_back(event);
+    }
+  }
+
+  if (config_.marker_rate > 0.0){
+    double spacing = 1.0 / (config_.marker_rate * LIST_CLOCK_PERIOD);
+    for (uint32_t marker = 0; marker < config_.marker_channels; marker++){
+      // Stagger the marker channels across the marker period
+      double ticks = spacing * (marker + 1) / (config_.marker_channels + 1);
+      while (ticks < (double)total_ticks){
+        ListModeEvent event;
+        event.channel = config_.num_channels + marker;
+        event.type = LIST_EVENT_MARKER;
+        event.height = 0;
+        event.time = (uint32_t)((uint64_t)ticks % frame_ticks_);
+        frames_[(uint64_t)ticks / frame_ticks_].push_back(event);
+        ticks += spacing;
+      }
+    }
+  }
+
+  for (uint32_t frame = 0; frame < frames_.size(); frame++){
+    std::sort(frames_[frame].begin(), frames_[frame].end(), event_before);
+  }
+  LOG4CXX_INFO(logger_, "Generated " << get_template_events() << " events across "
+      << config_.template_frames << " template frames of " << frame_ticks_ << " clock ticks");
+}
+
+/** Draw an event height from a pair of emission lines on a flat background.
+ *
+ * Heights are restricted to 12 bits so that they can be encoded by every card.
+ */
+uint16_t XspressListModeEventSource::event_height(boost::random::mt19937& rng)
+{
+  boost::random::uniform_real_distribution<double> unit(0.0, 1.0);
+  boost::random::normal_distribution<double> alpha(640.0, 8.0);
+  boost::random::normal_distribution<double> beta(706.0, 9.0);
+  boost::random::normal_distribution<double> scatter(560.0, 30.0);
+  double choice = unit(rng);
+  double height;
+  if (choice < 0.55){
+    height = alpha(rng);
+  } else if (choice < 0.65){
+    height = beta(rng);
+  } else if (choice < 0.75){
+    height = scatter(rng);
+  } else {
+    height = 20.0 + unit(rng) * 4075.0;
+  }
+  return (uint16_t)std::max(1.0, std::min(4095.0, height));
+}
+
+const std::vector<ListModeEvent>& XspressListModeEventSource::frame_events(uint64_t frame) const
+{
+  return frames_[frame % frames_.size()];
+}
+
+uint32_t XspressListModeEventSource::get_frame_ticks() const
+{
+  return frame_ticks_;
+}
+
+uint32_t XspressListModeEventSource::get_total_channels() const
+{
+  return config_.num_channels + config_.marker_channels;
+}
+
+const ListModeGeneratorConfig& XspressListModeEventSource::get_config() const
+{
+  return config_;
+}
+
+uint64_t XspressListModeEventSource::get_template_events() const
+{
+  uint64_t events = 0;
+  for (uint32_t frame = 0; frame < frames_.size(); frame++){
+    events += frames_[frame].size();
+  }
+  return events;
+}
+
+XspressListModeUDPSender::XspressListModeUDPSender(const XspressListModeEventSource& source,
+                                                   uint32_t card,
+                                                   uint32_t channels_per_card,
+                                                   const std::string& card_address,
+                                                   const std::string& destination_address,
+                                                   uint16_t destination_port) :
+  logger_(log4cxx::Logger::getLogger("Xspress.ListModeGenerator")),
+  source_(source),
+  card_(card),
+  first_channel_(card * channels_per_card),
+  num_channels_(0),
+  card_address_(card_address),
+  data_socket_(-1),
+  ack_socket_(-1)
+{
+  if (first_channel_ < source_.get_total_channels()){
+    num_channels_ = std::min(channels_per_card, source_.get_total_channels() - first_channel_);
+  }
+  memset(&destination_, 0, sizeof(destination_));
+  destination_.sin_family = AF_INET;
+  destination_.sin_addr.s_addr = inet_addr(destination_address.c_str());
+  destination_.sin_port = htons(destination_port);
+  clear_stats(stats_);
+  encode();
+}
+
+XspressListModeUDPSender::~XspressListModeUDPSender()
+{
+  if (data_socket_ >= 0){
+    close(data_socket_);
+  }
+  if (ack_socket_ >= 0){
+    close(ack_socket_);
+  }
+}
+
+/** Encode the packets for every template frame.
+ *
+ * The frame number and previous integration time in the header words are
+ * left clear, they are filled in as each frame is sent.
+ */
+void XspressListModeUDPSender::encode()
+{
+  const ListModeGeneratorConfig& config = source_.get_config();
+  uint32_t events_per_packet = XSPRESS_RX_BUFF_LWORDS - XSPRESS_RX_HEADER_LWORDS;
+  packets_.assign(config.template_frames, std::vector<std::vector<std::vector<uint64_t> > >(num_channels_));
+
+  for (uint32_t frame = 0; frame < config.template_frames; frame++){
+    std::vector<std::vector<uint64_t> > events(num_channels_);
+    const std::vector<ListModeEvent>& frame_events = source_.frame_events(frame);
+    for (size_t index = 0; index < frame_events.size(); index++){
+      const ListModeEvent& event = frame_events[index];
+      if (event.channel < first_channel_ || event.channel >= first_channel_ + num_channels_){
+        continue;
+      }
+      uint32_t chan = event.channel - first_channel_;
+      uint64_t word = LIST_EVENT_SET_HEIGHT(event.height) | LIST_EVENT_SET_TIME(event.time) | LIST_EVENT_SET_CHAN(chan);
+      if (event.type == LIST_EVENT_RESET){
+        word |= LIST_EVENT_MASK_RESET;
+      } else if (event.type == LIST_EVENT_MARKER){
+        word |= LIST_EVENT_MASK_MARKER;
+      }
+      events[chan].push_back(word);
+    }
+    for (uint32_t chan = 0; chan < num_channels_; chan++){
+      // Every channel sends at least one packet to carry the end of frame marker
+      size_t num_events = events[chan].size();
+      size_t num_packets = std::max((size_t)1, (num_events + events_per_packet - 1) / events_per_packet);
+      std::vector<std::vector<uint64_t> >& packets = packets_[frame][chan];
+      packets.resize(num_packets);
+      for (size_t packet = 0; packet < num_packets; packet++){
+        size_t first = packet * events_per_packet;
+        size_t last = std::min(num_events, first + events_per_packet);
+        packets[packet].reserve(XSPRESS_RX_HEADER_LWORDS + last - first);
+        packets[packet].push_back(XSP_SOF_SET_CHAN(chan));
+        packets[packet].insert(packets[packet].end(), events[chan].begin() + first, events[chan].begin() + last);
+      }
+      packets.back()[0] |= XSP_MASK_END_OF_FRAME;
+    }
+  }
+}
+
+/** Open the sockets used by the card.
+ *
+ * The data socket is bound to the card address so that the receiver can map
+ * the source address of each packet onto the card's channels.
+ *
+ * \param[in] wait_ack - listen for the acknowledgement of each end of frame.
+ * \return true if the sockets were opened.
+ */
+bool XspressListModeUDPSender::open(bool wait_ack)
+{
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = inet_addr(card_address_.c_str());
+  local.sin_port = 0;
+
+  data_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (data_socket_ < 0){
+    LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to create data socket: " << strerror(errno));
+    return false;
+  }
+  int buffer_size = LIST_SOCKET_BUFFER_SIZE;
+  setsockopt(data_socket_, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+  if (bind(data_socket_, (struct sockaddr *)&local, sizeof(local)) < 0){
+    LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to bind data socket to " << card_address_ << ": " << strerror(errno));
+    return false;
+  }
+
+  if (wait_ack){
+    local.sin_port = htons(LIST_ACK_PORT);
+    ack_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (ack_socket_ < 0 || bind(ack_socket_, (struct sockaddr *)&local, sizeof(local)) < 0){
+      LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to bind acknowledgement socket to "
+          << card_address_ << ":" << LIST_ACK_PORT << ": " << strerror(errno));
+      return false;
+    }
+  }
+  LOG4CXX_INFO(logger_, "Card " << card_ << " sending channels " << first_channel_ << " to "
+      << first_channel_ + num_channels_ - 1 << " from " << card_address_);
+  return true;
+}
+
+/** Send the event stream.
+ *
+ * \param[in] num_frames - number of time frames to send.
+ * \param[in] realtime - send each time frame once its duration has elapsed.
+ * \param[in] ack_timeout - time to wait for the acknowledgements of each frame (s).
+ * \param[in] running - cleared to stop sending early.
+ */
+void XspressListModeUDPSender::run(uint64_t num_frames,
+                                   bool realtime,
+                                   double ack_timeout,
+                                   boost::atomic<bool> *running)
+{
+  const ListModeGeneratorConfig& config = source_.get_config();
+  std::vector<struct mmsghdr> messages;
+  std::vector<struct iovec> iovecs;
+  stats_.start_ns = monotonic_ns();
+
+  for (uint64_t frame = 0; frame < num_frames && *running; frame++){
+    if (realtime){
+      wait_for_frame(stats_.start_ns, frame, config.frame_time);
+    }
+    uint64_t prev_time = (frame == 0) ? 0 : source_.get_frame_ticks();
+    std::vector<std::vector<std::vector<uint64_t> > >& frame_packets = packets_[frame % packets_.size()];
+
+    // Patch the header words and gather every packet for the card
+    iovecs.clear();
+    for (uint32_t chan = 0; chan < num_channels_; chan++){
+      for (size_t packet = 0; packet < frame_packets[chan].size(); packet++){
+        std::vector<uint64_t>& words = frame_packets[chan][packet];
+        words[0] = (words[0] & (XSP_SOF_SET_CHAN(0xF) | XSP_MASK_END_OF_FRAME)) |
+                   XSP_SOF_SET_FRAME(frame) | XSP_SOF_SET_PREV_TIME(prev_time);
+        struct iovec iov;
+        iov.iov_base = &words[0];
+        iov.iov_len = words.size() * sizeof(uint64_t);
+        iovecs.push_back(iov);
+        stats_.events += words.size() - XSPRESS_RX_HEADER_LWORDS;
+      }
+    }
+    messages.resize(iovecs.size());
+    for (size_t index = 0; index < iovecs.size(); index++){
+      memset(&messages[index], 0, sizeof(struct mmsghdr));
+      messages[index].msg_hdr.msg_name = &destination_;
+      messages[index].msg_hdr.msg_namelen = sizeof(destination_);
+      messages[index].msg_hdr.msg_iov = &iovecs[index];
+      messages[index].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    while (sent < messages.size() && *running){
+      int result = sendmmsg(data_socket_, &messages[sent], messages.size() - sent, 0);
+      if (result < 0){
+        if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR){
+          boost::this_thread::yield();
+          continue;
+        }
+        LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to send frame " << frame << ": " << strerror(errno));
+        stats_.send_errors++;
+        break;
+      }
+      for (int index = 0; index < result; index++){
+        stats_.bytes += iovecs[sent + index].iov_len;
+      }
+      sent += result;
+    }
+    stats_.packets += sent;
+    stats_.frames++;
+    LOG4CXX_DEBUG_LEVEL(2, logger_, "Card " << card_ << " sent frame " << frame << " in " << sent << " packets");
+
+    if (ack_socket_ >= 0){
+      wait_for_acks(XSP_SOF_GET_FRAME(frame), num_channels_, ack_timeout);
+    }
+  }
+  stats_.end_ns = monotonic_ns();
+}
+
+/** Wait for the receiver to acknowledge the end of frame on every channel.
+ *
+ * \param[in] frame - time frame (as encoded in the header word) to wait for.
+ * \param[in] expected - number of acknowledgements expected.
+ * \param[in] timeout - time to wait (s).
+ * \return true if every acknowledgement was received.
+ */
+bool XspressListModeUDPSender::wait_for_acks(uint32_t frame, uint32_t expected, double timeout)
+{
+  uint32_t received = 0;
+  uint64_t deadline_ns = monotonic_ns() + (uint64_t)(timeout * 1000000000.0);
+  while (received < expected){
+    uint64_t now_ns = monotonic_ns();
+    if (now_ns >= deadline_ns){
+      LOG4CXX_WARN(logger_, "Card " << card_ << " timed out waiting for acknowledgements of frame " << frame
+          << " (" << received << " of " << expected << ")");
+      stats_.ack_timeouts++;
+      return false;
+    }
+    struct pollfd pfd;
+    pfd.fd = ack_socket_;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, (int)std::max((uint64_t)1, (deadline_ns - now_ns) / 1000000)) <= 0){
+      continue;
+    }
+    uint32_t ack[LIST_ACK_SIZE];
+    ssize_t bytes = recv(ack_socket_, ack, sizeof(ack), 0);
+    // Acknowledgements for earlier frames arriving late are ignored
+    if (bytes == sizeof(ack) && ack[2] == frame){
+      received++;
+      stats_.acks++;
+    }
+  }
+  return true;
+}
+
+const ListModeSenderStats& XspressListModeUDPSender::get_stats() const
+{
+  return stats_;
+}
+
+X3X2ListModeTCPSender::X3X2ListModeTCPSender(const XspressListModeEventSource& source,
+                                             uint32_t card,
+                                             uint32_t channels_per_card,
+                                             const std::string& listen_address,
+                                             uint16_t listen_port,
+                                             uint16_t acquisition_number) :
+  logger_(log4cxx::Logger::getLogger("Xspress.ListModeGenerator")),
+  source_(source),
+  card_(card),
+  first_channel_(card * channels_per_card),
+  num_channels_(0),
+  listen_address_(listen_address),
+  listen_port_(listen_port),
+  acquisition_number_(acquisition_number),
+  listen_socket_(-1),
+  data_socket_(-1),
+  frame_fields_(0)
+{
+  if (first_channel_ < source_.get_total_channels()){
+    num_channels_ = std::min(channels_per_card, source_.get_total_channels() - first_channel_);
+  }
+  for (uint32_t id = 0; id < X3X2_FIELD_IDS; id++){
+    last_value_[id] = -1;
+  }
+  clear_stats(stats_);
+}
+
+X3X2ListModeTCPSender::~X3X2ListModeTCPSender()
+{
+  if (data_socket_ >= 0){
+    close(data_socket_);
+  }
+  if (listen_socket_ >= 0){
+    close(listen_socket_);
+  }
+}
+
+/** Listen for the frame receiver and accept its connection.
+ *
+ * \param[in] accept_timeout - time to wait for the receiver to connect (s).
+ * \return true if the receiver connected.
+ */
+bool X3X2ListModeTCPSender::open(double accept_timeout)
+{
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = inet_addr(listen_address_.c_str());
+  local.sin_port = htons(listen_port_);
+
+  listen_socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int reuse = 1;
+  setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(listen_socket_, (struct sockaddr *)&local, sizeof(local)) < 0 || listen(listen_socket_, 1) < 0){
+    LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to listen on " << listen_address_ << ":" << listen_port_
+        << ": " << strerror(errno));
+    return false;
+  }
+  LOG4CXX_INFO(logger_, "Card " << card_ << " waiting for a connection on " << listen_address_ << ":" << listen_port_);
+
+  struct pollfd pfd;
+  pfd.fd = listen_socket_;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, (int)(accept_timeout * 1000.0)) <= 0){
+    LOG4CXX_ERROR(logger_, "Card " << card_ << " timed out waiting for a connection");
+    return false;
+  }
+  data_socket_ = accept(listen_socket_, NULL, NULL);
+  if (data_socket_ < 0){
+    LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to accept connection: " << strerror(errno));
+    return false;
+  }
+  int buffer_size = LIST_SOCKET_BUFFER_SIZE;
+  setsockopt(data_socket_, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+  LOG4CXX_INFO(logger_, "Card " << card_ << " sending channels " << first_channel_ << " to "
+      << first_channel_ + num_channels_ - 1);
+  return true;
+}
+
+/** Send the event stream.
+ *
+ * \param[in] num_frames - number of time frames to send.
+ * \param[in] realtime - send each time frame once its duration has elapsed.
+ * \param[in] running - cleared to stop sending early.
+ */
+void X3X2ListModeTCPSender::run(uint64_t num_frames, bool realtime, boost::atomic<bool> *running)
+{
+  const ListModeGeneratorConfig& config = source_.get_config();
+  uint64_t frame_ticks = source_.get_frame_ticks();
+  fields_.reserve(X3X2_MINI_FIELDS_PER_FRAME * 64);
+  stats_.start_ns = monotonic_ns();
+
+  for (uint64_t frame = 0; frame < num_frames && *running; frame++){
+    if (realtime){
+      wait_for_frame(stats_.start_ns, frame, config.frame_time);
+    }
+    const std::vector<ListModeEvent>& events = source_.frame_events(frame);
+    for (size_t index = 0; index < events.size(); index++){
+      const ListModeEvent& event = events[index];
+      if (event.channel < first_channel_ || event.channel >= first_channel_ + num_channels_){
+        continue;
+      }
+      uint32_t chan = event.channel - first_channel_;
+      uint64_t time_stamp = frame * frame_ticks + event.time;
+      if (event.type == LIST_EVENT_MARKER){
+        // The processor drops the rest of a frame once it sees a marker channel
+        complete_tcp_frame();
+        write_state(frame, X3X2_FLAG_TTL_A, chan, time_stamp);
+        write_field(X3X2_FIELD_HEIGHT, 0);
+        complete_tcp_frame();
+      } else {
+        write_state(frame, 0, chan, time_stamp);
+        write_field(event.type == LIST_EVENT_RESET ? X3X2_FIELD_RESET : X3X2_FIELD_HEIGHT, event.height);
+      }
+      stats_.events++;
+    }
+    // Mark the end of the time frame on every detector channel of the card
+    uint64_t end_stamp = (frame + 1) * frame_ticks - 1;
+    for (uint32_t chan = 0; chan < num_channels_; chan++){
+      if (first_channel_ + chan < config.num_channels){
+        write_state(frame, X3X2_FLAG_END_OF_FRAME, chan, end_stamp);
+        write_field(X3X2_FIELD_HEIGHT, 0);
+      }
+    }
+    stats_.frames++;
+    if (frame + 1 == num_frames){
+      complete_tcp_frame();
+    }
+    if (!send_tcp_frames()){
+      break;
+    }
+    LOG4CXX_DEBUG_LEVEL(2, logger_, "Card " << card_ << " sent frame " << frame);
+  }
+  stats_.end_ns = monotonic_ns();
+}
+
+/** Write a single field into the partial TCP frame, completing it when full.
+ *
+ * \param[in] id - field id.
+ * \param[in] value - 12 bit field value.
+ */
+void X3X2ListModeTCPSender::write_field(uint32_t id, uint32_t value)
+{
+  fields_.push_back(X3X2_FIELD(id, value));
+  last_value_[id] = value & 0xFFF;
+  frame_fields_++;
+  if (frame_fields_ == X3X2_MINI_FIELDS_PER_FRAME){
+    complete_tcp_frame();
+  }
+}
+
+/** Write the fields describing the next event, skipping any that are unchanged.
+ *
+ * \param[in] time_frame - time frame of the event.
+ * \param[in] flags - end of frame, TTL and dummy flags.
+ * \param[in] chan_of_card - channel of the card.
+ * \param[in] time_stamp - time of the event in clock ticks from the start of the acquisition.
+ */
+void X3X2ListModeTCPSender::write_state(uint64_t time_frame, uint32_t flags, uint32_t chan_of_card, uint64_t time_stamp)
+{
+  // Keep every event within a single TCP frame
+  if (frame_fields_ + X3X2_MAX_EVENT_FIELDS > X3X2_MINI_FIELDS_PER_FRAME){
+    complete_tcp_frame();
+  }
+  uint32_t values[X3X2_FIELD_IDS];
+  values[X3X2_FIELD_ACQUISITION] = acquisition_number_;
+  values[X3X2_FIELD_TIME_FRAME_0] = (flags & 0xF) | ((time_frame & 0xFF) << 4);
+  values[X3X2_FIELD_TIME_FRAME_1] = (time_frame >> 8) & 0xFFF;
+  values[X3X2_FIELD_TIME_FRAME_2] = (time_frame >> 20) & 0xFFF;
+  values[X3X2_FIELD_TIME_FRAME_3] = (time_frame >> 32) & 0xFFF;
+  values[X3X2_FIELD_TIME_FRAME_4] = (time_frame >> 44) & 0xFFF;
+  values[X3X2_FIELD_CHANNEL] = ((chan_of_card & 0xF) << 8) | ((time_frame >> 56) & 0xFF);
+  values[X3X2_FIELD_TIME_STAMP_0] = time_stamp & 0xFFF;
+  values[X3X2_FIELD_TIME_STAMP_1] = (time_stamp >> 12) & 0xFFF;
+  values[X3X2_FIELD_TIME_STAMP_2] = (time_stamp >> 24) & 0xFFF;
+  values[X3X2_FIELD_TIME_STAMP_3] = (time_stamp >> 36) & 0xFFF;
+
+  static const uint32_t ids[] = {
+    X3X2_FIELD_ACQUISITION,
+    X3X2_FIELD_TIME_FRAME_0, X3X2_FIELD_TIME_FRAME_1, X3X2_FIELD_TIME_FRAME_2,
+    X3X2_FIELD_TIME_FRAME_3, X3X2_FIELD_TIME_FRAME_4, X3X2_FIELD_CHANNEL,
+    X3X2_FIELD_TIME_STAMP_0, X3X2_FIELD_TIME_STAMP_1, X3X2_FIELD_TIME_STAMP_2, X3X2_FIELD_TIME_STAMP_3
+  };
+  for (size_t index = 0; index < sizeof(ids) / sizeof(ids[0]); index++){
+    if (last_value_[ids[index]] != (int32_t)values[ids[index]]){
+      write_field(ids[index], values[ids[index]]);
+    }
+  }
+}
+
+/** Pad the partial TCP frame out to its full size.
+ *
+ * The decoder does not carry any state between TCP frames so every field is
+ * written again in the next frame.
+ */
+void X3X2ListModeTCPSender::complete_tcp_frame()
+{
+  if (frame_fields_ > 0){
+    fields_.insert(fields_.end(), X3X2_MINI_FIELDS_PER_FRAME - frame_fields_, X3X2_FIELD(X3X2_FIELD_PAD, 0));
+    frame_fields_ = 0;
+  }
+  for (uint32_t id = 0; id < X3X2_FIELD_IDS; id++){
+    last_value_[id] = -1;
+  }
+}
+
+/** Send every complete TCP frame, keeping the partial frame for later.
+ *
+ * \return true if the frames were sent.
+ */
+bool X3X2ListModeTCPSender::send_tcp_frames()
+{
+  size_t complete_fields = fields_.size() - frame_fields_;
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(&fields_[0]);
+  size_t length = complete_fields * sizeof(uint16_t);
+  size_t sent = 0;
+  while (sent < length){
+    ssize_t result = send(data_socket_, data + sent, length - sent, MSG_NOSIGNAL);
+    if (result < 0){
+      if (errno == EINTR){
+        continue;
+      }
+      LOG4CXX_ERROR(logger_, "Card " << card_ << " failed to send: " << strerror(errno));
+      stats_.send_errors++;
+      return false;
+    }
+    sent += result;
+  }
+  stats_.bytes += length;
+  stats_.packets += complete_fields / X3X2_MINI_FIELDS_PER_FRAME;
+  fields_.erase(fields_.begin(), fields_.begin() + complete_fields);
+  return true;
+}
+
+const ListModeSenderStats& X3X2ListModeTCPSender::get_stats() const
+{
+  return stats_;
+}
+
+} /* namespace FrameSimulator */
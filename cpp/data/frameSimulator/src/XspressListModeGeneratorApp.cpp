@@ -0,0 +1,351 @@
+/**
+ * XspressListModeGeneratorApp.cpp
+ *
+ * Sends a simulated list-mode event stream to the Xspress 4 UDP or X3X2 TCP
+ * frame receivers so that the receiver and processor throughput can be
+ * measured on localhost.
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: Quantum Detectors
+ */
+
+#include <time.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+#include <log4cxx/logger.h>
+#include <log4cxx/basicconfigurator.h>
+#include <log4cxx/propertyconfigurator.h>
+#include <log4cxx/helpers/exception.h>
+#include <log4cxx/xml/domconfigurator.h>
+using namespace log4cxx;
+using namespace log4cxx::helpers;
+
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+namespace po = boost::program_options;
+
+#include "logging.h"
+#include "XspressListModeGenerator.h"
+#include "DebugLevelLogger.h"
+#include "version.h"
+
+using namespace FrameSimulator;
+
+static bool has_suffix(const std::string &str, const std::string &suffix)
+{
+  return str.size() >= suffix.size() &&
+      str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void udp_task(XspressListModeUDPSender *sender,
+                     uint64_t num_frames,
+                     bool realtime,
+                     double ack_timeout,
+                     boost::atomic<bool> *running)
+{
+  sender->run(num_frames, realtime, ack_timeout, running);
+}
+
+static void tcp_task(X3X2ListModeTCPSender *sender,
+                     double accept_timeout,
+                     uint64_t num_frames,
+                     bool realtime,
+                     boost::atomic<bool> *running,
+                     boost::atomic<uint32_t> *failed)
+{
+  if (!sender->open(accept_timeout)){
+    (*failed)++;
+    return;
+  }
+  sender->run(num_frames, realtime, running);
+}
+
+void parse_arguments(int argc, char** argv, po::variables_map& vm, LoggerPtr& logger)
+{
+  try
+  {
+    po::options_description generic("Generic options");
+    generic.add_options()
+        ("help,h",
+         "Print this help message")
+        ("version,v",
+         "Print program version string")
+        ;
+    po::options_description config("Generator options");
+    config.add_options()
+        ("debug-level,d",      po::value<unsigned int>()->default_value(debug_level),
+           "Set the debug level")
+        ("logconfig,l",        po::value<string>(),
+           "Set the log4cxx logging configuration file")
+        ("mode,m",             po::value<string>()->default_value("udp"),
+           "Event stream to send, udp (Xspress 4) or x3x2 (X3X2 TCP)")
+        ("channels,c",         po::value<uint32_t>()->default_value(8),
+           "Number of detector channels")
+        ("channels-per-card",  po::value<uint32_t>()->default_value(10),
+           "Number of channels (including marker channels) sent by each card")
+        ("rate,r",             po::value<std::vector<double> >()->multitoken(),
+           "Event rate on each detector channel (events/s), the last rate is used for any remaining channels")
+        ("marker-channels",    po::value<uint32_t>()->default_value(0),
+           "Number of marker channels following the detector channels")
+        ("marker-rate",        po::value<double>()->default_value(1000.0),
+           "Marker rate on each marker channel (markers/s)")
+        ("reset-rate",         po::value<double>()->default_value(0.0),
+           "Preamplifier reset rate on each detector channel (resets/s)")
+        ("reset-ticks",        po::value<uint32_t>()->default_value(400),
+           "Width of each reset in clock ticks")
+        ("frame-time,e",       po::value<double>()->default_value(0.001),
+           "Duration of each time frame in seconds")
+        ("frames,f",           po::value<uint64_t>()->default_value(1000),
+           "Number of time frames to send")
+        ("template-frames",    po::value<uint32_t>()->default_value(16),
+           "Number of time frames generated before the event stream repeats")
+        ("seed",               po::value<uint32_t>()->default_value(1),
+           "Seed for the random number generator")
+        ("address,a",          po::value<string>()->default_value("127.0.0.1"),
+           "Receiver address (udp) or address to listen on (x3x2)")
+        ("port,p",             po::value<uint16_t>()->default_value(30125),
+           "Receiver port (udp) or port of the first card to listen on (x3x2)")
+        ("card-addresses",     po::value<std::vector<string> >()->multitoken(),
+           "Source address of each card (udp), defaults to 127.0.0.1")
+        ("wait-ack",           po::value<bool>()->default_value(false),
+           "Wait for the receiver to acknowledge each end of frame (udp)")
+        ("ack-timeout",        po::value<double>()->default_value(1.0),
+           "Time in seconds to wait for the acknowledgements of each frame (udp)")
+        ("acquisition-number", po::value<uint16_t>()->default_value(0),
+           "Acquisition number written into the event stream (x3x2)")
+        ("accept-timeout",     po::value<double>()->default_value(60.0),
+           "Time in seconds to wait for the receiver to connect (x3x2)")
+        ("realtime",           po::value<bool>()->default_value(false),
+           "Send each time frame once its duration has elapsed rather than as fast as possible")
+        ;
+
+    po::options_description cmdline_options;
+    cmdline_options.add(generic).add(config);
+
+    po::store(po::parse_command_line(argc, argv, cmdline_options), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+      std::cout << "usage: xspressListModeGenerator [options]" << std::endl << std::endl;
+      std::cout << cmdline_options << std::endl;
+      exit(1);
+    }
+
+    if (vm.count("version")) {
+      std::cout << "xspressListModeGenerator version " << XSPRESS_DETECTOR_VERSION_STR << std::endl;
+      exit(1);
+    }
+
+    if (vm.count("logconfig"))
+    {
+      std::string logconf_fname = vm["logconfig"].as<string>();
+      if (has_suffix(logconf_fname, ".xml")) {
+        log4cxx::xml::DOMConfigurator::configure(logconf_fname);
+      } else {
+        PropertyConfigurator::configure(logconf_fname);
+      }
+    } else {
+      BasicConfigurator::configure();
+    }
+
+    if (vm.count("debug-level"))
+    {
+      set_debug_level(vm["debug-level"].as<unsigned int>());
+    }
+  }
+  catch (Exception &e)
+  {
+    LOG4CXX_FATAL(logger, "Got Log4CXX exception: " << e.what());
+    throw;
+  }
+  catch (exception &e)
+  {
+    LOG4CXX_ERROR(logger, "Got exception:" << e.what());
+    throw;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  OdinData::app_path = argv[0];
+  LoggerPtr logger(Logger::getLogger("Xspress.ListModeGenerator"));
+
+  po::variables_map vm;
+  try {
+    parse_arguments(argc, argv, vm, logger);
+  }
+  catch (exception &e)
+  {
+    std::cerr << "Invalid arguments: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::string mode = vm["mode"].as<string>();
+  bool udp = (mode == "udp");
+  if (!udp && mode != "x3x2"){
+    std::cerr << "Invalid mode: " << mode << std::endl;
+    return 1;
+  }
+
+  ListModeGeneratorConfig config;
+  config.num_channels = vm["channels"].as<uint32_t>();
+  config.rates.push_back(100000.0);
+  if (vm.count("rate")){
+    config.rates = vm["rate"].as<std::vector<double> >();
+  }
+  config.marker_channels = vm["marker-channels"].as<uint32_t>();
+  config.marker_rate = vm["marker-rate"].as<double>();
+  config.reset_rate = vm["reset-rate"].as<double>();
+  config.reset_ticks = vm["reset-ticks"].as<uint32_t>();
+  config.frame_time = vm["frame-time"].as<double>();
+  config.template_frames = vm["template-frames"].as<uint32_t>();
+  config.seed = vm["seed"].as<uint32_t>();
+  uint64_t num_frames = vm["frames"].as<uint64_t>();
+  uint32_t channels_per_card = vm["channels-per-card"].as<uint32_t>();
+  bool realtime = vm["realtime"].as<bool>();
+
+  if (config.num_channels == 0 || num_frames == 0 || config.template_frames == 0){
+    std::cerr << "The number of channels, frames and template frames must be non-zero" << std::endl;
+    return 1;
+  }
+  if (channels_per_card == 0 || channels_per_card > LIST_MAX_CHANNELS_PER_CARD){
+    std::cerr << "The number of channels per card must be between 1 and " << LIST_MAX_CHANNELS_PER_CARD << std::endl;
+    return 1;
+  }
+  // Event times within a frame are held in 32 bits of clock ticks
+  if (config.frame_time <= 0.0 || config.frame_time / LIST_CLOCK_PERIOD >= 4294967295.0){
+    std::cerr << "The frame time must be positive and less than " << 4294967295.0 * LIST_CLOCK_PERIOD << " s" << std::endl;
+    return 1;
+  }
+  if (!udp && config.reset_ticks > 0xFFF){
+    std::cerr << "The reset width must fit in 12 bits for the X3X2 event stream" << std::endl;
+    return 1;
+  }
+
+  uint32_t total_channels = config.num_channels + config.marker_channels;
+  uint32_t num_cards = (total_channels + channels_per_card - 1) / channels_per_card;
+  std::vector<string> card_addresses;
+  if (vm.count("card-addresses")){
+    card_addresses = vm["card-addresses"].as<std::vector<string> >();
+  }
+  card_addresses.resize(num_cards, card_addresses.empty() ? "127.0.0.1" : card_addresses.back());
+  if (udp && vm["wait-ack"].as<bool>()){
+    // Each card listens for its acknowledgements on the same port
+    for (uint32_t card = 1; card < num_cards; card++){
+      if (std::find(card_addresses.begin(), card_addresses.begin() + card, card_addresses[card]) !=
+          card_addresses.begin() + card){
+        std::cerr << "Every card needs its own address to wait for acknowledgements" << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  XspressListModeEventSource source(config);
+  source.generate();
+
+  boost::atomic<bool> running(true);
+  boost::atomic<uint32_t> failed(0);
+  std::vector<XspressListModeUDPSender *> udp_senders;
+  std::vector<X3X2ListModeTCPSender *> tcp_senders;
+  std::vector<boost::thread *> threads;
+  for (uint32_t card = 0; card < num_cards; card++){
+    if (udp){
+      XspressListModeUDPSender *sender = new XspressListModeUDPSender(source,
+                                                                      card,
+                                                                      channels_per_card,
+                                                                      card_addresses[card],
+                                                                      vm["address"].as<string>(),
+                                                                      vm["port"].as<uint16_t>());
+      udp_senders.push_back(sender);
+      if (!sender->open(vm["wait-ack"].as<bool>())){
+        failed++;
+      }
+    } else {
+      tcp_senders.push_back(new X3X2ListModeTCPSender(source,
+                                                      card,
+                                                      channels_per_card,
+                                                      vm["address"].as<string>(),
+                                                      vm["port"].as<uint16_t>() + card,
+                                                      vm["acquisition-number"].as<uint16_t>()));
+    }
+  }
+  if (failed == 0){
+    for (uint32_t card = 0; card < num_cards; card++){
+      if (udp){
+        threads.push_back(new boost::thread(&udp_task,
+                                            udp_senders[card],
+                                            num_frames,
+                                            realtime,
+                                            vm["ack-timeout"].as<double>(),
+                                            &running));
+      } else {
+        threads.push_back(new boost::thread(&tcp_task,
+                                            tcp_senders[card],
+                                            vm["accept-timeout"].as<double>(),
+                                            num_frames,
+                                            realtime,
+                                            &running,
+                                            &failed));
+      }
+    }
+  }
+  for (size_t index = 0; index < threads.size(); index++){
+    threads[index]->join();
+    delete threads[index];
+  }
+
+  // Collect the results from every card
+  ListModeSenderStats total;
+  memset(&total, 0, sizeof(total));
+  for (uint32_t card = 0; card < num_cards; card++){
+    const ListModeSenderStats& stats = udp ? udp_senders[card]->get_stats() : tcp_senders[card]->get_stats();
+    total.frames += stats.frames;
+    total.packets += stats.packets;
+    total.bytes += stats.bytes;
+    total.events += stats.events;
+    total.acks += stats.acks;
+    total.ack_timeouts += stats.ack_timeouts;
+    total.send_errors += stats.send_errors;
+    if (stats.start_ns > 0 && (total.start_ns == 0 || stats.start_ns < total.start_ns)){
+      total.start_ns = stats.start_ns;
+    }
+    total.end_ns = std::max(total.end_ns, stats.end_ns);
+  }
+  double elapsed_s = (double)(total.end_ns - total.start_ns) / 1000000000.0;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Configuration" << std::endl;
+  std::cout << "  mode:              " << mode << std::endl;
+  std::cout << "  channels:          " << config.num_channels << " (+" << config.marker_channels
+            << " marker) on " << num_cards << " cards" << std::endl;
+  std::cout << "  frames:            " << num_frames << " (frame time " << config.frame_time << " s)" << std::endl;
+  std::cout << "  template events:   " << source.get_template_events() << " in "
+            << config.template_frames << " frames" << std::endl;
+  std::cout << "  realtime:          " << (realtime ? "true" : "false") << std::endl;
+  std::cout << "Results" << std::endl;
+  std::cout << "  elapsed:           " << elapsed_s << " s" << std::endl;
+  std::cout << "  events:            " << total.events << std::endl;
+  std::cout << (udp ? "  packets:           " : "  tcp frames:        ") << total.packets << std::endl;
+  std::cout << "  events/s:          " << (elapsed_s > 0.0 ? (double)total.events / elapsed_s : 0.0) << std::endl;
+  std::cout << "  MB/s:              " << (elapsed_s > 0.0 ? (double)total.bytes / elapsed_s / 1000000.0 : 0.0) << std::endl;
+  if (udp && vm["wait-ack"].as<bool>()){
+    std::cout << "  acks:              " << total.acks << " (" << total.ack_timeouts << " timeouts)" << std::endl;
+  }
+  std::cout << "  send errors:       " << total.send_errors << std::endl;
+
+  for (size_t index = 0; index < udp_senders.size(); index++){
+    delete udp_senders[index];
+  }
+  for (size_t index = 0; index < tcp_senders.size(); index++){
+    delete tcp_senders[index];
+  }
+
+  return (failed == 0 && total.send_errors == 0) ? 0 : 2;
+}
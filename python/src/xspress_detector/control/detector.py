@@ -18,6 +18,7 @@ from odin_data.control.ipc_message import IpcMessage
 
 from .client import AsyncClient
 from .debug import debug_method
+from .util import mca_dataset_dims
 from .parameter_tree import (
     WriteOnlyVirtualParameter,
     VirtualParameter,
@@ -28,6 +29,7 @@ from .parameter_tree import (
     ListParameter,
     XspressParameterTree,
     bound_validator,
+    is_pos,
 )
 
 
@@ -47,6 +49,13 @@ XSPRESS_MODE_LIST = "list"
 XSPRESS_EXPOSURE_LOWER_LIMIT = 1.0 / 1000000
 XSPRESS_EXPOSURE_UPPER_LIMIT = 20.0
 
+# Dead time correction flags of the XspressProcessPlugin
+XSP_DTC_CORRECTED_MCA = 0x1  # Write dead time corrected spectra as mca_N_corrected
+XSP_DTC_CORRECTED_FLOAT = 0x2  # Write the corrected spectra as float32 rather than uint32
+
+# Number of aux planes read for each spectrum when resolution grades are used
+XSPRESS_NUM_RESGRADES = 16
+
 NUM_FR_MCA = 8
 NUM_FR_LIST = 8
 
@@ -276,6 +285,8 @@ class XspressDetectorStr:
     CONFIG_DAQ = "daq"
     CONFIG_DAQ_ENABLED = "enabled"
     CONFIG_DAQ_ZMQ_ENDPOINTS = "endpoints"
+    CONFIG_DAQ_BATCH_SIZE = "batch_size"
+    CONFIG_DAQ_FRAMES_PER_MESSAGE = "frames_per_message"
 
     CMD = "command"
     CMD_RECONFIGURE = "reconfigure"
@@ -302,6 +313,12 @@ class XspressDetectorStr:
     PROCESS_NUM_MCA = "num_mca"
     PROCESS_NUM_CHANS_MCA = "num_chan_mca"
     PROCESS_NUM_CHANS_LIST = "num_chan_list"
+    PROCESS_DTC_FLAGS = "dtc_flags"
+    PROCESS_REBIN_FACTOR = "rebin_factor"
+    PROCESS_REBIN_LOW = "rebin_low"
+    PROCESS_REBIN_HIGH = "rebin_high"
+    PROCESS_AUX_SELECT = "aux_select"
+    PROCESS_AUX_SUM = "aux_sum"
 
     API = "api"
 
@@ -347,6 +364,14 @@ class XspressDetector(object):
         self.max_spectra: int = 0
         self.use_resgrades: bool = False
         self.run_flags: int = 0
+        self.daq_batch_size: int = 1
+        # processing applied by the frame processors, sent on reconfigure
+        self.process_dtc_flags: int = 0
+        self.process_rebin_factor: int = 1
+        self.process_rebin_low: int = 0
+        self.process_rebin_high: int = 0
+        self.process_aux_select: int = -1
+        self.process_aux_sum: bool = False
 
         self.mode: str = ""  # 'mca' or 'list' for readback
         self.acquisition_complete: bool = False
@@ -383,6 +408,16 @@ class XspressDetector(object):
                     ),
                 ),
                 XspressDetectorStr.CONFIG_DAQ_ZMQ_ENDPOINTS: ListParameter(),
+                XspressDetectorStr.CONFIG_DAQ_BATCH_SIZE: VirtualParameter(
+                    int,
+                    lambda: self.daq_batch_size,
+                    partial(self._set, "daq_batch_size"),
+                    self.set_daq_batch_size,
+                    validators=[is_pos],
+                ),
+                XspressDetectorStr.CONFIG_DAQ_FRAMES_PER_MESSAGE: TransparentValueParameter(
+                    int, 1
+                ),
             },
             XspressDetectorStr.CONFIG_REQUEST: WriteOnlyVirtualParameter(
                 int, self.read_config
@@ -765,6 +800,46 @@ class XspressDetector(object):
                 XspressDetectorStr.PROCESS_NUM_CHANS_LIST: ReadOnlyVirtualParameter(
                     int, lambda: self.num_chan_per_process_list
                 ),
+                XspressDetectorStr.PROCESS_DTC_FLAGS: VirtualParameter(
+                    int,
+                    lambda: self.process_dtc_flags,
+                    partial(self._set, "process_dtc_flags"),
+                    partial(self._set, "process_dtc_flags"),
+                    validators=[is_pos],
+                ),
+                XspressDetectorStr.PROCESS_REBIN_FACTOR: VirtualParameter(
+                    int,
+                    lambda: self.process_rebin_factor,
+                    partial(self._set, "process_rebin_factor"),
+                    partial(self._set, "process_rebin_factor"),
+                    validators=[is_pos],
+                ),
+                XspressDetectorStr.PROCESS_REBIN_LOW: VirtualParameter(
+                    int,
+                    lambda: self.process_rebin_low,
+                    partial(self._set, "process_rebin_low"),
+                    partial(self._set, "process_rebin_low"),
+                    validators=[is_pos],
+                ),
+                XspressDetectorStr.PROCESS_REBIN_HIGH: VirtualParameter(
+                    int,
+                    lambda: self.process_rebin_high,
+                    partial(self._set, "process_rebin_high"),
+                    partial(self._set, "process_rebin_high"),
+                    validators=[is_pos],
+                ),
+                XspressDetectorStr.PROCESS_AUX_SELECT: VirtualParameter(
+                    int,
+                    lambda: self.process_aux_select,
+                    partial(self._set, "process_aux_select"),
+                    partial(self._set, "process_aux_select"),
+                ),
+                XspressDetectorStr.PROCESS_AUX_SUM: VirtualParameter(
+                    bool,
+                    lambda: self.process_aux_sum,
+                    partial(self._set, "process_aux_sum"),
+                    partial(self._set, "process_aux_sum"),
+                ),
             },
         }
         self.parameter_tree = XspressParameterTree(tree)
@@ -817,10 +892,48 @@ class XspressDetector(object):
         configs = [copy.deepcopy(command) for _ in range(num_process)]
 
         if mode == XSPRESS_MODE_MCA:
-            dataset_values = {"dims": [1, 4096], "chunks": [1, 1, 4096]}
+            # The stored spectra are reduced by the rebin and aux settings
+            dims = mca_dataset_dims(
+                self.max_spectra if self.max_spectra > 0 else 4096,
+                XSPRESS_NUM_RESGRADES if self.use_resgrades else 1,
+                rebin_factor=self.process_rebin_factor,
+                rebin_low=self.process_rebin_low,
+                rebin_high=self.process_rebin_high,
+                aux_select=self.process_aux_select,
+                aux_sum=self.process_aux_sum,
+            )
+            if dims[1] == 0:
+                raise ValueError("The rebin settings leave no energy bins to store")
+            dataset_values = {"dims": dims, "chunks": [1] + dims}
+            # The corrected spectra are not part of the stored MCA configuration
+            corrected_values = {
+                "datatype": "float"
+                if self.process_dtc_flags & XSP_DTC_CORRECTED_FLOAT
+                else "uint32",
+                "compression": "blosc",
+                "indexes": True,
+                **dataset_values,
+            }
             for i in range(self.mca_channels):
                 fp_index = i // self.num_chan_per_process_mca
                 configs[fp_index]["hdf"]["dataset"][f"mca_{i}"] = dataset_values
+                if self.process_dtc_flags & XSP_DTC_CORRECTED_MCA:
+                    configs[fp_index]["hdf"]["dataset"][
+                        f"mca_{i}_corrected"
+                    ] = corrected_values
+            for config in configs:
+                config["xspress"] = {
+                    "dtc": {"flags": self.process_dtc_flags},
+                    "rebin": {
+                        "factor": self.process_rebin_factor,
+                        "low": self.process_rebin_low,
+                        "high": self.process_rebin_high,
+                    },
+                    "aux": {
+                        "select": self.process_aux_select,
+                        "sum": self.process_aux_sum,
+                    },
+                }
 
         tasks = ()
         for client, config in zip(self.fp_clients, configs):
@@ -875,6 +988,10 @@ class XspressDetector(object):
                     "rx_type": "zmq",
                     "decoder_type": "Xspress",
                     "rx_address": "127.0.0.1",
+                    # The buffers must hold every frame of a DAQ message
+                    "decoder_config": {
+                        XspressDetectorStr.CONFIG_DAQ_FRAMES_PER_MESSAGE: self.daq_batch_size
+                    },
                 }
                 for index in range(self.num_process_mca)
             ]
@@ -923,6 +1040,37 @@ class XspressDetector(object):
             resp = await self._async_client.send_recv(self.configuration.get_daq())
         return resp
 
+    async def set_daq_batch_size(self, value: int):
+        """Set the number of frames the DAQ sends in each message
+
+        The frame receiver buffers are resized to hold a full message before the
+        control server is sent the new batch size, so the two always match.
+
+        Args:
+            value (int): Number of frames per DAQ message
+        """
+        batch_size = max(value, 1)
+        if self.mode == XSPRESS_MODE_MCA:
+            config = {
+                "decoder_config": {
+                    XspressDetectorStr.CONFIG_DAQ_FRAMES_PER_MESSAGE: batch_size
+                }
+            }
+            tasks = ()
+            for client in self.fr_clients:
+                tasks += (asyncio.create_task(self.async_send_task(client, config)),)
+            await asyncio.gather(*tasks)
+        msg = _build_message(
+            MessageType.DAQ,
+            {
+                XspressDetectorStr.CONFIG_DAQ_BATCH_SIZE: batch_size,
+                XspressDetectorStr.CONFIG_DAQ_FRAMES_PER_MESSAGE: batch_size,
+            },
+        )
+        resp = await self._async_client.send_recv(msg)
+        self.daq_batch_size = batch_size
+        return resp
+
     async def connect(self, *unused):
         msg = _build_message(MessageType.CMD, {XspressDetectorStr.CMD_CONNECT: 1})
         return await self._async_client.send_recv(msg, timeout=20)
@@ -43,4 +43,21 @@ class ListModeIPPortGen:
         if self.current_count  >= self.NUM_PORTS_PER_IP:
             self.ip_last += self.IP_STEP
         self.current_count =  self.current_count % self.NUM_PORTS_PER_IP
-        return ip, ports
\ No newline at end of file
+        return ip, ports
+
+def mca_dataset_dims(num_bins, num_aux, rebin_factor=1, rebin_low=0, rebin_high=0, aux_select=-1, aux_sum=False):
+    """
+    Dimensions [aux, bins] of each frame of spectra stored by the XspressProcessPlugin.
+    The energy bins are cropped to [rebin_low, rebin_high) and summed in groups of
+    rebin_factor, any remainder is not stored.  Selecting or summing the aux planes
+    stores a single plane.  This must match output_aux and output_bins of the plugin.
+    """
+    rebin_factor = max(rebin_factor, 1)
+    if rebin_high > 0 and rebin_high <= rebin_low:
+        # The plugin rejects the window and stores every bin
+        rebin_low = rebin_high = 0
+    low = min(rebin_low, num_bins)
+    high = min(rebin_high, num_bins) if rebin_high > 0 else num_bins
+    bins = (high - low) // rebin_factor if high > low else 0
+    aux = min(1, num_aux) if (aux_sum or aux_select >= 0) else num_aux
+    return [aux, bins]
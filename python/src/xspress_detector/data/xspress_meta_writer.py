@@ -24,14 +24,24 @@ XSPRESS_SCALARS = "xspress_scalars"
 XSPRESS_DTC = "xspress_dtc"
 XSPRESS_INP_EST = "xspress_inp_est"
 XSPRESS_CHUNK = "xspress_meta_chunk"
+XSPRESS_BLOCK = "xspress_meta_block"
+XSPRESS_ROI = "xspress_roi"
+XSPRESS_SUM = "xspress_sum"
 
 # Number of scalars per channel
 XSPRESS_SCALARS_PER_CHANNEL = 9
 
+# Binary header at the start of each meta data block (MetaHeader)
+# frame_id, num_frames, first_channel, num_channels, num_values, reserved[3]
+XSPRESS_META_HEADER = struct.Struct("<5I12x")
+
 # Dataset names
 DATASET_SCALAR = "scalar_"
 DATASET_DTC = "dtc"
 DATASET_INP_EST = "inp_est"
+DATASET_ROI = "roi_"
+DATASET_SUM_SPECTRA = "sum_spectra"
+DATASET_SUM_TOTAL = "sum_total"
 DATASET_DAQ_VERSION = "data_version"
 DATASET_META_VERSION = "meta_version"
 
@@ -60,6 +70,13 @@ class XspressMetaWriter(MetaWriter):
         }
         self._dtc = {}
         self._inp = {}
+        self._meta = {}
+        self._scalar_overflow_logged = False
+        self._num_rois = 0
+        self._rois = {}
+        self._sum_spectra = False
+        self._num_bins = self._sensor_shape[-1]
+        self._sum_total = None
         super(XspressMetaWriter, self).__init__(name, directory, endpoints, config)
 
         self._series = None
@@ -106,6 +123,41 @@ class XspressMetaWriter(MetaWriter):
                 block_size=self._chunk_size,
             )
         )
+        for index in range(self._num_rois):
+            roi_name = "{}{}".format(DATASET_ROI, index)
+            self._logger.info("Adding dataset: {}".format(roi_name))
+            dsets.append(
+                Int64HDF5Dataset(
+                    roi_name,
+                    shape=(self._num_frames, self._num_channels),
+                    maxshape=(None, self._num_channels),
+                    chunks=(self._chunk_size, self._num_channels),
+                    rank=2,
+                    cache=True,
+                    block_size=self._chunk_size,
+                )
+            )
+        if self._sum_spectra:
+            self._logger.info("Adding dataset: {}".format(DATASET_SUM_SPECTRA))
+            dsets.append(
+                Int64HDF5Dataset(
+                    DATASET_SUM_SPECTRA,
+                    shape=(self._num_channels, self._num_bins),
+                    maxshape=(self._num_channels, self._num_bins),
+                    rank=2,
+                    cache=False,
+                )
+            )
+            self._logger.info("Adding dataset: {}".format(DATASET_SUM_TOTAL))
+            dsets.append(
+                Int64HDF5Dataset(
+                    DATASET_SUM_TOTAL,
+                    shape=(1, self._num_bins),
+                    maxshape=(1, self._num_bins),
+                    rank=2,
+                    cache=False,
+                )
+            )
         dsets.append(Int64HDF5Dataset(DATASET_DAQ_VERSION))
         dsets.append(Int64HDF5Dataset(DATASET_META_VERSION))
         return dsets
@@ -117,6 +169,9 @@ class XspressMetaWriter(MetaWriter):
             XSPRESS_DTC: self.handle_xspress_dtc,
             XSPRESS_INP_EST: self.handle_xspress_inp_est,
             XSPRESS_CHUNK: self.handle_xspress_meta_chunk,
+            XSPRESS_BLOCK: self.handle_xspress_meta_block,
+            XSPRESS_ROI: self.handle_xspress_roi,
+            XSPRESS_SUM: self.handle_xspress_sum,
         }
 
     def handle_xspress_scalars(self, header, _data):
@@ -244,11 +299,170 @@ class XspressMetaWriter(MetaWriter):
         if self._inp[frame]['qty'] == self._num_channels:
             self._add_value(DATASET_INP_EST, self._inp[frame]['values'], offset=frame)
             del self._inp[frame]
+
+    def handle_xspress_meta_block(self, header, _data):
+        """Handle combined scalars, DTC factors and input estimates message"""
+        self._logger.debug("%s | Handling xspress meta block message", self._name)
+        self._logger.debug("{}".format(header))
+        (
+            frame_id,
+            number_of_frames,
+            channel,
+            number_of_channels,
+            number_of_scalars,
+        ) = XSPRESS_META_HEADER.unpack_from(_data)
+
+        # Each frame is a record of the scalars, DTC factors and input estimates
+        record = numpy.dtype(
+            [
+                ("scalars", "<u4", (number_of_channels, number_of_scalars)),
+                ("dtc", "<f8", (number_of_channels,)),
+                ("inp_est", "<f8", (number_of_channels,)),
+            ]
+        )
+        array = numpy.frombuffer(
+            _data,
+            dtype=record,
+            count=number_of_frames,
+            offset=XSPRESS_META_HEADER.size,
+        )
+
+        # Scalars are only written for the datasets defined for them
+        if number_of_scalars > XSPRESS_SCALARS_PER_CHANNEL and not self._scalar_overflow_logged:
+            self._logger.warning(
+                "Meta block has %d scalars per channel, only %d are written",
+                number_of_scalars,
+                XSPRESS_SCALARS_PER_CHANNEL,
+            )
+            self._scalar_overflow_logged = True
+        number_of_scalars = min(number_of_scalars, XSPRESS_SCALARS_PER_CHANNEL)
+
+        for frame in range(number_of_frames):
+            self.add_meta_values(
+                frame_id + frame,
+                channel,
+                array["scalars"][frame, :, :number_of_scalars],
+                array["dtc"][frame],
+                array["inp_est"][frame],
+            )
+
+        if (datetime.now() - self._flush_time).total_seconds() > 1.0:
+            self._flush_datasets()
+            self._flush_time = datetime.now()
+
+    def add_meta_values(self, frame, channel, scalars, dtc, inp_est):
+        """Add the scalars, DTC factors and input estimates of a range of channels for a frame
+
+        The values are written once every channel of the frame has been received.
+        """
+        number_of_channels = scalars.shape[0]
+        if number_of_channels == self._num_channels and frame not in self._meta:
+            # All channels are present so the values can be written straight away
+            self._write_meta_values(frame, scalars, dtc, inp_est)
+            return
+
+        # Check if we need to create an entry for this frame
+        if frame not in self._meta:
+            self._meta[frame] = {
+                'qty': 0,
+                'scalars': numpy.zeros((self._num_channels, scalars.shape[1]), dtype=numpy.int64),
+                'dtc': numpy.zeros(self._num_channels, dtype=numpy.float64),
+                'inp_est': numpy.zeros(self._num_channels, dtype=numpy.float64),
+            }
+
+        entry = self._meta[frame]
+        entry['scalars'][channel:channel+number_of_channels] = scalars
+        entry['dtc'][channel:channel+number_of_channels] = dtc
+        entry['inp_est'][channel:channel+number_of_channels] = inp_est
+        entry['qty'] += number_of_channels
+
+        if entry['qty'] == self._num_channels:
+            self._write_meta_values(frame, entry['scalars'], entry['dtc'], entry['inp_est'])
+            del self._meta[frame]
+
+    def _write_meta_values(self, frame, scalars, dtc, inp_est):
+        for index in range(scalars.shape[1]):
+            dataset_name = "{}{}".format(DATASET_SCALAR, index)
+            self._add_value(dataset_name, scalars[:, index], offset=frame)
+        self._add_value(DATASET_DTC, dtc, offset=frame)
+        self._add_value(DATASET_INP_EST, inp_est, offset=frame)
+
+    def handle_xspress_roi(self, header, _data):
+        """Handle ROI counts message"""
+        self._logger.debug("%s | Handling xspress roi message", self._name)
+        self._logger.debug("{}".format(header))
+        (
+            frame_id,
+            number_of_frames,
+            channel,
+            number_of_channels,
+            number_of_rois,
+        ) = XSPRESS_META_HEADER.unpack_from(_data)
+
+        array = numpy.frombuffer(
+            _data,
+            dtype=numpy.uint32,
+            count=number_of_frames*number_of_channels*number_of_rois,
+            offset=XSPRESS_META_HEADER.size,
+        ).reshape((number_of_frames, number_of_channels, number_of_rois))
+
+        for frame in range(number_of_frames):
+            self.add_roi_values(frame_id + frame, channel, array[frame])
+
+    def add_roi_values(self, frame, channel, values):
+        # Check if we need to create an entry for this frame
+        if frame not in self._rois:
+            self._rois[frame] = {
+                'qty': 0,
+                'values': numpy.zeros((self._num_channels, values.shape[1]), dtype=numpy.int64)
+            }
+
+        self._rois[frame]['values'][channel:channel+values.shape[0]] = values
+        self._rois[frame]['qty'] += values.shape[0]
+
+        if self._rois[frame]['qty'] == self._num_channels:
+            for index in range(values.shape[1]):
+                dataset_name = "{}{}".format(DATASET_ROI, index)
+                self._add_value(dataset_name, self._rois[frame]['values'][:, index], offset=frame)
+            del self._rois[frame]
+
+    def handle_xspress_sum(self, header, _data):
+        """Handle sum spectra message"""
+        self._logger.debug("%s | Handling xspress sum message", self._name)
+        self._logger.debug("{}".format(header))
+        (
+            _frame_id,
+            _number_of_frames,
+            channel,
+            number_of_channels,
+            number_of_bins,
+        ) = XSPRESS_META_HEADER.unpack_from(_data)
+
+        array = numpy.frombuffer(
+            _data,
+            dtype=numpy.uint64,
+            count=number_of_channels*number_of_bins,
+            offset=XSPRESS_META_HEADER.size,
+        ).reshape((number_of_channels, number_of_bins)).astype(numpy.int64)
+
+        for index in range(number_of_channels):
+            self._add_value(DATASET_SUM_SPECTRA, array[index], offset=channel+index)
+
+        # The detector total is summed over the channels of every process
+        if self._sum_total is None or self._sum_total.shape[0] != number_of_bins:
+            self._sum_total = numpy.zeros(number_of_bins, dtype=numpy.int64)
+        self._sum_total += array.sum(axis=0)
+        self._add_value(DATASET_SUM_TOTAL, self._sum_total, offset=0)
+
     def handle_xspress_meta_chunk(self, header, _data):
         self._chunk_size = int(_data)
         if header["frame_id"] == -1 and self._configured == 0:
             self._chunk_size = int(_data)
             self._num_frames = int(header["num_frames_"])
+            self._num_rois = int(header.get("number_of_rois", 0))
+            self._sum_spectra = bool(header.get("sum_spectra", False))
+            self._num_bins = int(header.get("number_of_bins", self._num_bins))
+            self._sum_total = None
             self._logger.info("Received chunk configuration frame")
             self._configured = 1
             meta_dsets = self._define_detector_datasets()
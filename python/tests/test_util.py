@@ -1,5 +1,5 @@
 import pytest
-from xspress_detector.control.util import ListModeIPPortGen
+from xspress_detector.control.util import ListModeIPPortGen, mca_dataset_dims
 
 
 def test_gen_special():
@@ -82,4 +82,18 @@ def test_list_endpoints3():
         }
     ]
 
-    assert port_mapping == port_mapping_ref
\ No newline at end of file
+    assert port_mapping == port_mapping_ref
+
+def test_mca_dataset_dims():
+    assert mca_dataset_dims(4096, 1) == [1, 4096]
+    assert mca_dataset_dims(4096, 16) == [16, 4096]
+    assert mca_dataset_dims(4096, 1, rebin_factor=4) == [1, 1024]
+    assert mca_dataset_dims(4096, 1, rebin_factor=0) == [1, 4096]
+    # The remainder of the window is not stored
+    assert mca_dataset_dims(4096, 1, rebin_factor=3, rebin_low=100, rebin_high=200) == [1, 33]
+    assert mca_dataset_dims(4096, 1, rebin_low=4000) == [1, 96]
+    assert mca_dataset_dims(4096, 1, rebin_high=8192) == [1, 4096]
+    # An empty window is rejected and every bin stored
+    assert mca_dataset_dims(4096, 1, rebin_low=200, rebin_high=100) == [1, 4096]
+    assert mca_dataset_dims(4096, 16, aux_select=3) == [1, 4096]
+    assert mca_dataset_dims(4096, 16, aux_sum=True, rebin_factor=2) == [1, 2048]
@@ -0,0 +1,122 @@
+import logging
+import struct
+from datetime import datetime
+from types import SimpleNamespace
+
+import numpy
+import pytest
+from odin_data.meta_writer.meta_writer import MetaWriter
+
+from xspress_detector.data.xspress_meta_writer import (
+    XSPRESS_META_HEADER,
+    XspressMetaWriter,
+)
+
+NUM_CHANNELS = 4
+NUM_BINS = 8
+
+
+def _base_init(self, name, directory, endpoints, config):
+    self._name = name
+    self._logger = logging.getLogger("XspressMetaWriterTest")
+    self._datasets = {}
+
+
+@pytest.fixture
+def writer(monkeypatch):
+    """Writer with the odin-data base class replaced and dataset writes recorded"""
+    monkeypatch.setattr(MetaWriter, "__init__", _base_init)
+    config = SimpleNamespace(sensor_shape=(NUM_CHANNELS, 1, NUM_BINS))
+    writer = XspressMetaWriter("test", "/tmp", ["tcp://127.0.0.1:5000"], config)
+    writer._flush_time = datetime.now()
+    writer.written = {}
+
+    def add_value(dataset_name, value, offset=0):
+        writer.written[(dataset_name, offset)] = numpy.array(value)
+
+    writer._add_value = add_value
+    writer._flush_datasets = lambda: None
+    return writer
+
+
+def meta_block(frame_id, first_channel, scalars, dtc, inp_est):
+    """Pack a meta block from [frame][channel][scalar] and [frame][channel] arrays"""
+    num_frames, num_channels, num_scalars = scalars.shape
+    data = XSPRESS_META_HEADER.pack(
+        frame_id, num_frames, first_channel, num_channels, num_scalars
+    )
+    for frame in range(num_frames):
+        data += scalars[frame].astype("<u4").tobytes()
+        data += dtc[frame].astype("<f8").tobytes()
+        data += inp_est[frame].astype("<f8").tobytes()
+    return data
+
+
+def test_meta_header_size():
+    assert XSPRESS_META_HEADER.size == 32
+    assert XSPRESS_META_HEADER.unpack_from(struct.pack("<8I", 1, 2, 3, 4, 5, 0, 0, 0)) == (1, 2, 3, 4, 5)
+
+
+def test_meta_block_channels_split_between_messages(writer):
+    frame_id = 10
+    scalars = numpy.arange(2 * NUM_CHANNELS * 9).reshape((2, NUM_CHANNELS, 9))
+    dtc = 1.0 + numpy.arange(2 * NUM_CHANNELS).reshape((2, NUM_CHANNELS)) / 10.0
+    inp_est = 100.0 + numpy.arange(2 * NUM_CHANNELS).reshape((2, NUM_CHANNELS))
+
+    writer.handle_xspress_meta_block({}, meta_block(frame_id, 2, scalars[:, 2:], dtc[:, 2:], inp_est[:, 2:]))
+    # Nothing is written until every channel of a frame has arrived
+    assert writer.written == {}
+    writer.handle_xspress_meta_block({}, meta_block(frame_id, 0, scalars[:, :2], dtc[:, :2], inp_est[:, :2]))
+
+    for frame in range(2):
+        offset = frame_id + frame
+        for scalar in range(9):
+            numpy.testing.assert_array_equal(writer.written[("scalar_{}".format(scalar), offset)], scalars[frame, :, scalar])
+        numpy.testing.assert_array_equal(writer.written[("dtc", offset)], dtc[frame])
+        numpy.testing.assert_array_equal(writer.written[("inp_est", offset)], inp_est[frame])
+    assert len(writer.written) == 2 * 11
+    assert writer._meta == {}
+
+
+def test_meta_block_uses_number_of_scalars(writer):
+    scalars = numpy.arange(NUM_CHANNELS * 3).reshape((1, NUM_CHANNELS, 3)) + 7
+    dtc = numpy.full((1, NUM_CHANNELS), 1.25)
+    inp_est = numpy.full((1, NUM_CHANNELS), 2.5)
+
+    writer.handle_xspress_meta_block({}, meta_block(0, 0, scalars, dtc, inp_est))
+
+    for scalar in range(3):
+        numpy.testing.assert_array_equal(writer.written[("scalar_{}".format(scalar), 0)], scalars[0, :, scalar])
+    assert ("scalar_3", 0) not in writer.written
+    numpy.testing.assert_array_equal(writer.written[("dtc", 0)], dtc[0])
+    numpy.testing.assert_array_equal(writer.written[("inp_est", 0)], inp_est[0])
+
+
+def test_roi_counts(writer):
+    frame_id = 4
+    num_rois = 3
+    counts = numpy.arange(2 * NUM_CHANNELS * num_rois, dtype=numpy.uint32).reshape((2, NUM_CHANNELS, num_rois))
+    for first_channel in (0, 2):
+        data = XSPRESS_META_HEADER.pack(frame_id, 2, first_channel, 2, num_rois)
+        data += counts[:, first_channel:first_channel + 2].astype("<u4").tobytes()
+        writer.handle_xspress_roi({}, data)
+
+    for frame in range(2):
+        for roi in range(num_rois):
+            numpy.testing.assert_array_equal(
+                writer.written[("roi_{}".format(roi), frame_id + frame)], counts[frame, :, roi]
+            )
+    assert writer._rois == {}
+
+
+def test_sum_spectra(writer):
+    spectra = (numpy.arange(NUM_CHANNELS * NUM_BINS, dtype=numpy.uint64) << 33).reshape((NUM_CHANNELS, NUM_BINS))
+    for first_channel in (0, 2):
+        data = XSPRESS_META_HEADER.pack(9, 10, first_channel, 2, NUM_BINS)
+        data += spectra[first_channel:first_channel + 2].astype("<u8").tobytes()
+        writer.handle_xspress_sum({}, data)
+
+    for channel in range(NUM_CHANNELS):
+        numpy.testing.assert_array_equal(writer.written[("sum_spectra", channel)], spectra[channel])
+    # The total is summed over the channels of every message
+    numpy.testing.assert_array_equal(writer.written[("sum_total", 0)], spectra.sum(axis=0))